@@ -0,0 +1,173 @@
+/**
+ * @file actions.c
+ * Communication actions of the benchmark workloads, compiled by hand the
+ * way the generated code does it: the channels of the action are locked,
+ * a matching valid commitment awakes its pi-thread, otherwise the running
+ * pi-thread registers its commitments and waits.
+ *
+ * A function returning false has registered the commitments of the
+ * pi-thread, which waits: the procedure must return at once, the worker
+ * then puts the pi-thread in the wait queue.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdlib.h>
+#include <bench.h>
+
+/**
+ * Makes the running pi-thread wait, on the commitments it registered.
+ */
+static void bench_wait(PICC_PiThread *pt)
+{
+    pt->status = PICC_STATUS_WAIT;
+}
+
+/**
+ * Claims the pi-thread of the given commitment.
+ *
+ * @return Whether the commitment is still valid
+ */
+static bool claim(PICC_Commit *commit)
+{
+    PICC_CommitStatus ok;
+    while ((ok = PICC_can_awake(commit->thread, commit)) == PICC_CANNOT_ACQUIRE)
+        PICC_low_level_yield();
+    return ok == PICC_VALID_COMMIT;
+}
+
+/**
+ * Outputs the value of eval on the channel.
+ *
+ * @return true if a receiver got the value (pt->pc is cont), false if pt
+ * waits
+ */
+bool bench_output(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel *ch,
+                  PICC_EvalFunction eval, PICC_Label cont)
+{
+    PICC_Commit *commit;
+
+    LOCK_CHANNEL(ch);
+    while ((commit = PICC_fetch_input_commitment(ch)) != NULL) {
+        if (claim(commit)) {
+            commit->thread->env[commit->content.in.refvar] = eval(pt);
+            RELEASE_CHANNEL(ch);
+            PICC_awake(sp, commit->thread, commit);
+            pt->pc = cont;
+            return true;
+        }
+    }
+    PICC_register_output_commitment(pt, ch, eval, cont);
+    bench_wait(pt);
+    RELEASE_CHANNEL(ch);
+    return false;
+}
+
+/**
+ * Takes an output commitment of the channel into env[refvar].
+ *
+ * @return true if a sender was found (pt->pc is cont)
+ */
+static bool take_output(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel *ch,
+                        int refvar, PICC_Label cont)
+{
+    PICC_Commit *commit;
+    while ((commit = PICC_fetch_output_commitment(ch)) != NULL) {
+        if (claim(commit)) {
+            pt->env[refvar] = commit->content.out.eval_func(commit->thread);
+            PICC_awake(sp, commit->thread, commit);
+            pt->pc = cont;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Inputs a value of the channel in env[refvar].
+ *
+ * @return true if a value was received (pt->pc is cont), false if pt waits
+ */
+bool bench_input(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel *ch,
+                 int refvar, PICC_Label cont)
+{
+    LOCK_CHANNEL(ch);
+    if (take_output(sp, pt, ch, refvar, cont)) {
+        RELEASE_CHANNEL(ch);
+        return true;
+    }
+    PICC_register_input_commitment(pt, ch, refvar, cont);
+    bench_wait(pt);
+    RELEASE_CHANNEL(ch);
+    return false;
+}
+
+static int compare_chans(const void *a, const void *b)
+{
+    PICC_Channel *c1 = *(PICC_Channel **) a;
+    PICC_Channel *c2 = *(PICC_Channel **) b;
+    return (c1 > c2) - (c1 < c2);
+}
+
+/**
+ * Guarded choice of inputs on distinct channels, all in env[refvar]. The
+ * channels are locked in address order.
+ *
+ * @return The index of the branch taken (pt->pc is its cont), -1 if pt waits
+ */
+int bench_choice_input(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel **chans,
+                       int nb_chans, int refvar, PICC_Label *conts)
+{
+    PICC_Channel *locked[nb_chans];
+    int i, taken = -1;
+
+    for (i = 0; i < nb_chans; i++)
+        locked[i] = chans[i];
+    qsort(locked, nb_chans, sizeof(PICC_Channel *), compare_chans);
+    for (i = 0; i < nb_chans; i++)
+        LOCK_CHANNEL(locked[i]);
+
+    for (i = 0; i < nb_chans && taken < 0; i++) {
+        if (take_output(sp, pt, chans[i], refvar, conts[i]))
+            taken = i;
+    }
+    if (taken < 0) {
+        for (i = 0; i < nb_chans; i++)
+            PICC_register_input_commitment(pt, chans[i], refvar, conts[i]);
+        bench_wait(pt);
+    }
+
+    for (i = 0; i < nb_chans; i++)
+        RELEASE_CHANNEL(locked[i]);
+    return taken;
+}
+
+/**
+ * Creates a pi-thread running proc. It runs once given to bench_ready.
+ */
+PICC_PiThread *bench_spawn(PICC_PiThreadProc *proc, int env_length)
+{
+    PICC_PiThread *child = PICC_create_pithread(env_length, 0, 0);
+    child->proc = proc;
+    return child;
+}
+
+void bench_ready(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    pt->status = PICC_STATUS_RUN;
+    PICC_ready_queue_add(sp->ready, pt);
+}
+
+/**
+ * Makes the running pi-thread yield, once its procedure has returned.
+ */
+void bench_yield(PICC_PiThread *pt)
+{
+    pt->status = PICC_STATUS_CALL;
+    pt->fuel = 0;
+}
+
+void bench_end(PICC_PiThread *pt)
+{
+    PICC_process_end(pt, PICC_STATUS_ENDED);
+}
@@ -0,0 +1,259 @@
+/**
+ * @file bench.c
+ * Benchmark harness: runs one workload in a runtime and reports its
+ * throughput, latency percentiles, restart cost and peak RSS as a CSV row
+ * or a JSON object.
+ *
+ *     picc_bench <workload> [-w workers] [-n ops] [-s size] [-F fuel]
+ *                [-T threshold] [-m min] [-p mixed|lifo|fifo|priority]
+ *                [-P none|cpu|node] [-C cpulist] [-S seed] [-r runs]
+ *                [-f csv|json] [-H]
+ *
+ * -w is the nb_core_threads of the runtime (the master runs as well), -m its
+ * min_core_threads (the pool then adapts between -m and -w slaves), -p the
+ * policy of its ready queue (see PICC_ReadyPolicy), -F the
+ * fuel budget of the runtime, -T its stw_threshold (the growth of the wait
+ * queue above which the GC stops the world), -P and -C the pinning of the
+ * workers (see PICC_set_pinning), -S runs the workload in a serial runtime
+ * with the given seed (0 for the canonical order; -w, -m, -P and -C are
+ * then ignored and the workers column is -1), -H prints the CSV header
+ * first. Each of the -r runs
+ * creates a runtime, spawns the entry pi-thread, joins the runtime and
+ * shuts it down: the throughput is measured from the spawn to the join,
+ * the restart cost is the time spent creating and shutting the runtimes
+ * down, per run. The sizing and GC columns are the statistics of the
+ * last run: active workers, slaves woken up and put to sleep, cliques
+ * looked for and reclaimed by the collector, and its time spent
+ * collecting.
+ *
+ * This project is released under MIT License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <runtime.h>
+#include <gc.h>
+#include <bench.h>
+
+BenchConfig bench_config = { 0, 100000, 0, 0 };
+atomic_long bench_completed;
+
+static double *samples;
+static atomic_long nb_samples;
+
+double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Records a latency sample, dropped once BENCH_MAX_SAMPLES are kept.
+ */
+void bench_record_latency(double seconds)
+{
+    long i = atomic_fetch_add_explicit(&nb_samples, 1, memory_order_relaxed);
+    if (i < BENCH_MAX_SAMPLES)
+        samples[i] = seconds;
+}
+
+/**
+ * Creates a channel known by refs pi-threads, so that the GC does not
+ * collect the pi-threads waiting on it while the others may still use it.
+ */
+PICC_Channel *bench_channel(int refs)
+{
+    PICC_Channel *ch = PICC_create_channel();
+    ch->global_rc = refs;
+    return ch;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    double d1 = *(const double *) a;
+    double d2 = *(const double *) b;
+    return (d1 > d2) - (d1 < d2);
+}
+
+/**
+ * Returns the p-th percentile of the sorted samples, in microseconds.
+ */
+static double percentile(long count, double p)
+{
+    if (count == 0)
+        return 0.0;
+    long i = (long) (p * (count - 1) + 0.5);
+    return samples[i] * 1e6;
+}
+
+static const char *policies[] = { "mixed", "lifo", "fifo", "priority", NULL };
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s <workload> [-w workers] [-n ops] [-s size] [-F fuel]"
+            " [-T threshold] [-m min] [-p mixed|lifo|fifo|priority] [-P none|cpu|node]"
+            " [-C cpulist] [-S seed] [-r runs] [-f csv|json] [-H]\n", prog);
+    fprintf(stderr, "workloads:\n");
+    BenchWorkload *w;
+    for (w = bench_workloads; w->name != NULL; w++)
+        fprintf(stderr, "  %-12s %s\n", w->name, w->description);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *format = "csv";
+    PICC_RuntimeConfig runtime_config;
+    bool header = false;
+    BenchWorkload *workload = NULL;
+    int runs = 1;
+    int i;
+
+    PICC_runtime_config_init(&runtime_config);
+
+    if (argc < 2)
+        usage(argv[0]);
+    for (workload = bench_workloads; workload->name != NULL; workload++) {
+        if (strcmp(workload->name, argv[1]) == 0)
+            break;
+    }
+    if (workload->name == NULL)
+        usage(argv[0]);
+
+    for (i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-H") == 0)
+            header = true;
+        else if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "-w") == 0)
+            bench_config.workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0)
+            bench_config.ops = atol(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            bench_config.size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0)
+            runtime_config.stw_threshold = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0)
+            runtime_config.min_core_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0) {
+            i++;
+            int p;
+            for (p = 0; policies[p] != NULL && strcmp(argv[i], policies[p]) != 0; p++)
+                ;
+            if (policies[p] == NULL)
+                usage(argv[0]);
+            runtime_config.policy = (PICC_ReadyPolicy) p;
+        }
+        else if (strcmp(argv[i], "-F") == 0)
+            bench_config.fuel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-P") == 0) {
+            i++;
+            if (strcmp(argv[i], "cpu") == 0)
+                runtime_config.pin_mode = PICC_PIN_CPU;
+            else if (strcmp(argv[i], "node") == 0)
+                runtime_config.pin_mode = PICC_PIN_NODE;
+            else if (strcmp(argv[i], "none") != 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-C") == 0)
+            runtime_config.cpus = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0) {
+            runtime_config.serial = true;
+            runtime_config.seed = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+            runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0)
+            format = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (bench_config.size <= 0)
+        bench_config.size = workload->default_size;
+    if (bench_config.workers < 0 || bench_config.ops <= 0 || bench_config.fuel < 0 || runs <= 0
+        || runtime_config.stw_threshold < 0)
+        usage(argv[0]);
+    runtime_config.nb_core_threads = bench_config.workers;
+    if (runtime_config.serial)
+        bench_config.workers = -1;
+    if (bench_config.fuel > 0)
+        runtime_config.fuel = bench_config.fuel;
+
+    samples = malloc(BENCH_MAX_SAMPLES * sizeof(double));
+    if (samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    atomic_init(&nb_samples, 0);
+    atomic_init(&bench_completed, 0);
+
+    PICC_RuntimeStats stats;
+    double seconds = 0.0, restart = 0.0;
+    for (i = 0; i < runs; i++) {
+        ALLOC_ERROR(error);
+        workload->setup(&bench_config);
+
+        double start = bench_now();
+        PICC_Runtime *rt = PICC_create_runtime(&runtime_config, &error);
+        if (HAS_ERROR(error)) CRASH(&error);
+        double started = bench_now();
+        PICC_runtime_spawn(rt, workload->entry, workload->entry_env_length, 0, 0);
+        PICC_RuntimeStatus status = PICC_runtime_join(rt, &error);
+        double joined = bench_now();
+        PICC_runtime_stats(rt, &stats);
+        PICC_runtime_shutdown(rt);
+        double stopped = bench_now();
+        if (status == PICC_RUNTIME_ERROR) CRASH(&error);
+
+        seconds += joined - started;
+        restart += (started - start) + (stopped - joined);
+    }
+    restart /= runs;
+
+    long completed = atomic_load(&bench_completed);
+    long count = atomic_load(&nb_samples);
+    if (count > BENCH_MAX_SAMPLES)
+        count = BENCH_MAX_SAMPLES;
+    qsort(samples, count, sizeof(double), compare_samples);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    if (strcmp(format, "json") == 0) {
+        printf("{\"workload\":\"%s\",\"workers\":%d,\"policy\":\"%s\",\"size\":%d,"
+               "\"runs\":%d,\"ops\":%ld,"
+               "\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"latency_samples\":%ld,"
+               "\"latency_p50_us\":%.3f,\"latency_p90_us\":%.3f,\"latency_p99_us\":%.3f,"
+               "\"latency_max_us\":%.3f,\"restart_us\":%.1f,\"active\":%d,\"grows\":%ld,"
+               "\"shrinks\":%ld,\"gc_runs\":%ld,\"gc_cliques\":%ld,\"gc_ms\":%.3f,"
+               "\"peak_rss_kb\":%ld}\n",
+               workload->name, bench_config.workers, policies[runtime_config.policy],
+               bench_config.size, runs, completed,
+               seconds, completed / seconds, count,
+               percentile(count, 0.50), percentile(count, 0.90), percentile(count, 0.99),
+               percentile(count, 1.0), restart * 1e6, stats.nb_active, stats.nb_grows,
+               stats.nb_shrinks, stats.nb_gc_runs, stats.nb_gc_cliques, stats.gc_seconds * 1e3,
+               usage.ru_maxrss);
+    } else {
+        if (header)
+            printf("workload,workers,policy,size,runs,ops,seconds,ops_per_sec,latency_samples,"
+                   "latency_p50_us,latency_p90_us,latency_p99_us,latency_max_us,restart_us,"
+                   "active,grows,shrinks,gc_runs,gc_cliques,gc_ms,peak_rss_kb\n");
+        printf("%s,%d,%s,%d,%d,%ld,%.6f,%.1f,%ld,%.3f,%.3f,%.3f,%.3f,%.1f,%d,%ld,%ld,%ld,%ld,"
+               "%.3f,%ld\n",
+               workload->name, bench_config.workers, policies[runtime_config.policy],
+               bench_config.size, runs, completed,
+               seconds, completed / seconds, count,
+               percentile(count, 0.50), percentile(count, 0.90), percentile(count, 0.99),
+               percentile(count, 1.0), restart * 1e6, stats.nb_active, stats.nb_grows,
+               stats.nb_shrinks, stats.nb_gc_runs, stats.nb_gc_cliques, stats.gc_seconds * 1e3,
+               usage.ru_maxrss);
+    }
+    return 0;
+}
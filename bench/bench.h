@@ -0,0 +1,85 @@
+/**
+ * @file bench.h
+ * Benchmark suite of the runtime: hand-compiled pi-calculus workloads run
+ * in a runtime created, joined and shut down by the harness.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pi_thread_repr.h>
+#include <channel_repr.h>
+#include <commit_repr.h>
+#include <scheduler_repr.h>
+#include <queue_repr.h>
+#include <value_repr.h>
+
+/**
+ * PICC_DEFAULT_ENTRY_LABEL, usable as a case label.
+ */
+#define BENCH_ENTRY 0
+
+/**
+ * Maximum number of latency samples kept by a run.
+ */
+#define BENCH_MAX_SAMPLES (1 << 20)
+
+/**
+ * The parameters of a run.
+ */
+typedef struct _BenchConfig {
+    /**@{*/
+    int workers; /**< nb_core_threads of the runtime */
+    long ops; /**< Number of operations of the workload */
+    int size; /**< Workload specific size (pairs, ring nodes, clients...) */
+    int fuel; /**< Fuel budget of the runtime, 0 for the default */
+    /**@}*/
+} BenchConfig;
+
+/**
+ * A benchmark workload. The setup creates the channels shared by the
+ * pi-threads, then the runtime runs the entry procedure until every
+ * pi-thread has ended or waits forever.
+ */
+typedef struct _BenchWorkload {
+    /**@{*/
+    const char *name;
+    const char *description;
+    int default_size;
+    void (*setup)(BenchConfig *config);
+    PICC_PiThreadProc *entry;
+    int entry_env_length;
+    /**@}*/
+} BenchWorkload;
+
+extern BenchWorkload bench_workloads[];
+extern BenchConfig bench_config;
+extern atomic_long bench_completed;
+
+// harness
+extern double bench_now();
+extern void bench_record_latency(double seconds);
+extern PICC_Channel *bench_channel(int refs);
+
+// hand-compiled actions, as the generated code does them
+extern bool bench_output(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel *ch,
+                         PICC_EvalFunction eval, PICC_Label cont);
+extern bool bench_input(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel *ch,
+                        int refvar, PICC_Label cont);
+extern int bench_choice_input(PICC_SchedPool *sp, PICC_PiThread *pt, PICC_Channel **chans,
+                              int nb_chans, int refvar, PICC_Label *conts);
+extern PICC_PiThread *bench_spawn(PICC_PiThreadProc *proc, int env_length);
+extern void bench_ready(PICC_SchedPool *sp, PICC_PiThread *pt);
+extern void bench_yield(PICC_PiThread *pt);
+extern void bench_end(PICC_PiThread *pt);
+
+#define BENCH_INT(pt, var) (((PICC_IntValue *) &(pt)->env[var])->data)
+#define BENCH_SET_INT(pt, var, i) PICC_INIT_INT_VALUE(&(pt)->env[var], (i))
+#define BENCH_CHAN(pt, var) ((PICC_Channel *) ((PICC_ChannelValue *) &(pt)->env[var])->data)
+#define BENCH_SET_CHAN(pt, var, ch) PICC_INIT_CHANNEL_VALUE(&(pt)->env[var], (ch))
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file queue_bench.c
+ * Throughput of the ready and wait queues hot paths.
+ *
+ * Built against both the release and the debug libpirt.a (make
+ * bench-contracts) to measure the cost of the contract checks.
+ *
+ * This project is released under MIT License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pi_thread_repr.h>
+#include <queue_repr.h>
+#include <tools.h>
+
+#define NB_THREADS 2000
+#define NB_ROUNDS 50
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, long ops, double secs)
+{
+    printf("%-24s %10ld ops %8.3f s %14.0f ops/s\n", name, ops, secs, ops / secs);
+}
+
+/**
+ * Pushes all the pi-threads in the wait queue and fetches them back in a
+ * shuffled order, as PICC_awake does.
+ */
+static void bench_wait_queue(PICC_PiThread **pts, int *order)
+{
+    ALLOC_ERROR(error);
+    PICC_WaitQueue *wq = PICC_create_wait_queue(&error);
+    if (HAS_ERROR(error))
+        CRASH(&error);
+
+    double start = now();
+    int r, i;
+    for (r = 0; r < NB_ROUNDS; r++) {
+        for (i = 0; i < NB_THREADS; i++)
+            PICC_wait_queue_push(wq, pts[i]);
+        for (i = 0; i < NB_THREADS; i++)
+            PICC_wait_queue_fetch(wq, pts[order[i]]);
+    }
+    report("wait push/fetch", 2L * NB_ROUNDS * NB_THREADS, now() - start);
+
+    PICC_free_wait_queue(wq);
+}
+
+/**
+ * Pushes, adds and pops all the pi-threads on a worker ready deque.
+ */
+static void bench_ready_queue(PICC_PiThread **pts)
+{
+    ALLOC_ERROR(error);
+    PICC_ReadyQueue *rq = PICC_create_worker_ready_queue(1, &error);
+    if (HAS_ERROR(error))
+        CRASH(&error);
+    PICC_ready_queue_bind_worker(rq, 0);
+
+    double start = now();
+    int r, i;
+    for (r = 0; r < NB_ROUNDS; r++) {
+        for (i = 0; i < NB_THREADS; i++) {
+            if (i % 2)
+                PICC_ready_queue_push(rq, pts[i]);
+            else
+                PICC_ready_queue_add(rq, pts[i]);
+        }
+        for (i = 0; i < NB_THREADS; i++)
+            PICC_ready_queue_pop(rq);
+    }
+    report("ready push/add/pop", 2L * NB_ROUNDS * NB_THREADS, now() - start);
+
+    PICC_free_ready_queue(rq);
+}
+
+int main(int argc, char **argv)
+{
+    PICC_PiThread **pts = malloc(sizeof(PICC_PiThread *) * NB_THREADS);
+    int *order = malloc(sizeof(int) * NB_THREADS);
+    int i;
+    for (i = 0; i < NB_THREADS; i++) {
+        pts[i] = PICC_create_pithread(1, 1, 1);
+        order[i] = i;
+    }
+    srand(42);
+    for (i = NB_THREADS - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    bench_wait_queue(pts, order);
+    bench_ready_queue(pts);
+
+    for (i = 0; i < NB_THREADS; i++)
+        PICC_reclaim_pi_thread(pts[i]);
+    free(pts);
+    free(order);
+
+    return 0;
+}
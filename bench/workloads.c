@@ -0,0 +1,768 @@
+/**
+ * @file workloads.c
+ * The benchmark workloads, written as the compiler would generate their
+ * pi-thread procedures: a switch on the program counter, one label per
+ * continuation of a blocking action.
+ *
+ * The channels are created by the setup of a workload, before each run of
+ * the runtime. The pi-threads serving forever are left waiting when the
+ * others have ended, which makes the runtime quiescent.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bench.h>
+
+/**
+ * Allocates an array of timestamps, one per message of a workload. The
+ * array of the previous run is reused.
+ */
+static double *create_stamps(double *stamps, long count)
+{
+    stamps = realloc(stamps, count * sizeof(double));
+    if (stamps == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memset(stamps, 0, count * sizeof(double));
+    return stamps;
+}
+
+static PICC_Channel **create_channels(int count, int refs)
+{
+    PICC_Channel **chans = malloc(count * sizeof(PICC_Channel *));
+    if (chans == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    int i;
+    for (i = 0; i < count; i++)
+        chans[i] = bench_channel(refs);
+    return chans;
+}
+
+// Ping-pong ////////////////////////////////////////////////////////////////
+
+// size pairs of pi-threads exchange a message back and forth, the latency
+// is the round trip
+
+enum { PING_CH, PONG_CH, PING_PAIR, PING_COUNT, PING_MSG, PING_ENV };
+enum { PING_SEND = 1, PING_RECV, PING_DONE };
+enum { PONG_RECV = 1, PONG_SEND };
+
+static PICC_Channel **pings;
+static PICC_Channel **pongs;
+static double *ping_start;
+static int ping_rounds;
+
+static void pingpong_setup(BenchConfig *config)
+{
+    pings = create_channels(config->size, 2);
+    pongs = create_channels(config->size, 2);
+    ping_start = create_stamps(ping_start, config->size);
+    ping_rounds = config->ops / config->size;
+}
+
+static PICC_Value eval_ping_count(PICC_PiThread *pt)
+{
+    return pt->env[PING_COUNT];
+}
+
+static PICC_Value eval_pong_msg(PICC_PiThread *pt)
+{
+    return pt->env[PING_MSG];
+}
+
+static void ping_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int pair = BENCH_INT(pt, PING_PAIR);
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case PING_SEND:
+            if (BENCH_INT(pt, PING_COUNT) == ping_rounds) {
+                bench_end(pt);
+                return;
+            }
+            ping_start[pair] = bench_now();
+            if (!bench_output(sp, pt, BENCH_CHAN(pt, PING_CH), eval_ping_count, PING_RECV))
+                return;
+            break;
+        case PING_RECV:
+            if (!bench_input(sp, pt, BENCH_CHAN(pt, PONG_CH), PING_MSG, PING_DONE))
+                return;
+            break;
+        case PING_DONE:
+            bench_record_latency(bench_now() - ping_start[pair]);
+            atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+            BENCH_SET_INT(pt, PING_COUNT, BENCH_INT(pt, PING_COUNT) + 1);
+            pt->pc = PING_SEND;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+static void pong_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case PONG_RECV:
+            if (!bench_input(sp, pt, BENCH_CHAN(pt, PING_CH), PING_MSG, PONG_SEND))
+                return;
+            break;
+        case PONG_SEND:
+            if (!bench_output(sp, pt, BENCH_CHAN(pt, PONG_CH), eval_pong_msg, PONG_RECV))
+                return;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+static void pingpong_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int p;
+    for (p = 0; p < bench_config.size; p++) {
+        PICC_PiThread *ping = bench_spawn(ping_proc, PING_ENV);
+        BENCH_SET_CHAN(ping, PING_CH, pings[p]);
+        BENCH_SET_CHAN(ping, PONG_CH, pongs[p]);
+        BENCH_SET_INT(ping, PING_PAIR, p);
+        BENCH_SET_INT(ping, PING_COUNT, 0);
+        PICC_PiThread *pong = bench_spawn(pong_proc, PING_ENV);
+        BENCH_SET_CHAN(pong, PING_CH, pings[p]);
+        BENCH_SET_CHAN(pong, PONG_CH, pongs[p]);
+        bench_ready(sp, pong);
+        bench_ready(sp, ping);
+    }
+    bench_end(pt);
+}
+
+// Token ring ///////////////////////////////////////////////////////////////
+
+// a token goes around a ring of size pi-threads, an operation is a hop and
+// the latency is a lap
+
+enum { RING_IN, RING_OUT, RING_TOKEN, RING_NODE, RING_ENV };
+enum { RING_RECV = 1, RING_FWD };
+
+static PICC_Channel **ring;
+static int ring_laps;
+static double ring_lap_start;
+
+static void ring_setup(BenchConfig *config)
+{
+    if (config->size < 2)
+        config->size = 2;
+    ring = create_channels(config->size, 2);
+    ring_laps = config->ops / config->size;
+}
+
+static PICC_Value eval_ring_token(PICC_PiThread *pt)
+{
+    return pt->env[RING_TOKEN];
+}
+
+static void ring_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case RING_RECV:
+            if (!bench_input(sp, pt, BENCH_CHAN(pt, RING_IN), RING_TOKEN, RING_FWD))
+                return;
+            break;
+        case RING_FWD:
+            if (BENCH_INT(pt, RING_NODE) == 0) {
+                // the first node counts the laps
+                int lap = BENCH_INT(pt, RING_TOKEN);
+                double now = bench_now();
+                if (lap > 0)
+                    bench_record_latency(now - ring_lap_start);
+                if (lap == ring_laps) {
+                    bench_end(pt);
+                    return;
+                }
+                ring_lap_start = now;
+                BENCH_SET_INT(pt, RING_TOKEN, lap + 1);
+            }
+            atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+            if (!bench_output(sp, pt, BENCH_CHAN(pt, RING_OUT), eval_ring_token, RING_RECV))
+                return;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+static void ring_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int n = bench_config.size, i;
+    for (i = n - 1; i >= 0; i--) {
+        PICC_PiThread *node = bench_spawn(ring_proc, RING_ENV);
+        BENCH_SET_CHAN(node, RING_IN, ring[i]);
+        BENCH_SET_CHAN(node, RING_OUT, ring[(i + 1) % n]);
+        BENCH_SET_INT(node, RING_NODE, i);
+        BENCH_SET_INT(node, RING_TOKEN, 0);
+        if (i == 0)
+            node->pc = RING_FWD; // injects the token
+        bench_ready(sp, node);
+    }
+    bench_end(pt);
+}
+
+// Fan-in and fan-out ///////////////////////////////////////////////////////
+
+// fan-in: size senders output on one hot channel read by a single server.
+// fan-out: a single producer outputs on one channel read by size consumers.
+// The messages are timestamp slots, the latency is from the send to the
+// receive. The fan-in server has a high priority, only honoured under the
+// priority policy
+
+enum { FAN_CH, FAN_MSG, FAN_LEFT, FAN_ENV };
+enum { FAN_SEND = 1, FAN_SENT, FAN_RECV, FAN_GOT };
+
+static PICC_Channel *hot;
+static double *fan_stamps;
+static atomic_int fan_next_slot;
+static long fan_per_sender;
+static long fan_total;
+
+static void fanin_setup(BenchConfig *config)
+{
+    hot = bench_channel(config->size + 1);
+    fan_per_sender = config->ops / config->size;
+    fan_total = fan_per_sender * config->size;
+    fan_stamps = create_stamps(fan_stamps, fan_total);
+    atomic_init(&fan_next_slot, 0);
+}
+
+static void fanout_setup(BenchConfig *config)
+{
+    hot = bench_channel(config->size + 1);
+    fan_per_sender = config->ops;
+    fan_total = config->ops;
+    fan_stamps = create_stamps(fan_stamps, fan_total);
+    atomic_init(&fan_next_slot, 0);
+}
+
+static PICC_Value eval_fan_msg(PICC_PiThread *pt)
+{
+    return pt->env[FAN_MSG];
+}
+
+static void fan_sender_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case FAN_SEND: {
+            if (BENCH_INT(pt, FAN_LEFT) == 0) {
+                bench_end(pt);
+                return;
+            }
+            int slot = atomic_fetch_add_explicit(&fan_next_slot, 1, memory_order_relaxed);
+            fan_stamps[slot] = bench_now();
+            BENCH_SET_INT(pt, FAN_MSG, slot);
+            BENCH_SET_INT(pt, FAN_LEFT, BENCH_INT(pt, FAN_LEFT) - 1);
+            if (!bench_output(sp, pt, BENCH_CHAN(pt, FAN_CH), eval_fan_msg, FAN_SENT))
+                return;
+            break;
+        }
+        case FAN_SENT:
+            pt->pc = FAN_SEND;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+/**
+ * Receives on the hot channel, FAN_LEFT messages or forever if negative.
+ */
+static void fan_receiver_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case FAN_RECV:
+            if (BENCH_INT(pt, FAN_LEFT) == 0) {
+                bench_end(pt);
+                return;
+            }
+            if (!bench_input(sp, pt, BENCH_CHAN(pt, FAN_CH), FAN_MSG, FAN_GOT))
+                return;
+            break;
+        case FAN_GOT:
+            bench_record_latency(bench_now() - fan_stamps[BENCH_INT(pt, FAN_MSG)]);
+            atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+            BENCH_SET_INT(pt, FAN_LEFT, BENCH_INT(pt, FAN_LEFT) - 1);
+            pt->pc = FAN_RECV;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+static PICC_PiThread *fan_spawn(PICC_PiThreadProc *proc, long left)
+{
+    PICC_PiThread *fan = bench_spawn(proc, FAN_ENV);
+    BENCH_SET_CHAN(fan, FAN_CH, hot);
+    BENCH_SET_INT(fan, FAN_LEFT, left);
+    return fan;
+}
+
+static void fanin_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    PICC_PiThread *server = fan_spawn(fan_receiver_proc, fan_total);
+    server->priority = PICC_PRIORITY_HIGH;
+    bench_ready(sp, server);
+    for (i = 0; i < bench_config.size; i++)
+        bench_ready(sp, fan_spawn(fan_sender_proc, fan_per_sender));
+    bench_end(pt);
+}
+
+static void fanout_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < bench_config.size; i++)
+        bench_ready(sp, fan_spawn(fan_receiver_proc, -1));
+    bench_ready(sp, fan_spawn(fan_sender_proc, fan_total));
+    bench_end(pt);
+}
+
+// Choice servers ///////////////////////////////////////////////////////////
+
+// a server makes a guarded choice between size request channels, 2 * size
+// clients send requests on them and wait for the reply on their own
+// channel, the latency is the round trip
+
+enum { CLIENT_ID, CLIENT_LEFT, CLIENT_MSG, CLIENT_ENV };
+enum { CLIENT_REQ = 1, CLIENT_REPLY, CLIENT_DONE };
+enum { SERVER_MSG, SERVER_ENV };
+enum { SERVER_CHOICE = 1, SERVER_REPLIED, SERVER_BRANCH = 100 };
+
+static PICC_Channel **requests;
+static PICC_Channel **replies;
+static double *client_start;
+static int nb_clients;
+static long client_requests;
+
+static void choice_setup(BenchConfig *config)
+{
+    nb_clients = 2 * config->size;
+    requests = create_channels(config->size, 3);
+    replies = create_channels(nb_clients, 2);
+    client_start = create_stamps(client_start, nb_clients);
+    client_requests = config->ops / nb_clients;
+}
+
+static PICC_Value eval_client_id(PICC_PiThread *pt)
+{
+    return pt->env[CLIENT_ID];
+}
+
+static PICC_Value eval_server_msg(PICC_PiThread *pt)
+{
+    return pt->env[SERVER_MSG];
+}
+
+static void client_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int id = BENCH_INT(pt, CLIENT_ID);
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case CLIENT_REQ:
+            if (BENCH_INT(pt, CLIENT_LEFT) == 0) {
+                bench_end(pt);
+                return;
+            }
+            client_start[id] = bench_now();
+            if (!bench_output(sp, pt, requests[id % bench_config.size], eval_client_id,
+                              CLIENT_REPLY))
+                return;
+            break;
+        case CLIENT_REPLY:
+            if (!bench_input(sp, pt, replies[id], CLIENT_MSG, CLIENT_DONE))
+                return;
+            break;
+        case CLIENT_DONE:
+            bench_record_latency(bench_now() - client_start[id]);
+            atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+            BENCH_SET_INT(pt, CLIENT_LEFT, BENCH_INT(pt, CLIENT_LEFT) - 1);
+            pt->pc = CLIENT_REQ;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+    }
+}
+
+static void server_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int n = bench_config.size, i;
+    PICC_Label conts[n];
+    for (i = 0; i < n; i++)
+        conts[i] = SERVER_BRANCH + i;
+
+    for (;;) {
+        switch (pt->pc) {
+        case BENCH_ENTRY:
+        case SERVER_CHOICE:
+        case SERVER_REPLIED:
+            if (bench_choice_input(sp, pt, requests, n, SERVER_MSG, conts) < 0)
+                return;
+            break;
+        default: {
+            // branch pt->pc - SERVER_BRANCH, all of them reply to the client
+            int client = BENCH_INT(pt, SERVER_MSG);
+            if (!bench_output(sp, pt, replies[client], eval_server_msg, SERVER_REPLIED))
+                return;
+            PICC_FUEL_STEP(pt);
+            break;
+        }
+        }
+    }
+}
+
+static void choice_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    bench_ready(sp, bench_spawn(server_proc, SERVER_ENV));
+    for (i = 0; i < nb_clients; i++) {
+        PICC_PiThread *client = bench_spawn(client_proc, CLIENT_ENV);
+        BENCH_SET_INT(client, CLIENT_ID, i);
+        BENCH_SET_INT(client, CLIENT_LEFT, client_requests);
+        bench_ready(sp, client);
+    }
+    bench_end(pt);
+}
+
+// Spawn tree ///////////////////////////////////////////////////////////////
+
+// a binary tree of pi-threads of depth size, each one spawning its two
+// children, an operation is a pi-thread and the latency is from its spawn
+// to its first run
+
+enum { TREE_DEPTH, TREE_SLOT, TREE_ENV };
+
+static double *tree_stamps;
+static atomic_int tree_next_slot;
+
+static void tree_setup(BenchConfig *config)
+{
+    if (config->size <= 0) {
+        // the deepest tree with at most ops nodes
+        config->size = 0;
+        while ((2L << (config->size + 1)) - 1 <= config->ops)
+            config->size++;
+    }
+    tree_stamps = create_stamps(tree_stamps, 2L << config->size);
+    atomic_init(&tree_next_slot, 0);
+}
+
+static PICC_PiThread *tree_spawn(PICC_PiThreadProc *proc, int depth)
+{
+    PICC_PiThread *node = bench_spawn(proc, TREE_ENV);
+    int slot = atomic_fetch_add_explicit(&tree_next_slot, 1, memory_order_relaxed);
+    BENCH_SET_INT(node, TREE_DEPTH, depth);
+    BENCH_SET_INT(node, TREE_SLOT, slot);
+    tree_stamps[slot] = bench_now();
+    return node;
+}
+
+static void tree_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    bench_record_latency(bench_now() - tree_stamps[BENCH_INT(pt, TREE_SLOT)]);
+    atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+    int depth = BENCH_INT(pt, TREE_DEPTH);
+    if (depth > 0) {
+        bench_ready(sp, tree_spawn(tree_proc, depth - 1));
+        bench_ready(sp, tree_spawn(tree_proc, depth - 1));
+    }
+    bench_end(pt);
+}
+
+static void tree_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    bench_ready(sp, tree_spawn(tree_proc, bench_config.size));
+    bench_end(pt);
+}
+
+// Spawn bursts ////////////////////////////////////////////////////////////
+
+// a spawner spawns ops / size bursts of size pi-threads with PICC_spawn, an
+// operation is a spawned pi-thread and the latency is from the spawn of
+// its burst to its first run
+
+enum { BURST_SLOT, BURST_ENV };
+enum { BURSTER_LEFT, BURSTER_ENV };
+
+static double *burst_stamps;
+
+static void burst_setup(BenchConfig *config)
+{
+    if (config->size < 1)
+        config->size = 1;
+    burst_stamps = create_stamps(burst_stamps, config->ops / config->size + 1);
+}
+
+static void burst_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    (void)sp;
+    bench_record_latency(bench_now() - burst_stamps[BENCH_INT(pt, BURST_SLOT)]);
+    atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+    bench_end(pt);
+}
+
+static void burster_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    PICC_PiThread *burst[bench_config.size];
+    int i;
+    for (;;) {
+        int left = BENCH_INT(pt, BURSTER_LEFT);
+        if (left == 0) {
+            bench_end(pt);
+            return;
+        }
+        for (i = 0; i < bench_config.size; i++) {
+            burst[i] = bench_spawn(burst_proc, BURST_ENV);
+            BENCH_SET_INT(burst[i], BURST_SLOT, left);
+        }
+        burst_stamps[left] = bench_now();
+        PICC_spawn(sp, burst, bench_config.size);
+        BENCH_SET_INT(pt, BURSTER_LEFT, left - 1);
+        PICC_FUEL_STEP(pt);
+    }
+}
+
+static void burst_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    PICC_PiThread *burster = bench_spawn(burster_proc, BURSTER_ENV);
+    BENCH_SET_INT(burster, BURSTER_LEFT, bench_config.ops / bench_config.size);
+    bench_ready(sp, burster);
+    bench_end(pt);
+}
+
+// Garbage cliques //////////////////////////////////////////////////////////
+
+// a spawner creates cliques of size pi-threads all waiting for an input on
+// a channel only they know, which the collector thread reclaims. An
+// operation is a clique and the latency is the time between two cliques,
+// which includes the time the collector takes the CPU of the spawner
+
+enum { MEMBER_CH, MEMBER_MSG, MEMBER_ENV };
+enum { MEMBER_GOT = 1 };
+enum { SPAWNER_LEFT, SPAWNER_ENV };
+
+static double spawner_last;
+
+static void gc_setup(BenchConfig *config)
+{
+    if (config->size < 1)
+        config->size = 1;
+}
+
+static void member_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    switch (pt->pc) {
+    case BENCH_ENTRY:
+        if (!bench_input(sp, pt, BENCH_CHAN(pt, MEMBER_CH), MEMBER_MSG, MEMBER_GOT))
+            return;
+        // no other pi-thread may output on the channel
+        break;
+    default:
+        break;
+    }
+    bench_end(pt);
+}
+
+static void spawner_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (;;) {
+        double now = bench_now();
+        if (BENCH_INT(pt, SPAWNER_LEFT) < bench_config.ops)
+            bench_record_latency(now - spawner_last);
+        spawner_last = now;
+        if (BENCH_INT(pt, SPAWNER_LEFT) == 0) {
+            bench_end(pt);
+            return;
+        }
+
+        PICC_Channel *ch = bench_channel(bench_config.size);
+        for (i = 0; i < bench_config.size; i++) {
+            PICC_PiThread *member = bench_spawn(member_proc, MEMBER_ENV);
+            BENCH_SET_CHAN(member, MEMBER_CH, ch);
+            bench_ready(sp, member);
+        }
+        atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+        BENCH_SET_INT(pt, SPAWNER_LEFT, BENCH_INT(pt, SPAWNER_LEFT) - 1);
+        PICC_FUEL_STEP(pt);
+    }
+}
+
+static void gc_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    PICC_PiThread *spawner = bench_spawn(spawner_proc, SPAWNER_ENV);
+    BENCH_SET_INT(spawner, SPAWNER_LEFT, bench_config.ops);
+    bench_ready(sp, spawner);
+    bench_end(pt);
+}
+
+// Large garbage cliques ///////////////////////////////////////////////////
+
+// a spawner creates ops / size cliques of size pi-threads waiting on one
+// channel, one at a time, and yields until the collector has reclaimed
+// it. An operation is a pi-thread reclaimed and the latency is the time
+// from the spawn of a clique to its reclamation
+
+enum { CLIQUE_LEFT, CLIQUE_BASE, CLIQUE_ENV };
+enum { CLIQUE_SPAWNED = 1 };
+
+static double clique_spawned;
+
+static void clique_setup(BenchConfig *config)
+{
+    if (config->size < 1)
+        config->size = 1;
+}
+
+static void clique_spawner_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    if (pt->pc == CLIQUE_SPAWNED) {
+        if (atomic_load(&sp->nb_gc_cliques) == BENCH_INT(pt, CLIQUE_BASE)) {
+            bench_yield(pt);
+            return;
+        }
+        bench_record_latency(bench_now() - clique_spawned);
+        atomic_fetch_add_explicit(&bench_completed, bench_config.size, memory_order_relaxed);
+        BENCH_SET_INT(pt, CLIQUE_LEFT, BENCH_INT(pt, CLIQUE_LEFT) - 1);
+    }
+    if (BENCH_INT(pt, CLIQUE_LEFT) == 0) {
+        bench_end(pt);
+        return;
+    }
+
+    PICC_Channel *ch = bench_channel(bench_config.size);
+    BENCH_SET_INT(pt, CLIQUE_BASE, atomic_load(&sp->nb_gc_cliques));
+    clique_spawned = bench_now();
+    for (i = 0; i < bench_config.size; i++) {
+        PICC_PiThread *member = bench_spawn(member_proc, MEMBER_ENV);
+        BENCH_SET_CHAN(member, MEMBER_CH, ch);
+        bench_ready(sp, member);
+    }
+    pt->pc = CLIQUE_SPAWNED;
+    bench_yield(pt);
+}
+
+static void clique_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    PICC_PiThread *spawner = bench_spawn(clique_spawner_proc, CLIQUE_ENV);
+    long cliques = bench_config.ops / bench_config.size;
+    BENCH_SET_INT(spawner, CLIQUE_LEFT, cliques > 0 ? cliques : 1);
+    bench_ready(sp, spawner);
+    bench_end(pt);
+}
+
+// Hogs /////////////////////////////////////////////////////////////////////
+
+// size hogs compute ops / size steps each, one procedure call per step as
+// the generated code chains its procedures, while a ticker yields as often
+// as it can. The scheduler preempts the hogs once their slice of fuel is
+// exhausted. An operation is a hog step and the latency is the time the
+// ticker waits in the ready queue
+
+enum { HOG_LEFT, HOG_ENV };
+enum { TICKER_TICK = 1 };
+
+/**
+ * Iterations of the computation of a hog step, about a microsecond.
+ */
+#define HOG_WORK 1000
+
+static atomic_int hogs_left;
+static double ticker_yield;
+static __thread volatile unsigned hog_sink;
+
+static void hog_setup(BenchConfig *config)
+{
+    atomic_init(&hogs_left, config->size);
+}
+
+static void hog_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    (void)sp;
+    int left = BENCH_INT(pt, HOG_LEFT);
+    if (left == 0) {
+        atomic_fetch_sub(&hogs_left, 1);
+        bench_end(pt);
+        return;
+    }
+
+    unsigned x = left;
+    int i;
+    for (i = 0; i < HOG_WORK; i++)
+        x = x * 1664525u + 1013904223u;
+    hog_sink = x;
+
+    atomic_fetch_add_explicit(&bench_completed, 1, memory_order_relaxed);
+    BENCH_SET_INT(pt, HOG_LEFT, left - 1);
+    pt->status = PICC_STATUS_CALL;
+}
+
+static void ticker_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    (void)sp;
+    if (pt->pc == TICKER_TICK)
+        bench_record_latency(bench_now() - ticker_yield);
+    if (atomic_load(&hogs_left) == 0) {
+        bench_end(pt);
+        return;
+    }
+    ticker_yield = bench_now();
+    pt->pc = TICKER_TICK;
+    bench_yield(pt);
+}
+
+static void hog_entry(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < bench_config.size; i++) {
+        PICC_PiThread *hog = bench_spawn(hog_proc, HOG_ENV);
+        BENCH_SET_INT(hog, HOG_LEFT, bench_config.ops / bench_config.size);
+        bench_ready(sp, hog);
+    }
+    bench_ready(sp, bench_spawn(ticker_proc, 0));
+    bench_end(pt);
+}
+
+BenchWorkload bench_workloads[] = {
+    { "pingpong", "pairs exchanging a message, latency is the round trip",
+      1, pingpong_setup, pingpong_entry, 0 },
+    { "ring", "token passed around a ring, an op is a hop, latency is a lap",
+      64, ring_setup, ring_entry, 0 },
+    { "fanin", "senders to one hot channel read by one server",
+      8, fanin_setup, fanin_entry, 0 },
+    { "fanout", "one producer to a channel read by many consumers",
+      8, fanout_setup, fanout_entry, 0 },
+    { "choice", "server choosing between request channels, round trips",
+      4, choice_setup, choice_entry, 0 },
+    { "spawntree", "binary tree of spawned pi-threads, latency is spawn to run",
+      0, tree_setup, tree_entry, 0 },
+    { "burst", "bursts of pi-threads spawned at once, latency is spawn to run",
+      64, burst_setup, burst_entry, 0 },
+    { "gc", "cliques of pi-threads waiting forever, collected by the GC",
+      2, gc_setup, gc_entry, 0 },
+    { "clique", "one large garbage clique at a time, latency is spawn to reclaim",
+      1000, clique_setup, clique_entry, 0 },
+    { "hog", "compute-bound pi-threads preempted, latency is a ticker wait",
+      4, hog_setup, hog_entry, 0 },
+    { NULL, NULL, 0, NULL, NULL, 0 }
+};
@@ -11,7 +11,7 @@
 #define ATOMIC_REPR_H
 
 #include <stdbool.h>
-#include <pthread.h>
+#include <stdatomic.h>
 #include <atomic.h>
 #include <error.h>
 
@@ -19,16 +19,14 @@
  * An atomic boolean encapsulates a boolean value with atomic operations.
  */
 struct _PICC_AtomicBoolean {
-    bool val;
-    pthread_mutex_t lock;
+    atomic_bool val;
 };
 
 /**
  * An atomic integer encapsulates an integer value with atomic operations.
  */
 struct _PICC_AtomicInt {
-    int val;
-    pthread_mutex_t lock;
+    atomic_int val;
 };
 
 extern PICC_AtomicBoolean *PICC_create_atomic_bool(bool value, PICC_Error *error);
@@ -37,7 +37,7 @@ struct _PICC_Channel
 { //"implements PICC_Handle" cf gc_repr.h
     /**@{*/
     //global_rc and lock have to be first for PICC_channel to be "castable" as a PICC_KnownHandle
-    int global_rc; /** The number of commitments to that reference
+    atomic_int global_rc; /** The number of commitments to that reference
 
                     this channel (TODO see spec)*/
     PICC_Lock *lock; /** This channel lock to protect from concurrent
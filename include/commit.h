@@ -57,6 +57,11 @@ typedef struct _PICC_Commit PICC_Commit;
  */
 typedef struct _PICC_CommitListElement PICC_CommitListElement;
 
+/**
+ * The link of a commitment used by a commit list
+ */
+typedef enum _PICC_CommitLink PICC_CommitLink;
+
 /**
  * The commit list type
  */
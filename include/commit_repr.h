@@ -12,6 +12,7 @@
 #ifndef COMMIT_REPR_H
 #define COMMIT_REPR_H
 
+#include <stdint.h>
 #include <commit.h>
 #include <pi_thread.h>
 #include <channel_repr.h>
@@ -58,6 +59,28 @@ struct _PICC_OutCommit {
     /**@}*/
 };
 
+/**
+ * The type of an element of a commit list
+ */
+struct _PICC_CommitListElement {
+    /**@{*/
+    PICC_Commit *commit; /**< The referenced commit*/
+    PICC_CommitListElement *next; /** A pointer to the next
+                                            element or NULL if none */
+    /**@}*/
+};
+
+/**
+ * The links of a commitment. A commitment is in the commit list of its
+ * channel and in the one of its pi-thread, through the element embedded
+ * in the commitment for each side.
+ */
+enum _PICC_CommitLink {
+    PICC_COMMIT_CHANNEL_LINK, /**< Link of the channel commit lists */
+    PICC_COMMIT_THREAD_LINK, /**< Link of the pi-thread commit list */
+    PICC_COMMIT_NB_LINKS
+};
+
 /**
  * The commitment common part
  *
@@ -67,34 +90,23 @@ struct _PICC_Commit {
     PICC_CommitType type; /**< The type of the commit */
     PICC_PiThread *thread; /** The pi-thread that has this
                                     commit */
-    PICC_Clock *clock; /** The time when the commitment has
-                                been made */
-    int clockval; /**< The initial value of the clock */
+    uint64_t clockval; /**< The clock of the thread when the commitment
+                            has been made */
     PICC_Label cont_pc; /** The label where the commit's thread will 
                             execute after it's treatment */
     PICC_Channel *channel; /**< The channel of this commitment */
     /**@}*/
     /**
-     * The specific part of the commitments. One of the pointers
-     * below should always be NULL.
+     * The specific part of the commitments, selected by the type.
      */
     union {
         /**@{*/
-        PICC_InCommit *in; /**< The in commitment specific part */
-        PICC_OutCommit *out; /**< The out commitment specific part */
+        PICC_InCommit in; /**< The in commitment specific part */
+        PICC_OutCommit out; /**< The out commitment specific part */
         /**@}*/
     } content;
-};
-
-/**
- * The type of an element of a commit list
- */
-struct _PICC_CommitListElement {
-    /**@{*/
-    PICC_Commit *commit; /**< The referenced commit*/
-    PICC_CommitListElement *next; /** A pointer to the next
-                                            element or NULL if none */
-    /**@}*/
+    PICC_CommitListElement links[PICC_COMMIT_NB_LINKS]; /**< The elements of
+                                                           the commit lists */
 };
 
 /**
@@ -105,12 +117,13 @@ struct _PICC_CommitList {
     PICC_CommitListElement *head; /**< The head of the commit list */
     PICC_CommitListElement *tail; /**< The tail of the commit list */
     int size; /**< The size of the commit list */
+    PICC_CommitLink link; /**< The link of the commitments used by the list */
     /**@}*/
 };
 
 extern PICC_Commit *PICC_create_commitment(PICC_Error *error);
 extern PICC_CommitList * PICC_create_commit_list(PICC_Error *error);
-extern PICC_CommitListElement *PICC_create_commit_list_element(PICC_Commit *commit, PICC_Error *error);
+extern void PICC_init_commit_list(PICC_CommitList *clist, PICC_CommitLink link);
 extern void PICC_reclaim_commitment(PICC_Commit *commit);
 extern void PICC_reclaim_commit_list(PICC_CommitList *clist, PICC_Error *error);
 extern void PICC_reclaim_commit_list_element(PICC_CommitListElement *clist_el, PICC_Error *error);
@@ -11,13 +11,39 @@
 #define CONCURRENT_H
 
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include <pthread.h>
 #include <error.h>
 
-typedef pthread_mutex_t PICC_Lock;
+/**
+ * A lock: a posix mutex, or a plain flag while the synchronisation is
+ * disabled (see PICC_set_locking).
+ */
+typedef struct _PICC_Lock {
+    pthread_mutex_t mutex;
+    bool held; /**< Whether the lock is held, while the synchronisation is
+                   disabled only */
+} PICC_Lock;
 typedef pthread_cond_t PICC_Condition;
 
+/**
+ * An eventcount, on which idle threads park until an event is notified.
+ * A thread takes a key with PICC_eventcount_prepare, checks its condition
+ * again, then waits with the key (or cancels): an event notified in
+ * between makes the wait return at once, so that no wake-up is lost.
+ * Notifying costs a fence and a load while nobody waits.
+ */
+typedef struct _PICC_EventCount {
+    atomic_uint epoch; /**< Bumped by each notification, the futex word */
+    atomic_int waiters; /**< Number of prepared threads */
+#ifndef __linux__
+    pthread_mutex_t lock;
+    PICC_Condition cond;
+#endif
+} PICC_EventCount;
+
+extern void PICC_set_locking(bool enabled);
 extern PICC_Lock *PICC_create_lock(PICC_Error *error);
 extern void PICC_lock_free(PICC_Lock *lock);
 extern void PICC_init_lock(PICC_Lock *lock);
@@ -29,4 +55,11 @@ extern void PICC_cond_wait(PICC_Condition *cond, PICC_Lock *lock);
 extern void PICC_cond_signal(PICC_Condition *cond, PICC_Error *error);
 extern void PICC_cond_broadcast(PICC_Condition *cond, PICC_Error *error);
 
+extern void PICC_init_eventcount(PICC_EventCount *ec);
+extern unsigned PICC_eventcount_prepare(PICC_EventCount *ec);
+extern void PICC_eventcount_cancel(PICC_EventCount *ec);
+extern void PICC_eventcount_wait(PICC_EventCount *ec, unsigned key);
+extern void PICC_eventcount_notify(PICC_EventCount *ec);
+extern void PICC_eventcount_notify_all(PICC_EventCount *ec);
+
 #endif
@@ -61,6 +61,13 @@ typedef enum _PICC_ErrorId {
 
     ERR_INVALID_KNOWNSET_STATE,
 
+    ERR_INVALID_CPULIST,
+    ERR_THREAD_AFFINITY,
+
+    ERR_RUNTIME_CREATE,
+    ERR_RUNTIME_WORKER,
+    ERR_RUNTIME_SERIAL,
+
 } PICC_ErrorId;
 
 #endif
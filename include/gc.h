@@ -12,11 +12,46 @@ typedef void (*PICC_Reclaimer) (PICC_Handle *handled, PICC_Error *error);
 //see comments in gc_repr.h for more informations
 
 static const int PICC_init_clique_max_size = 1000;
-static const int PICC_init_candidates_max_size = 1000;
+static const int PICC_init_channels_max_size = 64;
+static const int PICC_init_visited_capacity = 4096;
+
+/**
+ * Commitments a slice of GC examines, see PICC_gc_slice.
+ */
+#define PICC_GC_SLICE 4096
+
+/**
+ * Slices in a row a search only waits for contended locks before it is
+ * abandoned.
+ */
+#define PICC_GC_MAX_STALLS 16
+
+/**
+ * Handles whose reference count updates a worker buffers before it applies
+ * them, see PICC_handle_defer_dec_ref_count.
+ */
+#define PICC_RC_BUFFER_SIZE 64
+
+typedef struct _PICC_GCScratch PICC_GCScratch;
+
+/**
+ * The outcome of a slice of GC.
+ */
+typedef enum _PICC_GCResult {
+    PICC_GC_RECLAIMED, /**< The search found a clique and reclaimed it */
+    PICC_GC_ABANDONED, /**< The search ended without a clique */
+    PICC_GC_PENDING /**< The search goes on at the next slice */
+} PICC_GCResult;
 
 extern void PICC_handle_incr_ref_count(PICC_Handle *h);
 extern void PICC_handle_dec_ref_count(PICC_Handle **h);
+extern void PICC_handle_defer_incr_ref_count(PICC_Handle *h);
+extern void PICC_handle_defer_dec_ref_count(PICC_Handle *h);
+extern void PICC_handle_flush_ref_counts();
 
+extern PICC_GCResult PICC_gc_slice(PICC_SchedPool *sched, int budget);
 extern bool PICC_GC2(PICC_SchedPool* sched);
+extern long PICC_gc_full(PICC_SchedPool *sched, long *nb_components);
+extern void PICC_free_gc_scratch(PICC_GCScratch *scratch);
 
 #endif
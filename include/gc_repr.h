@@ -1,19 +1,116 @@
 #ifndef GC_REPR_H
 #define GC_REPR_H
 
+#include <stdatomic.h>
+#include <stdint.h>
 #include <gc.h>
+#include <pi_thread.h>
+#include <channel.h>
 
 /* *
  * Interface for the gc to be able to handle all managed value the same way
  * this is now implemented by the PICC_StringHandle and the PICC_Channel
+ *
+ * The global reference count is atomic, see PICC_handle_dec_ref_count; the
+ * lock only protects the content of the value (the commit lists of a
+ * channel).
  */
 struct _PICC_Handle
 {
-    int global_rc;
+    atomic_int global_rc;
     PICC_Lock *lock;
     PICC_Reclaimer reclaim; // pointer to the proper free function
 };
 
+/**
+ * A reference count update of a PICC_RCBuffer.
+ */
+typedef struct _PICC_RCEntry {
+    /**@{*/
+    PICC_Handle *handle; /**< The handle updated, NULL for a free entry */
+    int delta; /**< The decrements not applied yet, negated */
+    /**@}*/
+} PICC_RCEntry;
+
+/**
+ * The reference count updates buffered by a worker, coalesced by handle
+ * in a table open addressed with linear probing, twice as large as the
+ * PICC_RC_BUFFER_SIZE handles it holds before it is flushed.
+ *
+ * Only decrements are buffered, an increment cancels one of them or is
+ * applied at once: the global count of a handle never falls below its
+ * references, so it can't reach zero while a worker still buffers one.
+ */
+typedef struct _PICC_RCBuffer {
+    /**@{*/
+    PICC_RCEntry entries[2 * PICC_RC_BUFFER_SIZE];
+    int size; /**< The number of entries used */
+    /**@}*/
+} PICC_RCBuffer;
+
+/**
+ * An entry of a PICC_GCSet.
+ */
+typedef struct _PICC_GCSetEntry {
+    /**@{*/
+    const void *key; /**< The address in the set */
+    unsigned epoch; /**< The epoch of the set when it was added */
+    /**@}*/
+} PICC_GCSetEntry;
+
+/**
+ * A set of addresses, open addressed with linear probing. An entry is in
+ * the set iff its epoch is the one of the set, so that emptying the set
+ * only bumps the epoch.
+ */
+typedef struct _PICC_GCSet {
+    /**@{*/
+    PICC_GCSetEntry *entries;
+    int capacity; /**< The number of entries, a power of two */
+    int size; /**< The number of addresses in the set */
+    unsigned epoch; /**< The current epoch, never 0 */
+    /**@}*/
+} PICC_GCSet;
+
+/**
+ * The search of a collector, kept from one slice of PICC_gc_slice to the
+ * next, in buffers reused from one search to the next: they only grow to
+ * the size of the largest clique met.
+ *
+ * The members are the pi-threads of the clique found so far, locked and
+ * fetched from the wait queue while a slice runs. Between two slices they
+ * are unlocked in the old zone of the wait queue, so that an awakener
+ * never waits for a whole search: the next slice takes them again, with
+ * the clocks they had once taken, and abandons the search if one of them
+ * was awoken meanwhile. The channels are the
+ * ones met, locked only while their commit lists are walked: the members
+ * before next_member and the channels before next_channel have been
+ * followed. A channel whose lock or one of whose pi-threads could not be
+ * taken is put in the retries, walked again at the next slices; the
+ * search is abandoned once it only waits for the retries for
+ * PICC_GC_MAX_STALLS slices in a row.
+ */
+struct _PICC_GCScratch {
+    /**@{*/
+    bool searching; /**< Whether a search is in progress */
+    PICC_PiThread **members;
+    uint64_t *clocks; /**< The clocks of the members once taken */
+    int nb_members;
+    int next_member;
+    int members_max;
+    PICC_Channel **channels;
+    int nb_channels;
+    int next_channel;
+    int channels_max;
+    PICC_Channel **retries;
+    int nb_retries;
+    int retries_max;
+    int stalls; /**< The slices in a row that only failed retries */
+    PICC_GCSet visited; /**< The members and channels met */
+    PICC_GCSet counted; /**< The pi-threads met on the current channel */
+    /**@}*/
+};
+
 #define LOCK_HANDLE(c) \
     PICC_acquire(((c)->lock));
 
@@ -44,6 +44,9 @@ struct _PICC_KnownElement{
 /**
  * A set of known elements.
  *
+ * A set may be embedded in the memory block of its owner (a pi-thread),
+ * in which case neither the set nor its initial content are freed.
+ *
  * @inv 0 <= current_size <= max_size
  */
 struct _PICC_KnownSet
@@ -51,8 +54,11 @@ struct _PICC_KnownSet
     int max_size;
     int current_size;
     struct _PICC_KnownElement *content;
+    bool embedded; /**< The set is part of another memory block */
+    bool embedded_content; /**< The content is part of another memory block */
 };
 
+extern void PICC_init_knownset(PICC_KnownSet *knownset, PICC_KnownElement *content, int max_size);
 extern PICC_KnownElement *PICC_knownset_get_element(PICC_KnownSet *knownset, PICC_KnownValue *val);
 
 // invariants
@@ -33,14 +33,20 @@ typedef enum _PICC_StatusKind PICC_StatusKind;
 typedef enum _PICC_TryResult PICC_TryResult;
 
 /**
- * The PiThread data type
+ * The priority class of a pi-thread, only honoured by the ready queues
+ * under PICC_READY_PRIORITY.
  */
-typedef struct _PICC_PiThread PICC_PiThread;
+typedef enum _PICC_Priority {
+    PICC_PRIORITY_NORMAL,
+    PICC_PRIORITY_HIGH, /**< Runs before the other ready pi-threads */
+    PICC_PRIORITY_LOW /**< Goes to the end of the ready queue, even when
+                          pushed to run next */
+} PICC_Priority;
 
 /**
- * A type to represent PiThread clocks
+ * The PiThread data type
  */
-typedef struct _PICC_Clock PICC_Clock;
+typedef struct _PICC_PiThread PICC_PiThread;
 
 /**
  * The procedure type that a pi-thread executes. May use a couple of
@@ -49,8 +55,12 @@ typedef struct _PICC_Clock PICC_Clock;
 typedef void (PICC_PiThreadProc)(struct _PICC_SchedPool *, PICC_PiThread *);
 
 extern PICC_PiThread *PICC_create_pithread(int env_length, int knowns_length, int enabled_length);
+extern void PICC_pithread_pool_prewarm(int env_length, int knowns_length, int enabled_length, int count);
+extern void PICC_pithread_pool_clear();
 extern enum _PICC_CommitStatus PICC_can_awake(PICC_PiThread *pt, struct _PICC_Commit *commit);
 extern void PICC_awake(struct _PICC_SchedPool *sched, PICC_PiThread *pt, struct _PICC_Commit *commit);
+extern void PICC_yield(struct _PICC_SchedPool *sched, PICC_PiThread *pt);
+extern void PICC_spawn(struct _PICC_SchedPool *sched, PICC_PiThread **pts, int n);
 extern void PICC_process_end(PICC_PiThread *pt, PICC_StatusKind status);
 extern void PICC_low_level_yield();
 
@@ -12,6 +12,8 @@
 #define PI_THREAD_REPR_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pi_thread.h>
 #include <scheduler.h>
 #include <channel.h>
@@ -20,23 +22,38 @@
 #include <concurrent.h>
 #include <atomic.h>
 #include <error.h>
+#include <commit_repr.h>
+#include <knownset_repr.h>
 
 static const PICC_Label PICC_DEFAULT_ENTRY_LABEL = 0;
 
 /**
  * The maximum number of iterations a thread can execute without being scheduled.
+ * It is the default fuel budget of a runtime, see PICC_set_fuel.
  */
 static const int PICC_FUEL_INIT = 10;//358;
 
 /**
- * Invalid position in the program counter.
+ * The smallest slice of fuel given to a thread, however deep the ready queue.
  */
-static const int PICC_INVALID_PC = -1;
+static const int PICC_FUEL_MIN = 2;
+
+/**
+ * Consumes one step of fuel of the running pi-thread. Once the fuel is
+ * exhausted, the procedure returns as a call with no fuel left: the worker
+ * then yields the pi-thread, once the procedure is done with it.
+ */
+#define PICC_FUEL_STEP(pt)                      \
+    if (--(pt)->fuel <= 0) {                    \
+        (pt)->status = PICC_STATUS_CALL;        \
+        (pt)->fuel = 0;                         \
+        return;                                 \
+    }
 
 /**
- *  The maximum value a PiThread clock may have
+ * Invalid position in the program counter.
  */
-static const int PICC_CLOCK_MAX_INT = 1000;
+static const int PICC_INVALID_PC = -1;
 
 /**
  * The status of a pi-thread
@@ -44,7 +61,9 @@ static const int PICC_CLOCK_MAX_INT = 1000;
 enum _PICC_StatusKind {
     PICC_STATUS_RUN, /**< A pi-thread that is ready to run */
     PICC_STATUS_CALL, /**< A pi-thread that is actually running */
-    PICC_STATUS_WAIT, /**< A waiting pi-thread */
+    PICC_STATUS_WAIT, /**< A waiting pi-thread. Its procedure returns with
+                          this status once its commitments are registered,
+                          the worker then puts it in the wait queue */
     PICC_STATUS_ENDED, /**< An ended pi-thread */
     PICC_STATUS_BLOCKED /** A blocked pi-thread (a sleeping pi-thread
                         that can't be awaked) */
@@ -60,22 +79,34 @@ enum _PICC_TryResult {
 };
 
 /**
- * A type to represent PiThread clocks
- */
-struct _PICC_Clock {
-    /**@{*/
-    PICC_AtomicInt *val; /** Contains the timestamp when the clock has
-                           * been stopped. TODO a function that puts a
-                           * timestamp in a clock */
-    /**@{*/
-};
-
-/**
- * The PiThread data type
+ * The PiThread data type.
+ *
+ * A pi-thread is allocated as a single cache-line aligned block. The fields
+ * used at each scheduling step come first so that they share the first
+ * cache line, the bookkeeping fields follow, and the environment, the
+ * initial knowns set content and the enabled flags are trailing arrays of
+ * the same block.
  */
 struct _PICC_PiThread {
     /**@{*/
     PICC_StatusKind status; /**< The pi-thread status */
+    int fuel; /** Number of iterations of the pi-thread execution after
+                wich it goes to the end of the ready queue, refilled
+                each time it is popped */
+    PICC_Priority priority; /**< The priority class of the pi-thread */
+    PICC_Label pc; /** The label to the execution point of the
+                        pi-thread procedure */
+    int env_length; /**< The number of variables in the environment */
+    PICC_PiThreadProc *proc; /** The pi-thread procedure to execute */
+    PICC_Value *env; /**< The local pi-thread variables */
+    PICC_Value val; /** Buffer used as a worskpace in the generated code  */
+    PICC_Commit *commit; /** The last commitment of the
+                                    pi-thread */
+    _Atomic uint64_t clock; /** The pi-thread clock, incremented at each
+                                wake-up. A commitment is valid while the
+                                clock has the value it had when the
+                                commitment was registered */
+    PICC_PiThread *ready_next; /** Intrusive link of the ready queue inboxes */
     bool *enabled; /**< In case of a guarded choice tells if a choice i
                         may or may not be followed */
     int enabled_length; /** Length of enabeled choices at the next
@@ -84,28 +115,94 @@ struct _PICC_PiThread {
     /*                           thread *\/ */
     PICC_KnownSet *knowns; /** The channels known by this
                                         thread */
-    PICC_Value *env; /**< The local pi-thread variables */
-    int env_length; /**< The number of variables in the environment */
-    PICC_Commit *commit; /** The last commitment of the
-                                    pi-thread */
     PICC_CommitList *commits; /** The commitments of this
                                     pi-thread */
-    PICC_PiThreadProc *proc; /** The pi-thread procedure to execute */
-    PICC_Label pc; /** The label to the execution point of the
-                        pi-thread procedure */
-    PICC_Value val; /** Buffer used as a worskpace in the generated code  */
-    PICC_Clock *clock; /** The pi-thread clock. TODO see
-                                spec */
-    int fuel; /** Number of iterations of the pi-thread execution after
-                wich it goes to the end of the ready queue */
     PICC_Lock *lock; /** The lock of the pi-thread. TODO see spec */
+    PICC_PiThread *wait_next; /** Intrusive links of the wait queue */
+    PICC_PiThread *wait_prev;
+    unsigned long wait_zone; /** Wait queue zone of the pi-thread,
+                                 PICC_WAIT_ZONE_NONE if it is not waiting */
+    _Atomic int gc_pin; /** PICC_GC_PIN_PAUSED while the pi-thread is a
+                            member of a paused GC search */
+    PICC_KnownSet knowns_set; /** Storage of the knowns set */
+    PICC_CommitList commits_list; /** Storage of the commitment list */
+    PICC_Lock lock_storage; /** Storage of the lock */
+    int knowns_length; /** Initial size of the knowns set */
+    size_t block_size; /** Size of the whole pi-thread block */
+    _Alignas(PICC_Value) unsigned char storage[]; /** Trailing arrays: env,
+                                                      knowns content, enabled */
     /**@}*/
 };
 
-extern PICC_Clock *PICC_create_clock(PICC_Error *error);
-extern void PICC_reclaim_clock(PICC_Clock *clock);
+/**
+ * The pin of a pi-thread taken by a GC search: a pi-thread reclaimed while
+ * the search is paused is left to the collector (see PICC_GCScratch).
+ */
+#define PICC_GC_PIN_NONE 0
+#define PICC_GC_PIN_PAUSED 1
+#define PICC_GC_PIN_RECLAIMED 2
+
+/**
+ * Number of pi-thread shapes a recycling pool can hold.
+ */
+#define PICC_PITHREAD_POOL_SHAPES 8
+
+/**
+ * Maximum number of reclaimed pi-threads of one shape kept by a worker.
+ * Beyond it, half of them are given back to the shared depot.
+ */
+#define PICC_PITHREAD_POOL_MAX 64
+
+/**
+ * Maximum number of pi-threads of one shape kept by the shared depot.
+ * Beyond it, reclaimed pi-threads are freed.
+ */
+#define PICC_PITHREAD_DEPOT_MAX 4096
+
+/**
+ * Number of pi-threads of the entry shape pre-allocated by a runtime.
+ */
+#define PICC_PITHREAD_POOL_PREWARM 64
+
+typedef struct _PICC_PiThreadBucket PICC_PiThreadBucket;
+typedef struct _PICC_PiThreadPool PICC_PiThreadPool;
+
+/**
+ * The reclaimed pi-threads of one shape, linked by their ready_next field.
+ */
+struct _PICC_PiThreadBucket {
+    /**@{*/
+    int env_length; /**< Shape of the pi-threads */
+    int knowns_length;
+    int enabled_length;
+    PICC_PiThread *free; /**< The reclaimed pi-threads */
+    int size; /**< The number of reclaimed pi-threads */
+    /**@}*/
+};
+
+/**
+ * A recycling pool of pi-threads, keyed by their shape. Each worker has
+ * its own pool, without synchronisation, and the workers share a depot
+ * protected by a lock.
+ */
+struct _PICC_PiThreadPool {
+    /**@{*/
+    PICC_PiThreadBucket buckets[PICC_PITHREAD_POOL_SHAPES];
+    int nb_buckets; /**< The number of shapes used */
+    /**@}*/
+};
+
+/**
+ * Returns the current clock value of the given pi-thread.
+ */
+static inline uint64_t PICC_pithread_clock(PICC_PiThread *pt)
+{
+    return atomic_load_explicit(&pt->clock, memory_order_acquire);
+}
 
 extern void PICC_PiThread_inv(PICC_PiThread *pt);
 extern void PICC_reclaim_pi_thread(PICC_PiThread *pt);
+extern void PICC_pithread_pool_flush();
+extern long PICC_pithread_nb_allocs();
 
 #endif
@@ -16,14 +16,24 @@
 struct _PICC_PiThread;
 
 /**
- * The standard PiThread queue cell type
+ * The standard PiThread queue type
  */
-typedef struct _PICC_QueueCell PICC_QueueCell;
+typedef struct _PICC_Queue PICC_Queue;
 
 /**
- * The standard PiThread queue type
+ * The lock-free inbox type of the ready queues
  */
-typedef struct _PICC_Queue PICC_Queue;
+typedef struct _PICC_ReadyInbox PICC_ReadyInbox;
+
+/**
+ * The circular array type of the work deques
+ */
+typedef struct _PICC_DequeArray PICC_DequeArray;
+
+/**
+ * The per-worker ready deque type
+ */
+typedef struct _PICC_WorkDeque PICC_WorkDeque;
 
 /**
  * The ready PiThread queue type
@@ -31,13 +41,32 @@ typedef struct _PICC_Queue PICC_Queue;
 typedef struct _PICC_ReadyQueue PICC_ReadyQueue;
 
 /**
- * The wait PiThread queue type
+ * The discipline of a ready queue: where PICC_ready_queue_push,
+ * PICC_ready_queue_add and PICC_ready_queue_handoff put a PiThread. A
+ * preempted PiThread always goes to the end (PICC_ready_queue_yield).
+ */
+typedef enum _PICC_ReadyPolicy {
+    PICC_READY_MIXED, /**< The call site decides: a pushed or handed off
+                          PiThread runs next, an added one goes to the end */
+    PICC_READY_LIFO, /**< Every PiThread runs next on its worker, for the
+                         cache locality */
+    PICC_READY_FIFO, /**< Every PiThread goes to the end, for fairness */
+    PICC_READY_PRIORITY /**< As PICC_READY_MIXED, but the high priority
+                            PiThreads run before any other and the low
+                            priority ones go to the end */
+} PICC_ReadyPolicy;
+
+/**
+ * The wait PiThread queue type. A PiThread waits by returning from its
+ * procedure with the PICC_STATUS_WAIT status, once its commitments are
+ * registered: its worker then puts it in the wait queue, which the
+ * generated code never does itself.
  */
 typedef struct _PICC_WaitQueue PICC_WaitQueue;
 
 extern void PICC_ready_queue_push(PICC_ReadyQueue *rq, PICC_PiThread *pt);
 extern void PICC_ready_queue_add(PICC_ReadyQueue *rq, PICC_PiThread *pt);
-extern void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt);
+extern void PICC_ready_queue_add_batch(PICC_ReadyQueue *rq, PICC_PiThread **pts, int n);
 
 extern void PICC_free_queue(PICC_Queue *q);
 extern void PICC_free_wait_queue(PICC_WaitQueue *wq);
@@ -10,49 +10,169 @@
 #ifndef QUEUE_REPR_H
 #define QUEUE_REPR_H
 
+#include <stdatomic.h>
 #include <queue.h>
 #include <concurrent.h>
 #include <error.h>
 
 /**
- * The standard PiThread queue cell type
+ * Size of a cache line, used to keep the worker deques apart.
  */
-struct _PICC_QueueCell {
-    PICC_PiThread *thread;
-    PICC_QueueCell *next;
-};
+#define PICC_CACHE_LINE_SIZE 64
+
+/**
+ * Initial capacity of a work deque array (must be a power of two).
+ */
+#define PICC_DEQUE_INIT_CAPACITY 64
+
+/**
+ * Number of PiThreads a worker may pop in a row from its runnext slot
+ * before the slot is spilled to its inbox, so that two PiThreads handing
+ * off to each other do not starve the others.
+ */
+#define PICC_RUNNEXT_MAX_HANDOFFS 32
+
+/**
+ * Maximum number of PiThreads a worker steals at once, the first one to
+ * run and the others moved to its own deque.
+ */
+#define PICC_READY_STEAL_BATCH 16
 
 /**
- * The standard PiThread queue type
+ * The standard PiThread queue type. The PiThreads are linked through their
+ * wait_next field, so no cell is allocated.
  */
 struct _PICC_Queue {
-    PICC_QueueCell *head;
-    PICC_QueueCell *tail;
+    PICC_PiThread *head;
+    PICC_PiThread *tail;
     int size;
 };
 
+/**
+ * A lock-free stack of PiThreads linked through their ready_next field.
+ * Producers push one PiThread at a time, consumers grab the whole stack at
+ * once, which keeps both operations free from the ABA problem.
+ */
+struct _PICC_ReadyInbox {
+    _Atomic(PICC_PiThread *) top;
+    atomic_int size;
+};
+
+/**
+ * The circular array of a work deque. The arrays replaced by a bigger one
+ * are kept in the prev list until the deque is freed, since a thief may
+ * still be reading them.
+ */
+struct _PICC_DequeArray {
+    long capacity;
+    PICC_DequeArray *prev;
+    _Atomic(PICC_PiThread *) slots[];
+};
+
+/**
+ * A per-worker ready deque (Chase-Lev). The owning worker pushes and pops at
+ * the bottom without locking, the other workers steal at the top with a
+ * single CAS. PiThreads appended to the worker (PICC_ready_queue_add) go to
+ * its inbox and are moved into the deque once it runs dry. A PiThread
+ * handed off to the worker (PICC_ready_queue_handoff) waits in the runnext
+ * slot, popped before anything else.
+ */
+struct _PICC_WorkDeque {
+    _Alignas(PICC_CACHE_LINE_SIZE) atomic_long top;
+    atomic_long bottom;
+    _Atomic(PICC_DequeArray *) array;
+    PICC_ReadyInbox inbox;
+    _Atomic(PICC_PiThread *) runnext; /**< The next PiThread to run, if any */
+    int handoffs; /**< Pops in a row from runnext, owner only */
+};
+
 /**
  * The ready PiThread queue type
+ *
+ * Each scheduler thread (worker) owns one deque. Threads that are not
+ * bound to a worker (e.g. the runtime initialisation) use the shared
+ * inbox.
+ *
+ * The PiThreads in flight are the ready ones and the popped ones still
+ * running: only them can make other PiThreads ready, so the runtime is
+ * quiescent once none is left. Idle workers park on the idle eventcount,
+ * notified by each push.
+ *
+ * An idle worker steals from the workers of its NUMA node first.
+ *
+ * The policy of the queue decides whether a pushed PiThread runs next or
+ * goes to the end (see PICC_ReadyPolicy). Under PICC_READY_PRIORITY, the
+ * high priority PiThreads of all the workers go to the urgent inbox,
+ * popped before anything else.
+ *
+ * A seeded ready queue (see PICC_ready_queue_set_seed) is used by a single
+ * thread, bound to the worker 0: its pops draw the PiThreads at random
+ * from a xorshift generator, so that a seed always gives the same schedule.
  */
 struct _PICC_ReadyQueue {
-    PICC_Queue q;
-    PICC_Lock *lock;
+    PICC_ReadyInbox shared; /**< Inbox of the threads not bound to a worker */
+    PICC_ReadyInbox urgent; /**< Inbox of the high priority PiThreads,
+                                under PICC_READY_PRIORITY only */
+    PICC_ReadyPolicy policy; /**< Where the pushed PiThreads go */
+    PICC_WorkDeque *deques; /**< The per-worker deques */
+    int nb_workers; /**< The number of worker deques */
+    int *nodes; /**< The NUMA node of each worker, 0 by default */
+    int nb_nodes; /**< 1 + the highest node of a worker */
+    _Alignas(PICC_CACHE_LINE_SIZE) atomic_int in_flight; /**< The PiThreads ready or running */
+    PICC_EventCount idle; /**< The eventcount of the idle workers */
+    unsigned long seed; /**< The state of the generator of the pops, 0
+                            for the canonical order */
 };
 
+/**
+ * Wait zone of a PiThread that is not in a wait queue.
+ */
+#define PICC_WAIT_ZONE_NONE 0
+
+/**
+ * Wait zone of the PiThreads pushed directly in the old zone.
+ */
+#define PICC_WAIT_ZONE_OLD 1
+
+/**
+ * First wait zone number of the active zone.
+ */
+#define PICC_WAIT_ZONE_FIRST_ACTIVE 2
+
 /**
  * The wait PiThread queue type
+ *
+ * The active zone is linked before the old zone: active.tail->wait_next
+ * is old.head. A PiThread is in the active zone iff its wait_zone equals
+ * active_zone, so that resetting the active zone only has to bump
+ * active_zone to move all its PiThreads to the old zone.
  */
 struct _PICC_WaitQueue {
     PICC_Queue active;
     PICC_Queue old;
+    unsigned long active_zone; /**< The current number of the active zone */
     PICC_Lock *lock;
 };
 
 extern PICC_ReadyQueue *PICC_create_ready_queue(PICC_Error *error);
+extern PICC_ReadyQueue *PICC_create_worker_ready_queue(int nb_workers, PICC_Error *error);
+extern void PICC_ready_queue_bind_worker(PICC_ReadyQueue *rq, int worker);
+extern void PICC_ready_queue_set_node(PICC_ReadyQueue *rq, int worker, int node);
+extern void PICC_ready_queue_set_seed(PICC_ReadyQueue *rq, unsigned long seed);
+extern void PICC_ready_queue_set_policy(PICC_ReadyQueue *rq, PICC_ReadyPolicy policy);
+extern void PICC_ready_queue_yield(PICC_ReadyQueue *rq, struct _PICC_PiThread *pt);
+extern void PICC_ready_queue_scatter(PICC_ReadyQueue *rq, struct _PICC_PiThread **pts, int n,
+                                     int nb_workers);
+extern void PICC_ready_queue_handoff(PICC_ReadyQueue *rq, struct _PICC_PiThread *pt);
 extern struct _PICC_PiThread *PICC_ready_queue_pop(PICC_ReadyQueue *rq);
+extern int PICC_ready_queue_pop_batch(PICC_ReadyQueue *rq, struct _PICC_PiThread **buf, int k);
+extern struct _PICC_PiThread *PICC_ready_queue_steal(PICC_ReadyQueue *rq, int victim);
 extern int PICC_ready_queue_size(PICC_ReadyQueue *rq);
+extern bool PICC_ready_queue_done(PICC_ReadyQueue *rq);
+extern int PICC_ready_queue_in_flight(PICC_ReadyQueue *rq);
 
 extern PICC_WaitQueue *PICC_create_wait_queue(PICC_Error *error);
+extern void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt);
 extern PICC_PiThread *PICC_wait_queue_fetch(PICC_WaitQueue *wq, PICC_PiThread *pt);
 extern void PICC_wait_queue_push_old(PICC_WaitQueue *wq, PICC_PiThread *pt, PICC_Error *error);
 extern PICC_PiThread *PICC_wait_queue_pop_old(PICC_WaitQueue *wq);
@@ -62,8 +182,8 @@ extern void PICC_wait_queue_max_active_reset(PICC_WaitQueue *wq);
 
 // Queue structures invariants
 extern void PICC_Queue_inv(PICC_Queue *queue);
-extern void PICC_QueueCell_inv(PICC_QueueCell *cell);
 extern void PICC_ReadyQueue_inv(PICC_ReadyQueue *queue);
+extern void PICC_WorkDeque_inv(PICC_WorkDeque *deque);
 extern void PICC_WaitQueue_inv(PICC_WaitQueue *queue);
 
 #endif
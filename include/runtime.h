@@ -12,8 +12,95 @@
 
 #include <scheduler.h>
 #include <pi_thread.h>
+#include <queue.h>
+#include <topology.h>
 #include <error.h>
 
+/**
+ * Default GC parameters of a runtime, see PICC_RuntimeConfig.
+ */
+#define PICC_STD_GC_FUEL 1000
+#define PICC_QUICK_GC_FUEL 100
+#define PICC_ACTIVE_FACTOR 2
+
+/**
+ * The parameters of a runtime, initialised to their defaults by
+ * PICC_runtime_config_init.
+ */
+typedef struct _PICC_RuntimeConfig {
+    /**@{*/
+    int nb_core_threads; /**< Number of slave workers, besides the master */
+    int min_core_threads; /**< Number of slaves always active, the others
+                              are woken up when the ready queue is under
+                              pressure; negative (the default) to keep
+                              the nb_core_threads slaves active */
+    int std_gc_fuel; /**< PiThreads the workers run between two GCs, 0 disables the GC */
+    int quick_gc_fuel; /**< The same after an unsuccessful GC */
+    int active_factor; /**< Ratio between the waiting PiThreads and the
+                           active ones above which the collector collects */
+    int stw_threshold; /**< Growth of the wait queue between two GCs above
+                           which the collector stops the workers and
+                           collects every clique at once, 0 (the default)
+                           to never stop them */
+    int fuel; /**< Fuel budget of the pi-thread slices, see PICC_set_fuel */
+    PICC_ReadyPolicy policy; /**< Discipline of the ready queue */
+    PICC_PinMode pin_mode; /**< Pinning of the workers, see PICC_set_pinning */
+    const char *cpus; /**< Cpulist of the allowed CPUs, NULL for the
+                          affinity of the process */
+    bool serial; /**< Whether to run every PiThread on the thread joining
+                     the runtime, without workers nor synchronisation;
+                     nb_core_threads, min_core_threads and the pinning are
+                     then ignored */
+    unsigned long seed; /**< Seed of the order in which a serial runtime
+                            runs the ready PiThreads, 0 for the canonical
+                            order */
+    /**@}*/
+} PICC_RuntimeConfig;
+
+/**
+ * The state of a runtime once joined.
+ */
+typedef enum _PICC_RuntimeStatus {
+    PICC_RUNTIME_DONE, /**< Every PiThread has ended */
+    PICC_RUNTIME_BLOCKED, /**< Some PiThreads wait forever */
+    PICC_RUNTIME_ERROR /**< A worker failed, see the error stack */
+} PICC_RuntimeStatus;
+
+/**
+ * A snapshot of the sizing and of the GC of a runtime, see
+ * PICC_runtime_stats.
+ */
+typedef struct _PICC_RuntimeStats {
+    /**@{*/
+    int nb_workers; /**< Workers created, the master included */
+    int nb_active; /**< Workers active, the master included */
+    int nb_idle; /**< Active workers parked for lack of work */
+    int in_flight; /**< PiThreads ready or running */
+    long nb_samples; /**< Samples taken by the adaptive sizing */
+    long nb_grows; /**< Slaves woken up by the adaptive sizing */
+    long nb_shrinks; /**< Slaves put to sleep by the adaptive sizing */
+    long nb_gc_runs; /**< Cliques looked for by the GC */
+    long nb_gc_cliques; /**< Cliques reclaimed by the GC */
+    long nb_gc_slices; /**< Slices of search run by the GC */
+    long nb_gc_stops; /**< Full collections with the workers stopped */
+    double gc_seconds; /**< Time spent collecting */
+    /**@}*/
+} PICC_RuntimeStats;
+
+/**
+ * A running runtime: its scheduler pool and workers.
+ */
+typedef struct _PICC_Runtime PICC_Runtime;
+
+extern void PICC_set_fuel(int fuel);
+extern void PICC_set_pinning(PICC_PinMode mode, const char *cpus);
+extern void PICC_runtime_config_init(PICC_RuntimeConfig *config);
+extern PICC_Runtime *PICC_create_runtime(const PICC_RuntimeConfig *config, PICC_Error *error);
+extern void PICC_runtime_spawn(PICC_Runtime *rt, PICC_PiThreadProc *entrypoint,
+                int env_length, int knowns_length, int enabled_length);
+extern PICC_RuntimeStatus PICC_runtime_join(PICC_Runtime *rt, PICC_Error *error);
+extern void PICC_runtime_stats(PICC_Runtime *rt, PICC_RuntimeStats *stats);
+extern void PICC_runtime_shutdown(PICC_Runtime *rt);
 extern void PICC_main(int nb_core_threads, PICC_PiThreadProc *entrypoint,
                 int std_gc_fuel, int quick_gc_fuel, int active_factor,
                 int entry_env_length, int entry_knowns_length, int entry_enabled_length);
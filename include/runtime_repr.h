@@ -0,0 +1,40 @@
+/**
+ * @file runtime_repr.h
+ * Runtime lifecycle.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef RUNTIME_REPR_H
+#define RUNTIME_REPR_H
+
+#include <pthread.h>
+#include <runtime.h>
+#include <scheduler_repr.h>
+#include <error.h>
+
+/**
+ * A running runtime. Each worker, the master included, runs in its own
+ * posix thread with its own error stack, and parks while the runtime is
+ * quiescent, as does the collector. The runtime owns everything it
+ * created, released by PICC_runtime_shutdown. A serial runtime has no
+ * thread: its master runs during each PICC_runtime_join.
+ */
+struct _PICC_Runtime {
+    /**@{*/
+    PICC_SchedPool *sched_pool; /**< The scheduler pool of the workers */
+    PICC_Topology *topology; /**< The CPUs of the workers, NULL if they are
+                                 not pinned */
+    int nb_workers; /**< The number of workers, the master is the worker 0 */
+    int nb_threads; /**< The number of workers whose thread was created */
+    pthread_t *threads; /**< The thread of each worker */
+    pthread_t collector; /**< The thread running the GC */
+    bool has_collector; /**< Whether the collector thread was created */
+    PICC_Args **args; /**< The arguments of each worker */
+    PICC_Error *errors; /**< The error stack of each worker */
+    bool serial; /**< Whether the master runs on the thread joining the
+                     runtime, without any other worker */
+    /**@}*/
+};
+
+#endif
@@ -11,13 +11,59 @@
 #ifndef SCHEDULER_REPR_H
 #define SCHEDULER_REPR_H
 
+#include <stdatomic.h>
 #include <scheduler.h>
 #include <queue.h>
+#include <topology.h>
 #include <concurrent.h>
 #include <error.h>
 
+/**
+ * Number of PiThreads a worker runs between two samples of the adaptive
+ * sizing of the pool.
+ */
+#define PICC_SCHED_ADAPT_PERIOD 64
+
+/**
+ * Number of samples in a row a pressure or an idleness must last before
+ * a slave is woken up or put to sleep.
+ */
+#define PICC_SCHED_ADAPT_SAMPLES 4
+
+/**
+ * Number of PiThreads in flight per active worker above which the pool is
+ * under pressure.
+ */
+#define PICC_SCHED_GROW_DEPTH 2
+
+/**
+ * Nice value of the collector thread, above the one of the workers so that
+ * it runs on the CPU time they leave.
+ */
+#define PICC_SCHED_COLLECTOR_NICE 10
+
 /**
  * This type contains all the scheduler data
+ *
+ * Only the slaves 1..nb_active run PiThreads. Every PICC_SCHED_ADAPT_PERIOD
+ * PiThreads, a worker samples the pool: a slave is woken up when the
+ * PiThreads in flight outnumber the active workers PICC_SCHED_GROW_DEPTH
+ * times, the last active slave goes dormant when the PiThreads in flight
+ * are fewer than the active workers, or as many but some worker idled
+ * since the last sample, each for PICC_SCHED_ADAPT_SAMPLES samples in a
+ * row, within min_active and nb_workers - 1.
+ *
+ * The GC runs on a collector thread of its own. The workers count the
+ * PiThreads they run down from gc_fuel, the one reaching zero requests a
+ * GC and wakes the collector up, which collects while the wait queue has
+ * grown too much (see PICC_sched_pool_collect). The pool is not quiescent
+ * until the requested GC is done.
+ *
+ * When the wait queue has grown stw_threshold PiThreads since the last
+ * GC, the collector stops the world instead: it raises stopping and waits
+ * until no worker runs a PiThread, the workers check it between two
+ * PiThreads and park until the collector resumes them. The workers only
+ * count themselves in nb_mutators when stw_threshold is set.
  */
 struct _PICC_SchedPool {
     /**@{*/
@@ -25,13 +71,65 @@ struct _PICC_SchedPool {
                                         pi-threads ready tuo run */
     PICC_WaitQueue *wait; /** The queue that contains the
                                     waiting or blocked pi-threads */
-    PICC_Lock lock; /**< The scheduler lock. TODO see spec */
-    PICC_Condition cond; /** The scheduler condition. Used to
-                            synchronise the running posix threads. */
     int nb_slaves; /** The number of running posix threads in the
                         schedpool. */
-    int nb_waiting_slaves; /**< The number of waiting posix threads. */
-    bool running; /**< Specifies if the scheduler is actually running */
+    int nb_workers; /**< The number of workers (master and slaves),
+                        each one owns a deque in the ready queue */
+    PICC_Topology *topology; /**< The CPUs of the workers, NULL if they
+                                 are not pinned */
+    PICC_PinMode pin_mode; /**< How the workers are pinned to the topology */
+    int fuel; /**< The fuel budget of a pi-thread slice, see
+                  PICC_sched_pool_fuel */
+    int std_gc_fuel; /**< The PiThreads the master runs between two GCs */
+    int quick_gc_fuel; /**< The same after an unsuccessful GC */
+    int active_factor; /**< The ratio between the waiting PiThreads and the
+                           active ones above which the collector collects */
+    atomic_int gc_fuel; /**< The PiThreads left to run before the next
+                            request of a GC */
+    atomic_bool gc_pending; /**< Set from a request of a GC until the
+                                collector is done with it */
+    PICC_EventCount collect; /**< The eventcount of the collector */
+    struct _PICC_GCScratch *gc_scratch; /**< The buffers of the collector,
+                                            NULL until its first GC */
+    int stw_threshold; /**< The growth of the wait queue since the last GC
+                           above which the collector stops the world, 0
+                           to never stop it */
+    int last_wait_size; /**< The size of the wait queue after the last GC,
+                            for the collector only */
+    atomic_bool stopping; /**< Set while the collector stops the world */
+    atomic_int nb_mutators; /**< The number of workers running a PiThread */
+    PICC_EventCount resume; /**< The eventcount of the workers parked at
+                                the safepoint */
+    bool serial; /**< Whether the master runs alone on the thread of the
+                     runtime, returning once no PiThread is ready */
+    atomic_bool running; /**< Specifies if the scheduler is actually running,
+                             cleared by PICC_sched_pool_stop */
+    atomic_int nb_started; /**< The number of workers started */
+    PICC_EventCount quiescent; /**< Notified when a worker starts and when
+                                   no PiThread is left in flight */
+    int min_active; /**< The number of slaves always active */
+    atomic_int nb_active; /**< The number of active slaves: the slaves
+                              1..nb_active run, the others are dormant */
+    atomic_int nb_idle; /**< The number of active workers parked for lack
+                            of work */
+    atomic_long nb_idle_polls; /**< The number of times a worker found no
+                                   PiThread to run */
+    long last_idle_polls; /**< nb_idle_polls at the last sample */
+    PICC_EventCount dormant; /**< The eventcount of the dormant slaves */
+    atomic_flag adapting; /**< Set while a worker samples the pool */
+    int pressure_samples; /**< Samples in a row with too many PiThreads
+                              ready, for the adapting worker only */
+    int idle_samples; /**< Samples in a row with the pool underused */
+    atomic_long nb_samples; /**< Statistics of the adaptive sizing */
+    atomic_long nb_grows;
+    atomic_long nb_shrinks;
+    atomic_long nb_gc_runs; /**< Statistics of the GC: searches, cliques
+                                reclaimed, slices, stops of the world, time
+                                spent collecting */
+    atomic_long nb_gc_cliques;
+    atomic_long nb_gc_slices;
+    atomic_long nb_gc_stops;
+    atomic_long gc_nanos;
     /**@}*/
 };
 
@@ -43,12 +141,27 @@ struct _PICC_Args {
     /**@{*/
     PICC_Error *error; /**< The errors list */
     PICC_SchedPool *sched_pool; /**< a pointer to the scheduler data */
+    int worker; /**< The index of the worker deque of the slave */
     /**@}*/
 };
 
-extern PICC_SchedPool *PICC_create_sched_pool(PICC_Error *error);
-extern PICC_Args *PICC_create_args(PICC_SchedPool *sp, PICC_Error *err, PICC_Error *error);
+extern PICC_SchedPool *PICC_create_sched_pool(int nb_workers, PICC_Error *error);
+extern PICC_Args *PICC_create_args(PICC_SchedPool *sp, int worker, PICC_Error *err, PICC_Error *error);
+extern void PICC_sched_pool_place(PICC_SchedPool *sp, PICC_Topology *topo, PICC_PinMode mode);
+extern void PICC_sched_pool_pin(PICC_SchedPool *sp, int worker, PICC_Error *error);
+extern void PICC_sched_pool_set_active(PICC_SchedPool *sp, int min_active, int nb_active);
+extern void PICC_sched_pool_set_gc(PICC_SchedPool *sp, int std_gc_fuel, int quick_gc_fuel,
+                                   int active_factor);
+extern void PICC_sched_pool_set_stw(PICC_SchedPool *sp, int stw_threshold);
+extern void PICC_sched_pool_adapt(PICC_SchedPool *sp);
+extern int PICC_sched_pool_fuel(PICC_SchedPool *sp);
 extern void PICC_sched_pool_slave(PICC_Args *args);
-extern void PICC_sched_pool_master(PICC_SchedPool *sp, int std_gc_fuel, int quick_gc_fuel, int active_factor, PICC_Error *error);
+extern void PICC_sched_pool_master(PICC_Args *args);
+extern void PICC_sched_pool_collect(PICC_SchedPool *sp);
+extern void PICC_sched_pool_collector(PICC_SchedPool *sp);
+extern void PICC_sched_pool_wait_started(PICC_SchedPool *sp, int nb_workers);
+extern void PICC_sched_pool_wait_quiescent(PICC_SchedPool *sp);
+extern void PICC_sched_pool_stop(PICC_SchedPool *sp);
+extern void PICC_free_sched_pool(PICC_SchedPool *sp);
 
 #endif
@@ -0,0 +1,33 @@
+/**
+ * @file slab.h
+ * Per-worker slab allocator for the small runtime objects.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/**
+ * Allocation counters of the slab allocator, summed over all the posix
+ * threads that used it.
+ */
+typedef struct _PICC_SlabStats {
+    /**@{*/
+    long allocs;       /**< Objects allocated from the slabs */
+    long frees;        /**< Objects given back to the slabs */
+    long remote_frees; /**< Frees done by another thread than the allocating one */
+    long slabs;        /**< Slabs obtained from the system (one malloc each) */
+    long large_allocs; /**< Objects too big for a slab, given to malloc */
+    long caches;       /**< Slab caches, adopted by the new posix threads
+                            once their owner terminated */
+    /**@}*/
+} PICC_SlabStats;
+
+extern void *PICC_slab_alloc(size_t size);
+extern void PICC_slab_free(void *ptr, size_t size);
+extern void PICC_slab_stats(PICC_SlabStats *stats);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file slab_repr.h
+ * Per-worker slab allocator for the small runtime objects.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef SLAB_REPR_H
+#define SLAB_REPR_H
+
+#include <stdatomic.h>
+#include <slab.h>
+
+/**
+ * Size of a slab. Slabs are aligned on their size, so the slab of an object
+ * is found by masking its address.
+ */
+#define PICC_SLAB_SIZE (64 * 1024)
+
+/**
+ * Number of size classes, and size of the biggest one. Bigger objects are
+ * allocated with malloc.
+ */
+#define PICC_SLAB_NB_CLASSES 8
+#define PICC_SLAB_MAX_OBJECT 256
+
+typedef struct _PICC_SlabObject PICC_SlabObject;
+typedef struct _PICC_Slab PICC_Slab;
+typedef struct _PICC_SlabClass PICC_SlabClass;
+typedef struct _PICC_SlabCache PICC_SlabCache;
+
+/**
+ * A free object, linked in a free list.
+ */
+struct _PICC_SlabObject {
+    PICC_SlabObject *next;
+};
+
+/**
+ * The header at the beginning of each slab. All the objects of a slab
+ * belong to the same size class and cache.
+ */
+struct _PICC_Slab {
+    PICC_SlabCache *owner; /**< The cache the slab belongs to */
+    int size_class; /**< The size class of the slab objects */
+    PICC_Slab *next; /**< Next slab of the owner */
+};
+
+/**
+ * The objects of one size class in a cache.
+ */
+struct _PICC_SlabClass {
+    PICC_SlabObject *free; /**< Free list, only used by the owner */
+    char *bump; /**< Next never allocated object of the current slab */
+    char *end; /**< End of the current slab */
+    _Atomic(PICC_SlabObject *) remote; /**< Objects freed by other threads */
+};
+
+/**
+ * The slab cache of a posix thread.
+ */
+struct _PICC_SlabCache {
+    PICC_SlabClass classes[PICC_SLAB_NB_CLASSES];
+    PICC_Slab *slabs; /**< All the slabs of the cache */
+    PICC_SlabCache *next; /**< Next cache of the registry */
+    PICC_SlabCache *next_orphan; /**< Next cache without owner */
+    // counters, only written by the owner (the adopter of an orphan)
+    atomic_long allocs;
+    atomic_long frees;
+    atomic_long remote_frees;
+    atomic_long nb_slabs;
+    atomic_long large_allocs;
+};
+
+#endif
@@ -12,6 +12,8 @@
 #ifndef TOOLS_H
 #define TOOLS_H
 
+#include <slab.h>
+
 #define PICC_ALLOC(var, type, error) \
     type *var = malloc(sizeof(type)); \
     if (var == NULL) { \
@@ -30,6 +32,27 @@
         NEW_ERROR(error, ERR_OUT_OF_MEMORY); \
     } else
 
+#define PICC_SLAB_ALLOC(var, type, error) \
+    type *var = PICC_slab_alloc(sizeof(type)); \
+    if (var == NULL) { \
+        NEW_ERROR(error, ERR_OUT_OF_MEMORY); \
+    } else
+
+#define PICC_SLAB_ALLOC_CRASH(var, type) \
+    type *var = PICC_slab_alloc(sizeof(type)); \
+    if (var == NULL) { \
+        CRASH_NEW_ERROR(ERR_OUT_OF_MEMORY); \
+    } else
+
+#define PICC_SLAB_MALLOC(var, type, error) \
+    var = PICC_slab_alloc(sizeof(type)); \
+    if (var == NULL) { \
+        NEW_ERROR(error, ERR_OUT_OF_MEMORY); \
+    } else
+
+#define PICC_SLAB_FREE(var, type) \
+    PICC_slab_free(var, sizeof(type))
+
 #define PICC_ALLOC_N_CRASH(var, type, size) \
     type *var = malloc(sizeof(type) * (size)); \
     if (size == 0) { \
@@ -52,13 +75,7 @@
     pthread_mutex_destroy(&m);
 
 #define PICC_FREE_COMMIT(c) \
-    free(c->clock); \
-    free(c->clockval); \
-    free(c->channel); \
-    if(c->type == PICC_IN_COMMIT) \
-        free(c->content.in); \
-    else \
-        free(c->content.out);
+    free(c->channel);
 
 #define PICC_FREE_PITHREAD(p) \
     free(p->enabled); \
@@ -70,7 +87,6 @@
     PICC_FREE_SET(p->commits); \
     free(p->proc); \
     PICC_FREE_VALUE(p->val); \
-    free(p->clock); \
     PICC_FREE_MUTEX(lock);
 
 #define PICC_FREE_VALUE(v) \
@@ -87,10 +103,32 @@
     PICC_set_destroy(s);
 
 
+/**
+ * Contract checking levels, selected at build time with
+ * -DPICC_CONTRACT_LEVEL=<level>:
+ *  - PICC_CONTRACT_OFF: no check at all (release builds)
+ *  - PICC_CONTRACT_CHEAP: constant time preconditions only
+ *  - PICC_CONTRACT_FULL: preconditions, postconditions, invariants and
+ *    the linear membership scans (debug builds, default)
+ */
+#define PICC_CONTRACT_OFF 0
+#define PICC_CONTRACT_CHEAP 1
+#define PICC_CONTRACT_FULL 2
+
+#ifndef PICC_CONTRACT_LEVEL
+#define PICC_CONTRACT_LEVEL PICC_CONTRACT_FULL
+#endif
+
+#if PICC_CONTRACT_LEVEL >= PICC_CONTRACT_CHEAP
 #define CONTRACT_PRE
+#endif
+
+#if PICC_CONTRACT_LEVEL >= PICC_CONTRACT_FULL
 #define CONTRACT_PRE_INV
 #define CONTRACT_POST
 #define CONTRACT_POST_INV
+#define CONTRACT_FULL
+#endif
 
 extern void debug(const char* s);
 
@@ -0,0 +1,36 @@
+/**
+ * @file topology.h
+ * CPU and NUMA topology of the host, and placement of the scheduler
+ * threads on it.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <error.h>
+
+/**
+ * How the scheduler threads are placed on the CPUs.
+ */
+typedef enum _PICC_PinMode {
+    PICC_PIN_NONE, /**< No affinity, the system places the threads */
+    PICC_PIN_CPU, /**< Each worker is pinned to one allowed CPU */
+    PICC_PIN_NODE /**< Each worker is pinned to the allowed CPUs of one NUMA node */
+} PICC_PinMode;
+
+/**
+ * The allowed CPUs of the host, grouped by NUMA node.
+ */
+typedef struct _PICC_Topology PICC_Topology;
+
+extern PICC_Topology *PICC_create_topology(const char *cpus, PICC_Error *error);
+extern void PICC_free_topology(PICC_Topology *topo);
+extern int PICC_topology_worker_cpu(PICC_Topology *topo, int worker);
+extern int PICC_topology_worker_node(PICC_Topology *topo, int worker);
+extern bool PICC_topology_pin(PICC_Topology *topo, PICC_PinMode mode, int worker);
+extern int PICC_current_node();
+
+#endif
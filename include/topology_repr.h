@@ -0,0 +1,37 @@
+/**
+ * @file topology_repr.h
+ * CPU and NUMA topology of the host, and placement of the scheduler
+ * threads on it.
+ *
+ * This project is released under MIT License.
+ */
+
+#ifndef TOPOLOGY_REPR_H
+#define TOPOLOGY_REPR_H
+
+#include <stdbool.h>
+#include <topology.h>
+
+/**
+ * Maximum number of CPUs and of NUMA nodes known by the runtime. Bigger
+ * CPU and node numbers are ignored.
+ */
+#define PICC_MAX_CPUS 1024
+#define PICC_MAX_NODES 64
+
+/**
+ * The allowed CPUs, sorted by NUMA node then by number. The workers are
+ * placed in this order, so that consecutive workers share a node.
+ */
+struct _PICC_Topology {
+    /**@{*/
+    int nb_cpus; /**< Number of allowed CPUs */
+    int *cpus; /**< The allowed CPUs, by node */
+    int *nodes; /**< The node of each CPU of cpus */
+    int nb_nodes; /**< Number of nodes with an allowed CPU */
+    /**@}*/
+};
+
+extern bool PICC_parse_cpulist(const char *list, bool *cpus, int max_cpus);
+
+#endif
@@ -150,7 +150,6 @@ extern void PICC_print_value(PICC_Value * value);
 extern PICC_Value *PICC_create_value(PICC_ValueKind type, PICC_Error *error);
 extern PICC_AtomicBoolean *PICC_create_atomic_bool(PICC_Error *error);
 extern PICC_AtomicInt *PICC_create_atomic_int(PICC_Error *error);
-extern PICC_Clock *PICC_create_clock(PICC_Error *error);
 */
 
 #endif
@@ -92,7 +92,10 @@ extern void PICC_NoValue_inv(PICC_NoValue *val);
 
 struct _int_value_t {
     VALUE_HEADER ;
-    int data;
+    union {
+        int data;
+        void *word; // keeps data in the data word of PICC_Value, copied with it
+    };
 };
 
 #define PICC_INIT_INT_VALUE(val, i)					\
@@ -158,7 +161,7 @@ struct _string_value_t {
 
 struct _string_handle_t  //"implements PICC_KnownHandle"
 {
-    int global_rc;
+    atomic_int global_rc;
     PICC_Lock *lock;
     PICC_Reclaimer reclaim;
     char *data;
@@ -222,7 +225,10 @@ extern void PICC_ChannelValue_inv(PICC_ChannelValue *channel);
 
 struct _user_immediate_value_t {
     VALUE_HEADER ;
-    int data;
+    union {
+        int data;
+        void *word; // keeps data in the data word of PICC_Value, copied with it
+    };
 };
 
 /**********************************
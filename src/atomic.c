@@ -2,6 +2,10 @@
  * @file atomic.c
  * Atomic booleans and integers.
  *
+ * The operations map to the C11 atomics. Reads are acquire, writes release
+ * and read-modify-write operations acquire-release, so that an atomic value
+ * can publish the data written before it is set.
+ *
  * This project is released under MIT License.
  *
  * @author Mickaël MENU
@@ -11,12 +15,6 @@
 #include <atomic_repr.h>
 #include <tools.h>
 
-#define LOCK_ATOMIC_VALUE(val) \
-    pthread_mutex_lock(&(val->lock));
-
-#define RELEASE_ATOMIC_VALUE(val) \
-    pthread_mutex_unlock(&(val->lock));
-
 
 // Atomic booleans /////////////////////////////////////////////////////////////
 
@@ -30,8 +28,7 @@
 PICC_AtomicBoolean *PICC_create_atomic_bool(bool value, PICC_Error *error)
 {
     PICC_ALLOC(atomic_bool, PICC_AtomicBoolean, error) {
-        atomic_bool->val = value;
-        pthread_mutex_init(&(atomic_bool->lock), NULL);
+        atomic_init(&atomic_bool->val, value);
     }
     return atomic_bool;
 }
@@ -65,29 +62,15 @@ void PICC_free_atomic_bool(PICC_AtomicBoolean *atomic_bool)
  */
 bool PICC_atomic_bool_compare_and_swap(PICC_AtomicBoolean *atomic_bool, bool expected_val, bool new_val)
 {
-    LOCK_ATOMIC_VALUE(atomic_bool);
-
     #ifdef CONTRACT_PRE
         // pre: atomic_bool != null
         ASSERT(atomic_bool != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        bool val_at_pre = atomic_bool->val;
-    #endif
-
-    bool old_val = atomic_bool->val;
-    if (old_val == expected_val)
-        atomic_bool->val = new_val;
-
-    #ifdef CONTRACT_POST
-        // post: if (atomic_bool.val@pre == expected_val) then atomic_bool.val = new_val
-        if (val_at_pre == expected_val)
-            ASSERT(atomic_bool->val == new_val);
-    #endif
-
-    RELEASE_ATOMIC_VALUE(atomic_bool);
+    bool old_val = expected_val;
+    atomic_compare_exchange_strong_explicit(&atomic_bool->val, &old_val, new_val,
+                                            memory_order_acq_rel,
+                                            memory_order_acquire);
     return old_val;
 }
 
@@ -105,33 +88,14 @@ bool PICC_atomic_bool_compare_and_swap(PICC_AtomicBoolean *atomic_bool, bool exp
  */
 bool PICC_atomic_bool_compare_and_swap_check(PICC_AtomicBoolean *atomic_bool, bool expected_val, bool new_val)
 {
-    LOCK_ATOMIC_VALUE(atomic_bool);
-
     #ifdef CONTRACT_PRE
         // pre: atomic_bool != null
         ASSERT(atomic_bool != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        bool val_at_pre = atomic_bool->val;
-    #endif
-
-    bool old_val = atomic_bool->val;
-    bool success = false;
-    if (old_val == expected_val) {
-        atomic_bool->val = new_val;
-        success = true;
-    }
-
-    #ifdef CONTRACT_POST
-        // post: if (atomic_bool.val@pre == expected_val) then atomic_bool.val = new_val
-        if (val_at_pre == expected_val)
-            ASSERT(atomic_bool->val == new_val);
-    #endif
-
-    RELEASE_ATOMIC_VALUE(atomic_bool);
-    return success;
+    return atomic_compare_exchange_strong_explicit(&atomic_bool->val, &expected_val, new_val,
+                                                   memory_order_acq_rel,
+                                                   memory_order_acquire);
 }
 
 /**
@@ -148,7 +112,7 @@ bool PICC_atomic_bool_get(PICC_AtomicBoolean *atomic_bool)
         ASSERT(atomic_bool != NULL);
     #endif
 
-    return atomic_bool->val;
+    return atomic_load_explicit(&atomic_bool->val, memory_order_acquire);
 }
 
 /**
@@ -167,19 +131,7 @@ bool PICC_atomic_bool_get_and_set(PICC_AtomicBoolean *atomic_bool, bool new_val)
         ASSERT(atomic_bool != NULL);
     #endif
 
-    bool current;
-    for (;;) {
-        current = PICC_atomic_bool_get(atomic_bool);
-        if (PICC_atomic_bool_compare_and_swap_check(atomic_bool, current, new_val))
-            break;
-    }
-
-    #ifdef CONTRACT_POST
-        // post: atomic_bool.val == new_val
-        ASSERT(atomic_bool->val == new_val);
-    #endif
-
-    return current;
+    return atomic_exchange_explicit(&atomic_bool->val, new_val, memory_order_acq_rel);
 }
 
 
@@ -195,8 +147,7 @@ bool PICC_atomic_bool_get_and_set(PICC_AtomicBoolean *atomic_bool, bool new_val)
 PICC_AtomicInt *PICC_create_atomic_int(int value, PICC_Error *error)
 {
     PICC_ALLOC(atomic_int, PICC_AtomicInt, error) {
-        atomic_int->val = value;
-        pthread_mutex_init(&(atomic_int->lock), NULL);        
+        atomic_init(&atomic_int->val, value);
     }
     return atomic_int;
 }
@@ -230,29 +181,15 @@ void PICC_free_atomic_int(PICC_AtomicInt *atomic_int)
  */
 int PICC_atomic_int_compare_and_swap(PICC_AtomicInt *atomic_int, int expected_val, int new_val)
 {
-    LOCK_ATOMIC_VALUE(atomic_int);
-
     #ifdef CONTRACT_PRE
         // pre: atomic_int != null
         ASSERT(atomic_int != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int val_at_pre = atomic_int->val;
-    #endif
-
-    int old_val = atomic_int->val;
-    if (old_val == expected_val)
-        atomic_int->val = new_val;
-
-    #ifdef CONTRACT_POST
-        // post: if (atomic_int.val@pre == expected_val) then atomic_int.val = new_val
-        if (val_at_pre == expected_val)
-            ASSERT(atomic_int->val == new_val);
-    #endif
-
-    RELEASE_ATOMIC_VALUE(atomic_int);
+    int old_val = expected_val;
+    atomic_compare_exchange_strong_explicit(&atomic_int->val, &old_val, new_val,
+                                            memory_order_acq_rel,
+                                            memory_order_acquire);
     return old_val;
 }
 
@@ -270,32 +207,14 @@ int PICC_atomic_int_compare_and_swap(PICC_AtomicInt *atomic_int, int expected_va
  */
 bool PICC_atomic_int_compare_and_swap_check(PICC_AtomicInt *atomic_int, int expected_val, int new_val)
 {
-    LOCK_ATOMIC_VALUE(atomic_int);
-
     #ifdef CONTRACT_PRE
         // pre: atomic_int != null
         ASSERT(atomic_int != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int val_at_pre = atomic_int->val;
-    #endif
-
-    int old_val = atomic_int->val;
-    bool success = false;
-    if (old_val == expected_val) {
-        atomic_int->val = new_val;
-    	success = true;
-    }
-    #ifdef CONTRACT_POST
-        // post: if (atomic_int.val@pre == expected_val) then atomic_int.val = new_val
-        if (val_at_pre == expected_val)
-            ASSERT(atomic_int->val == new_val);
-    #endif
-
-    RELEASE_ATOMIC_VALUE(atomic_int);
-    return success;
+    return atomic_compare_exchange_strong_explicit(&atomic_int->val, &expected_val, new_val,
+                                                   memory_order_acq_rel,
+                                                   memory_order_acquire);
 }
 
 /**
@@ -312,7 +231,7 @@ int PICC_atomic_int_get(PICC_AtomicInt *atomic_int)
         ASSERT(atomic_int != NULL);
     #endif
 
-    return atomic_int->val;
+    return atomic_load_explicit(&atomic_int->val, memory_order_acquire);
 }
 
 /**
@@ -331,19 +250,7 @@ int PICC_atomic_int_get_and_set(PICC_AtomicInt *atomic_int, int new_val)
         ASSERT(atomic_int != NULL);
     #endif
 
-    int current;
-    for (;;) {
-        current = PICC_atomic_int_get(atomic_int);
-        if (PICC_atomic_int_compare_and_swap_check(atomic_int, current, new_val))
-            break;
-    }
-
-    #ifdef CONTRACT_POST
-        // post: atomic_int.val == new_val
-        ASSERT(atomic_int->val == new_val);
-    #endif
-
-    return current;
+    return atomic_exchange_explicit(&atomic_int->val, new_val, memory_order_acq_rel);
 }
 
 /**
@@ -361,24 +268,7 @@ int PICC_atomic_int_get_and_increment(PICC_AtomicInt *atomic_int)
         ASSERT(atomic_int != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int val_at_pre = atomic_int->val;
-    #endif
-
-    int current;
-    for (;;) {
-        current = PICC_atomic_int_get(atomic_int);
-        if (PICC_atomic_int_compare_and_swap_check(atomic_int, current, current + 1))
-            break;
-    }
-
-    #ifdef CONTRACT_POST
-        // post: atomic_int.val > atomic_int.val@pre
-        ASSERT(atomic_int->val > val_at_pre);
-    #endif
-
-    return current;
+    return atomic_fetch_add_explicit(&atomic_int->val, 1, memory_order_acq_rel);
 }
 
 /**
@@ -396,22 +286,5 @@ int PICC_atomic_int_get_and_decrement(PICC_AtomicInt *atomic_int)
         ASSERT(atomic_int != NULL);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int val_at_pre = atomic_int->val;
-    #endif
-
-    int current;
-    for (;;) {
-        current = PICC_atomic_int_get(atomic_int);
-        if (PICC_atomic_int_compare_and_swap_check(atomic_int, current, current - 1))
-            break;
-    }
-
-    #ifdef CONTRACT_POST
-        // post: atomic_int.val < atomic_int.val@pre
-        ASSERT(atomic_int->val < val_at_pre);
-    #endif
-
-    return current;
+    return atomic_fetch_sub_explicit(&atomic_int->val, 1, memory_order_acq_rel);
 }
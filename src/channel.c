@@ -44,15 +44,15 @@ PICC_Channel *PICC_create_channel()
 PICC_Channel *PICC_create_channel_cn()
 {
     ALLOC_ERROR(error);
-    PICC_ALLOC(channel, PICC_Channel, &error) {
-        channel->global_rc = 1;
+    PICC_SLAB_ALLOC(channel, PICC_Channel, &error) {
+        atomic_init(&channel->global_rc, 1);
         channel->lock = PICC_create_lock(&error);
 	channel->reclaim = (PICC_Reclaimer) PICC_reclaim_channel;
         channel->incommits = PICC_create_commit_list(&error);
         channel->outcommits = PICC_create_commit_list(&error);
         if (channel->incommits == NULL || channel->outcommits == NULL) {
             NEW_ERROR(&error, ERR_OUT_OF_MEMORY);
-            free(channel);
+            PICC_slab_free(channel, sizeof(PICC_Channel));
             channel = NULL;
         }
     }
@@ -78,7 +78,7 @@ void PICC_reclaim_channel(PICC_Channel *channel, PICC_Error *error)
     PICC_lock_free(channel->lock);
     free(channel->incommits);
     free(channel->outcommits);
-    free(channel);
+    PICC_slab_free(channel, sizeof(PICC_Channel));
 }
 
 /**
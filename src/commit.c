@@ -14,21 +14,15 @@
 #include <value_repr.h>
 #include <tools.h>
 
-#define LOCK_CLOCK(commit) \
-    PICC_acquire(&(commit->thread->clock->val->lock));
-
-#define RELEASE_CLOCK(commit) \
-    PICC_release(&(commit->thread->clock->val->lock));
-
 #define INIT_COMMIT(commit, pt, ch, pc) \
     commit->thread = pt; \
     commit->cont_pc = pc; \
-    commit->clock = pt->clock; \
-    commit->clockval = PICC_atomic_int_get(pt->clock->val); \
+    commit->clockval = PICC_pithread_clock(pt); \
     commit->channel = ch;
 
 /**
- * Creates and returns a commitment.
+ * Creates and returns a commitment. The commitment is a single slab
+ * object: its specific part and its commit list elements are embedded.
  *
  * @post commit != null
  *
@@ -36,11 +30,14 @@
  */
 PICC_Commit *PICC_create_commitment(PICC_Error *error)
 {
-    PICC_ALLOC(commit, PICC_Commit, error) {
+    PICC_SLAB_ALLOC(commit, PICC_Commit, error) {
         commit->thread = NULL;
-        commit->clock = NULL;
+        commit->clockval = 0;
         commit->channel = NULL;
-        commit->content.in = NULL; // will also set commit->content.out to NULL
+        for (int i = 0; i < PICC_COMMIT_NB_LINKS; i++) {
+            commit->links[i].commit = commit;
+            commit->links[i].next = NULL;
+        }
     }
 
     #ifdef CONTRACT_POST
@@ -65,9 +62,7 @@ PICC_Commit *PICC_create_commitment(PICC_Error *error)
 PICC_CommitList *PICC_create_commit_list(PICC_Error *error)
 {
     PICC_ALLOC(clist, PICC_CommitList, error) {
-        clist->head = NULL;
-        clist->tail = NULL;
-        clist->size = 0;
+        PICC_init_commit_list(clist, PICC_COMMIT_CHANNEL_LINK);
     }
 
      #ifdef CONTRACT_POST
@@ -82,49 +77,34 @@ PICC_CommitList *PICC_create_commit_list(PICC_Error *error)
 }
 
 /**
- * Creates a new  element of commit list.
- *
- * @pre commit != NULL
+ * Initializes an empty commit list, linking the commitments through the
+ * given link.
  *
- * @post clist_elem != NULL
- * @post clist_elem->commit = commit
- * @post clist_elem->next = NULL
+ * @pre clist != NULL
  *
- * @param commit Commit associated
- * @param error Error stack
- * @return Created commit list element
+ * @param clist Commit list to initialize
+ * @param link Link of the commitments used by the list
  */
-PICC_CommitListElement *PICC_create_commit_list_element(PICC_Commit *commit, PICC_Error *error)
+void PICC_init_commit_list(PICC_CommitList *clist, PICC_CommitLink link)
 {
-	#ifdef CONTRACT_PRE
-        // pre
-        ASSERT(commit != NULL);
-    #endif
-
-    PICC_ALLOC(clist_elem, PICC_CommitListElement, error) {
-        clist_elem->commit = commit;
-        clist_elem->next = NULL;
-    }
-
-    #ifdef CONTRACT_POST
-        //post
-        ASSERT(clist_elem != NULL);
-        ASSERT(clist_elem->commit == commit);
-        ASSERT(clist_elem->next == NULL);
+    #ifdef CONTRACT_PRE
+        ASSERT(clist != NULL);
     #endif
 
-    return clist_elem;
+    clist->head = NULL;
+    clist->tail = NULL;
+    clist->size = 0;
+    clist->link = link;
 }
 
-void PICC_reclaim_commitment(PICC_Commit *commit) 
+/**
+ * Reclaims the given commitment. It must not be in a commit list anymore.
+ *
+ * @param commit Commitment to reclaim
+ */
+void PICC_reclaim_commitment(PICC_Commit *commit)
 {
-    if (commit->type == PICC_OUT_COMMIT && commit->content.out != NULL) {
-        free(commit->content.out);
-    }
-    if (commit->type == PICC_IN_COMMIT && commit->content.in != NULL) {
-        free(commit->content.in);
-    }
-    free(commit);
+    PICC_SLAB_FREE(commit, PICC_Commit);
 }
 
 void PICC_reclaim_commit_list(PICC_CommitList *clist, PICC_Error *error) 
@@ -187,8 +167,7 @@ void PICC_register_output_commitment(PICC_PiThread *pt, PICC_Channel *ch, PICC_E
     else
     {
         INIT_COMMIT(commit, pt, ch, cont_pc);
-        PICC_MALLOC(commit->content.out, PICC_OutCommit, &sub_error);
-        commit->content.out->eval_func = eval;
+        commit->content.out.eval_func = eval;
         commit->type = PICC_OUT_COMMIT;
 
         ALLOC_ERROR(add_error);
@@ -197,7 +176,7 @@ void PICC_register_output_commitment(PICC_PiThread *pt, PICC_Channel *ch, PICC_E
         PICC_commit_list_add(pt->commits, commit, &add_error);
         if (HAS_ERROR(add_error)) {
             ADD_ERROR(&sub_error, add_error, ERR_REGISTER_IN_COMMIT);
-            free(commit);
+            PICC_reclaim_commitment(commit);
         }
     }
     if (HAS_ERROR(sub_error))
@@ -215,7 +194,7 @@ void PICC_register_output_commitment(PICC_PiThread *pt, PICC_Channel *ch, PICC_E
         //post
         ASSERT(ch->outcommits->size == (size_at_pre + 1));
         ASSERT(ch->outcommits->tail->commit->type == PICC_OUT_COMMIT);
-        ASSERT(ch->outcommits->tail->commit->content.out->eval_func == eval);
+        ASSERT(ch->outcommits->tail->commit->content.out.eval_func == eval);
         ASSERT(ch->outcommits->tail->commit->thread == pt);
         ASSERT(ch->outcommits->tail->commit->channel == ch);
         ASSERT(ch->outcommits->tail->commit->cont_pc == cont_pc);
@@ -269,8 +248,7 @@ void PICC_register_input_commitment(PICC_PiThread *pt, PICC_Channel *ch, int ref
         ADD_ERROR(&sub_error, sub_error, ERR_REGISTER_IN_COMMIT);
     } else {
         INIT_COMMIT(commit, pt, ch, cont_pc);
-        PICC_MALLOC(commit->content.in, PICC_InCommit, &sub_error);
-        commit->content.in->refvar = refvar;
+        commit->content.in.refvar = refvar;
         commit->type = PICC_IN_COMMIT;
 
         ALLOC_ERROR(add_error);
@@ -279,7 +257,7 @@ void PICC_register_input_commitment(PICC_PiThread *pt, PICC_Channel *ch, int ref
         PICC_commit_list_add(pt->commits, commit, &add_error);
         if (HAS_ERROR(add_error)) {
             ADD_ERROR(&sub_error, add_error, ERR_REGISTER_IN_COMMIT);
-            free(commit);
+            PICC_reclaim_commitment(commit);
         }
     }
 
@@ -298,7 +276,7 @@ void PICC_register_input_commitment(PICC_PiThread *pt, PICC_Channel *ch, int ref
         //post
 		ASSERT(ch->incommits->size == (size_at_pre + 1));
 		ASSERT(ch->incommits->tail->commit->type == PICC_IN_COMMIT);
-		ASSERT(ch->incommits->tail->commit->content.in->refvar == refvar);
+		ASSERT(ch->incommits->tail->commit->content.in.refvar == refvar);
 		ASSERT(ch->incommits->tail->commit->thread == pt);
 		ASSERT(ch->incommits->tail->commit->channel == ch);
 		ASSERT(ch->incommits->tail->commit->cont_pc == cont_pc);
@@ -311,7 +289,7 @@ void PICC_register_input_commitment(PICC_PiThread *pt, PICC_Channel *ch, int ref
  *
  * @pre commit != null
  *
- * @post  if (commit->clock == commit->thread->clock && commit->clockval == commit->thread->clock->val) valid = true else valid = false
+ * @post  if (commit->clockval == commit->thread->clock) valid = true else valid = false
  *
  * @param commit Commit to validate
  * @return Whether the commit is valid
@@ -329,11 +307,8 @@ bool PICC_is_valid_commit(PICC_Commit *commit)
     #endif
 
     bool valid = false;
-    //LOCK_CLOCK(commit);
-    if (commit->clock == commit->thread->clock
-            && commit->clockval == PICC_atomic_int_get(commit->thread->clock->val))
+    if (commit->clockval == PICC_pithread_clock(commit->thread))
         valid = true;
-    //RELEASE_CLOCK(commit);
 
 
     #ifdef CONTRACT_POST_INV
@@ -343,8 +318,7 @@ bool PICC_is_valid_commit(PICC_Commit *commit)
 
     #ifdef CONTRACT_POST
         // post
-        if ((commit->clock == commit->thread->clock) && 
-            (commit->clockval == PICC_atomic_int_get(commit->thread->clock->val))) {
+        if (commit->clockval == PICC_pithread_clock(commit->thread)) {
             ASSERT(valid == true);
         } else {
 			ASSERT(valid == false);
@@ -357,7 +331,9 @@ bool PICC_is_valid_commit(PICC_Commit *commit)
 
 
 /**
- * Adds the given element at the end of the commit list.
+ * Adds the given element at the end of the commit list, through the
+ * commit list element embedded in the commitment for the list link. A
+ * commitment is in at most one list per link.
  *
  * @pre clist != NULL
  * @pre commit != NULL
@@ -392,21 +368,17 @@ void PICC_commit_list_add(PICC_CommitList *clist, PICC_Commit *commit, PICC_Erro
 			both_null = 1;
     #endif
 
-    ALLOC_ERROR(create_error);
-    PICC_CommitListElement *clist_elem = PICC_create_commit_list_element(commit, &create_error);
-    if (HAS_ERROR(create_error)) {
-        ADD_ERROR(error, create_error, ERR_ADD_COMMIT_TO_LIST);
-    } else {
-        if(clist->head != NULL && clist->tail != NULL){
-			clist->tail->next = clist_elem;
-            clist->tail = clist_elem;            
-            clist->size++;
-        }
-        else{
-            clist->head = clist_elem;
-            clist->tail = clist_elem;
-            clist->size++;
-        }
+    PICC_CommitListElement *clist_elem = &commit->links[clist->link];
+    clist_elem->next = NULL;
+    if(clist->head != NULL && clist->tail != NULL){
+        clist->tail->next = clist_elem;
+        clist->tail = clist_elem;
+        clist->size++;
+    }
+    else{
+        clist->head = clist_elem;
+        clist->tail = clist_elem;
+        clist->size++;
     }
 
     #ifdef CONTRACT_POST_INV
@@ -429,8 +401,9 @@ void PICC_commit_list_add(PICC_CommitList *clist, PICC_Commit *commit, PICC_Erro
 }
 
 /**
- * Removes the given element from the commit list.
- *
+ * Removes the given element from the commit list. The next pointer of the
+ * removed element is kept, so that a traversal of the list may go on
+ * after removing the current element.
  *
  * @param clist Commit list
  * @param commit Commit to remove
@@ -452,8 +425,6 @@ void PICC_commit_list_remove(PICC_CommitList* clist, PICC_Commit *c){
                     clist->tail = prev;
                 }
 			}
-			free(commitEl);
-
             --(clist->size);
 			break;
 		}
@@ -556,8 +527,6 @@ PICC_Commit *PICC_commit_list_fetch(PICC_CommitList *clist)
         }
         clist->size--;
         commit_list_element->next = NULL;
-        commit_list_element->commit = NULL;
-        free(commit_list_element);
         PICC_release(fetched->thread->lock);
         //if(fetched == NULL) printf("FETCHED NULL\n");
         //if(head_at_pre == NULL) printf("HEAD AT PRE commit NULL\n");
@@ -675,7 +644,7 @@ PICC_EvalFunction PICC_eval_func_of_output_commitment(PICC_Commit *c){
     ASSERT(c != NULL && c->type == PICC_OUT_COMMIT);
 #endif
 
-    return c->content.out->eval_func;
+    return c->content.out.eval_func;
 
 }
 
@@ -686,20 +655,17 @@ PICC_EvalFunction PICC_eval_func_of_output_commitment(PICC_Commit *c){
 /**
  * @brief Checks commit invariant.
  *
- * @inv thread != null && clock != null && clockval  != null && channel  != null && content  != null
+ * @inv thread != null && clockval <= thread.clock && channel != null
+ * @inv type = PICC_OUT_COMMIT implies content.out.eval_func != null
  * @inv cont_pc > 0
  */
 void PICC_Commit_inv(PICC_Commit *commit)
 {
     ASSERT(commit->thread != NULL);
-    ASSERT(commit->clock != NULL);
-    ASSERT(commit->clockval >= 0);
+    ASSERT(commit->clockval <= PICC_pithread_clock(commit->thread));
     ASSERT(commit->channel != NULL);
-
-    if (commit->type == PICC_IN_COMMIT) {
-        ASSERT(commit->content.in != NULL);
-    } else {
-        ASSERT(commit->content.out != NULL);
+    if (commit->type == PICC_OUT_COMMIT) {
+        ASSERT(commit->content.out.eval_func != NULL);
     }
     ASSERT(commit->cont_pc > 0);
 }
@@ -8,10 +8,39 @@
  * @author Maxence WO
  */
 
+#define _GNU_SOURCE
+
 #include <concurrent.h>
 #include <pthread.h>
+#include <limits.h>
 #include <tools.h>
 #include <stdio.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/**
+ * Whether the locks and eventcounts synchronise, see PICC_set_locking.
+ */
+static bool locking = true;
+
+/**
+ * Disables the synchronisation, or enables it back: the locks become plain
+ * flags, the notifications of the conditions and eventcounts no-ops. A
+ * runtime running all its PiThreads on a single thread (see
+ * PICC_RuntimeConfig) disables it while it lives: no other thread may use
+ * a lock or wait meanwhile, and no lock may be held when it is switched.
+ *
+ * @param enabled false to disable the synchronisation
+ */
+void PICC_set_locking(bool enabled)
+{
+    locking = enabled;
+}
+
 /**
  * Creates a new lock.
  *
@@ -26,7 +55,7 @@ PICC_Lock *PICC_create_lock(PICC_Error *error)
 }
 
 void PICC_lock_free(PICC_Lock *l){
-    pthread_mutex_destroy(l);
+    pthread_mutex_destroy(&l->mutex);
     free(l);
 }
 
@@ -42,7 +71,8 @@ void PICC_init_lock(PICC_Lock *lock)
         ASSERT(lock != NULL);
     #endif
 
-    pthread_mutex_init(lock, NULL);
+    pthread_mutex_init(&lock->mutex, NULL);
+    lock->held = false;
 }
 
 /**
@@ -71,7 +101,11 @@ void PICC_acquire(PICC_Lock *lock)
     #ifdef CONTRACT_PRE
         ASSERT(lock != NULL);
     #endif
-    pthread_mutex_lock(lock);
+
+    if (locking)
+        pthread_mutex_lock(&lock->mutex);
+    else
+        lock->held = true;
 }
 
 /**
@@ -87,7 +121,12 @@ bool PICC_try_acquire(PICC_Lock *lock)
         ASSERT(lock != NULL);
     #endif
 
-    return pthread_mutex_trylock(lock) == 0;
+    if (locking)
+        return pthread_mutex_trylock(&lock->mutex) == 0;
+    if (lock->held)
+        return false;
+    lock->held = true;
+    return true;
 }
 
 /**
@@ -102,10 +141,15 @@ void PICC_release(PICC_Lock *lock)
         ASSERT(lock != NULL);
     #endif
 
-    if (pthread_mutex_trylock(lock) == 0) {
+    if (!locking) {
+        if (!lock->held) {
+            CRASH_NEW_ERROR(ERR_MUTEX_ALREADY_UNLOCKED);
+        }
+        lock->held = false;
+    } else if (pthread_mutex_trylock(&lock->mutex) == 0) {
         CRASH_NEW_ERROR(ERR_MUTEX_ALREADY_UNLOCKED);
     } else {
-        pthread_mutex_unlock(lock);
+        pthread_mutex_unlock(&lock->mutex);
     }
 }
 
@@ -124,7 +168,7 @@ void PICC_cond_wait(PICC_Condition *cond, PICC_Lock *lock)
         ASSERT(lock != NULL);
     #endif
 
-    pthread_cond_wait(cond, lock);
+    pthread_cond_wait(cond, &lock->mutex);
 }
 
 /**
@@ -140,6 +184,8 @@ void PICC_cond_signal(PICC_Condition *cond, PICC_Error *error)
         ASSERT(cond != NULL);
     #endif
 
+    if (!locking)
+        return;
     int status = pthread_cond_signal(cond);
     if (status) {
         NEW_ERROR(error, ERR_CONDITION_SIGNAL);
@@ -159,8 +205,163 @@ void PICC_cond_broadcast(PICC_Condition *cond, PICC_Error *error)
         ASSERT(cond != NULL);
     #endif
 
+    if (!locking)
+        return;
     int status = pthread_cond_broadcast(cond);
     if (status) {
         NEW_ERROR(error, ERR_CONDITION_BROADCAST);
     }
 }
+
+// EVENTCOUNTS /////////////////////////////////////////////////////////////////
+
+#ifdef __linux__
+static void futex_wait(atomic_uint *word, unsigned val)
+{
+    syscall(SYS_futex, (unsigned *) word, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint *word, int nb)
+{
+    syscall(SYS_futex, (unsigned *) word, FUTEX_WAKE_PRIVATE, nb, NULL, NULL, 0);
+}
+#endif
+
+/**
+ * Initializes the given eventcount.
+ *
+ * @pre ec != null
+ * @param ec Eventcount to initialize
+ */
+void PICC_init_eventcount(PICC_EventCount *ec)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+    atomic_init(&ec->epoch, 0);
+    atomic_init(&ec->waiters, 0);
+#ifndef __linux__
+    pthread_mutex_init(&ec->lock, NULL);
+    PICC_init_condition(&ec->cond);
+#endif
+}
+
+/**
+ * Announces that the current thread is about to wait on the eventcount.
+ * The caller must check its condition again before waiting with the
+ * returned key, and cancel if the condition holds.
+ *
+ * @pre ec != null
+ * @param ec Eventcount
+ * @return The key to wait with
+ */
+unsigned PICC_eventcount_prepare(PICC_EventCount *ec)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+    atomic_fetch_add(&ec->waiters, 1);
+    // the condition is checked again after the waiters are published
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load(&ec->epoch);
+}
+
+/**
+ * Withdraws a prepared wait.
+ *
+ * @pre ec != null
+ * @param ec Eventcount
+ */
+void PICC_eventcount_cancel(PICC_EventCount *ec)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+    atomic_fetch_sub(&ec->waiters, 1);
+}
+
+/**
+ * Waits until an event is notified after the given key was taken. Returns
+ * at once if one already was. Wake-ups may be spurious.
+ *
+ * @pre ec != null
+ * @param ec Eventcount
+ * @param key Key returned by PICC_eventcount_prepare
+ */
+void PICC_eventcount_wait(PICC_EventCount *ec, unsigned key)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+#ifdef __linux__
+    if (atomic_load(&ec->epoch) == key)
+        futex_wait(&ec->epoch, key);
+#else
+    pthread_mutex_lock(&ec->lock);
+    while (atomic_load(&ec->epoch) == key)
+        pthread_cond_wait(&ec->cond, &ec->lock);
+    pthread_mutex_unlock(&ec->lock);
+#endif
+    atomic_fetch_sub(&ec->waiters, 1);
+}
+
+/**
+ * Notifies an event, waking up at most nb waiting threads.
+ */
+static void eventcount_notify(PICC_EventCount *ec, int nb)
+{
+    if (!locking)
+        return;
+
+    // the event is published before the waiters are read
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed) == 0)
+        return;
+
+#ifdef __linux__
+    atomic_fetch_add(&ec->epoch, 1);
+    futex_wake(&ec->epoch, nb);
+#else
+    pthread_mutex_lock(&ec->lock);
+    atomic_fetch_add(&ec->epoch, 1);
+    if (nb == 1)
+        pthread_cond_signal(&ec->cond);
+    else
+        pthread_cond_broadcast(&ec->cond);
+    pthread_mutex_unlock(&ec->lock);
+#endif
+}
+
+/**
+ * Notifies an event to one of the waiting threads, if any.
+ *
+ * @pre ec != null
+ * @param ec Eventcount
+ */
+void PICC_eventcount_notify(PICC_EventCount *ec)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+    eventcount_notify(ec, 1);
+}
+
+/**
+ * Notifies an event to all the waiting threads.
+ *
+ * @pre ec != null
+ * @param ec Eventcount
+ */
+void PICC_eventcount_notify_all(PICC_EventCount *ec)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(ec != NULL);
+    #endif
+
+    eventcount_notify(ec, INT_MAX);
+}
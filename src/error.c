@@ -13,6 +13,8 @@
 #include <error.h>
 
 static const char *PICC_error_messages[PICC_NB_ERRORS] = {
+    "Dead code reached.",
+
     "Scheduler deadlock.",
 
     "Can't alloc a new queue cell.",
@@ -49,7 +51,14 @@ static const char *PICC_error_messages[PICC_NB_ERRORS] = {
     "Invalid value.",
     "Invalid type.",
 
-    "The known set element is in an invalid state"
+    "The known set element is in an invalid state",
+
+    "Invalid cpulist, or no allowed CPU in it.",
+    "Can't set the CPU affinity of the POSIX thread.",
+
+    "Can't create the runtime.",
+    "A worker of the runtime failed.",
+    "A serial runtime can't run alongside another runtime."
 };
 
 /**
@@ -64,12 +73,12 @@ void PICC_init_error(PICC_Error *error, PICC_ErrorId id, const char *file, int l
 {
     if (error != NULL) {
         error->id = id;
-        error->file = malloc(strlen(file) * sizeof(char));
+        error->file = malloc((strlen(file) + 1) * sizeof(char));
         if (error->file == NULL) {
             perror("Unable to create a new PICC_Error");
             exit(EXIT_FAILURE);
         }
-        strncpy(error->file, file, strlen(file));
+        strcpy(error->file, file);
         error->line = line;
         error->prev = NULL;
     }
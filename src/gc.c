@@ -8,16 +8,21 @@
  */
 
 
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <string.h>
 #include <gc_repr.h>
-#include <knownset.h>
 #include <queue_repr.h>
-#include <channel.h>
+#include <channel_repr.h>
 #include <pi_thread_repr.h>
 #include <commit_repr.h>
 #include <stdio.h>
 #include <tools.h>
 /**
- * Increments the global reference count of a managed value
+ * Increments the global reference count of a managed value. The caller
+ * holds a reference, so the value can't be reclaimed meanwhile and the
+ * increment needs no ordering.
  *
  * @pre h != NULL
  *
@@ -27,289 +32,762 @@
  */
 void PICC_handle_incr_ref_count(PICC_Handle *h)
 {
-    /* #ifdef CONTRACT_PRE_INV */
-    /*     //inv */
-    /*     PICC_Channel_inv(channel); */
-    /* #endif */
-
     #ifdef CONTRACT_PRE
         //pre
         ASSERT(h != NULL );
     #endif
 
-    #ifdef CONTRACT_POST
-        // capture
-        // int global_rc_at_pre = h->global_rc;
-    #endif
-
-    LOCK_HANDLE(h);
-    h->global_rc++;
-    RELEASE_HANDLE(h);
-
-    /* #ifdef CONTRACT_POST_INV */
-    /*     //inv */
-    /*     PICC_Channel_inv(channel); */
-    /* #endif */
-
-    /* #ifdef CONTRACT_POST */
-    /*     //post */
-    /*     ASSERT(channel->global_rc == global_rc_at_pre + 1 );  */
-    /*     // cannot be asserted ! as the lock is released we don't have any garanty */
-    /* #endif */
+    atomic_fetch_add_explicit(&h->global_rc, 1, memory_order_relaxed);
 }
 
 /**
- * Decrements the global reference count of a managed value
+ * Decrements the global reference count of a managed value, and reclaims
+ * it with the last reference. Each decrement releases the accesses its
+ * thread made to the value, the last one acquires them all before the
+ * value is reclaimed. Nobody can take a new reference meanwhile, since
+ * it would need one already.
  *
- * @pre h != NULL
+ * @pre h != NULL && *h != NULL
  *
  * @post h->global_rc = h->global_rc@pre - 1
+ * @post *h == NULL if the value was reclaimed
  *
  * @param Handle to update
  */
 void PICC_handle_dec_ref_count(PICC_Handle **h)
 {
-    /* #ifdef CONTRACT_PRE_INV */
-    /*     //inv */
-    /*     PICC_Channel_inv(*channel); */
-    /* #endif */
-
     #ifdef CONTRACT_PRE
         //pre
         ASSERT(*h != NULL );
     #endif
 
+    int global_rc_at_pre = atomic_fetch_sub_explicit(&(*h)->global_rc, 1, memory_order_release);
+
     #ifdef CONTRACT_POST
-        // capture
-        // int global_rc_at_pre = (*h)->global_rc;
+        ASSERT(global_rc_at_pre > 0);
     #endif
 
-	// I think there is a problem here: what happens if global_rc is equal to one
-	// and another thread was about to increment it but lost the race to acquire the lock ?
-	//
-	// moreover, for now the lock is alocated in the channel/handle with the previous
-	// case in mind we cannot free it in the reclaim
-	// I think a solution would be to have a pool of Lock witch contain the lock itself
-	// and the value it's suposed to lock
-	//
-	// kind of:
-	// struct{
-	//   atomic_int cpt;
-	//   void *content;
-        // }
-	//
-	// in the function lock_alloc we would keep track of all the locks and we could
-	// reuse the ones that have cpt == 0 && content == NULL
-	//
-
-    LOCK_HANDLE(*h);
-    (*h)->global_rc--;
-
-    if ((*h)->global_rc == 0) {
-	RELEASE_HANDLE(*h);
-
-	ALLOC_ERROR(reclaim_error);
+    if (global_rc_at_pre == 1) {
+        atomic_thread_fence(memory_order_acquire);
+
+        ALLOC_ERROR(reclaim_error);
         (*h)->reclaim(*h, &reclaim_error);
-	*h = NULL;
+        *h = NULL;
         if (HAS_ERROR(reclaim_error))
             CRASH(&reclaim_error);
     }
-    else{
-	RELEASE_HANDLE(*h);
+}
+
+/**
+ * The reference count updates buffered by the current worker.
+ */
+static __thread PICC_RCBuffer rc_buffer;
+
+/**
+ * Returns the entry of the given handle in the buffer of the current
+ * worker, a free one for it if add is true.
+ *
+ * @return The entry, NULL if the handle is not buffered and add is false
+ */
+static PICC_RCEntry *rc_entry(PICC_Handle *h, bool add)
+{
+    int mask = 2 * PICC_RC_BUFFER_SIZE - 1;
+    uint64_t hash = ((uintptr_t) h >> 4) * 0x9E3779B97F4A7C15ULL;
+    int i;
+
+    for (i = (int) (hash >> 32) & mask; rc_buffer.entries[i].handle != NULL; i = (i + 1) & mask) {
+        if (rc_buffer.entries[i].handle == h)
+            return &rc_buffer.entries[i];
     }
+    if (!add)
+        return NULL;
+    rc_buffer.entries[i].handle = h;
+    rc_buffer.entries[i].delta = 0;
+    rc_buffer.size++;
+    return &rc_buffer.entries[i];
+}
 
-    /* #ifdef CONTRACT_POST_INV */
-    /*     if (*h != NULL) */
-    /*         PICC_Channel_inv(*channel); */
-    /* #endif */
+/**
+ * Increments the global reference count of a managed value through the
+ * buffer of the current worker: the increment cancels a decrement of the
+ * handle buffered by the worker, or is applied at once.
+ *
+ * @pre h != NULL
+ *
+ * @param Handle to update
+ */
+void PICC_handle_defer_incr_ref_count(PICC_Handle *h)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(h != NULL);
+    #endif
 
-    /* #ifdef CONTRACT_POST */
-    /*     if(global_rc_at_pre > 1) */
-    /*         ASSERT((*channel)->global_rc == global_rc_at_pre - 1 ); */
-    //cannot be asserted see incr for the same comment
-    /* #endif */
+    PICC_RCEntry *entry = rc_entry(h, false);
+    if (entry != NULL && entry->delta < 0)
+        entry->delta++;
+    else
+        atomic_fetch_add_explicit(&h->global_rc, 1, memory_order_relaxed);
 }
 
-bool PICC_GC2(PICC_SchedPool* sched)
+/**
+ * Decrements the global reference count of a managed value through the
+ * buffer of the current worker. The decrements of a handle are coalesced
+ * with its increments until PICC_handle_flush_ref_counts applies them,
+ * which the workers do every PICC_SCHED_ADAPT_PERIOD PiThreads, before
+ * they park and when they stop, and this function once PICC_RC_BUFFER_SIZE
+ * handles are buffered. The value is reclaimed by the flush dropping its
+ * last reference.
+ *
+ * @pre h != NULL
+ *
+ * @param Handle to update
+ */
+void PICC_handle_defer_dec_ref_count(PICC_Handle *h)
 {
-    int clique_max_size = PICC_init_clique_max_size;
-    PICC_ALLOC_N_CRASH(clique, PICC_PiThread*, clique_max_size) {
-        int clique_size = 0;
-        PICC_PiThread* candidate = PICC_wait_queue_pop_old(sched->wait);
-        if (candidate == NULL) {
-            free(clique);
-            return false;
-        }
+    #ifdef CONTRACT_PRE
+        ASSERT(h != NULL);
+    #endif
 
-        if(!(PICC_try_acquire(candidate->lock)))
-        {
-            //printf("1. GC pushed in wait queue: %p\n", candidate);
-            PICC_wait_queue_push(sched->wait, candidate);
-            free(clique);
-            return false;
-        }
+    rc_entry(h, true)->delta--;
+    if (rc_buffer.size >= PICC_RC_BUFFER_SIZE)
+        PICC_handle_flush_ref_counts();
+}
+
+/**
+ * Applies the reference count updates buffered by the current worker, one
+ * atomic update per handle, then reclaims at once the values whose last
+ * reference was dropped, after a single acquire fence (see
+ * PICC_handle_dec_ref_count).
+ */
+void PICC_handle_flush_ref_counts()
+{
+    PICC_Handle *dead[PICC_RC_BUFFER_SIZE];
+    int nb_dead = 0;
+    int i;
+
+    if (rc_buffer.size == 0)
+        return;
+    for (i = 0; i < 2 * PICC_RC_BUFFER_SIZE; i++) {
+        PICC_RCEntry *entry = &rc_buffer.entries[i];
+        if (entry->handle == NULL)
+            continue;
+        if (entry->delta != 0
+            && atomic_fetch_add_explicit(&entry->handle->global_rc, entry->delta,
+                                         memory_order_release) + entry->delta == 0)
+            dead[nb_dead++] = entry->handle;
+        entry->handle = NULL;
+    }
+    rc_buffer.size = 0;
+
+    if (nb_dead == 0)
+        return;
+    atomic_thread_fence(memory_order_acquire);
+    for (i = 0; i < nb_dead; i++) {
+        ALLOC_ERROR(reclaim_error);
+        dead[i]->reclaim(dead[i], &reclaim_error);
+        if (HAS_ERROR(reclaim_error))
+            CRASH(&reclaim_error);
+    }
+}
+
+/**
+ * Initialises an empty set of the given capacity, a power of two.
+ */
+static void gc_set_init(PICC_GCSet *set, int capacity)
+{
+    set->entries = calloc(capacity, sizeof(PICC_GCSetEntry));
+    if (set->entries == NULL) {
+        CRASH_NEW_ERROR(ERR_OUT_OF_MEMORY);
+    }
+    set->capacity = capacity;
+    set->size = 0;
+    set->epoch = 1;
+}
 
-        int candidates_max_size = PICC_init_candidates_max_size;
-        PICC_ALLOC_N_CRASH(candidates, PICC_PiThread*, candidates_max_size) {
-            PICC_KnownSet* chans = PICC_create_empty_knownset();
-            candidates[0] = candidate;
-            int candidates_size = candidate != NULL;
-
-            while(candidates_size > 0)
-            {
-                // arbitrary choice of a piThread, here the first piThread of candidates
-                candidate = candidates[0];
-                --candidates_size;
-                for (int i = 0; i < candidates_size; ++i) {
-                    candidates[i] = candidates[i + 1];
-                }
-
-                PICC_Commit* commit = NULL;
-                PICC_CommitListElement* commitEl = candidate->commits->head;
-                //printf("Commits size %d\n", candidate->commits->size);
-                while(commitEl){
-                    commit = commitEl->commit;
-                    if(PICC_is_valid_commit(commit)){
-                        PICC_Channel* chan = commit->channel;
-                        int refs = 1;
-
-                        if (!(PICC_try_acquire(chan->lock))) {
-                            goto abandon_gc;
-                        }
-                        PICC_knownset_add(chans, (PICC_KnownValue*)PICC_create_channel_value(chan));
-                        PICC_CommitListElement* incommitEl = chan->incommits->head;
-                        PICC_Commit *incommit = NULL;
-                        while(incommitEl) {
-                            incommit = incommitEl->commit;
-                            if(PICC_is_valid_commit(incommit)){
-                                if (incommit->thread != candidate) {
-                                    if(incommit->thread->status != PICC_STATUS_WAIT){
-                                        goto abandon_gc;
-                                    }
-
-                                    if(!(PICC_try_acquire(incommit->thread->lock))){
-                                        goto abandon_gc;
-                                    }
-                                    PICC_wait_queue_fetch(sched->wait, incommit->thread);
-
-                                    int can_add = 1;
-                                    for(int i = 0; i < candidates_size; i++){
-                                        if(candidates[i] == incommit->thread){
-                                            can_add = 0;
-                                            break;
-                                        }
-                                    }
-                                    if(can_add){
-                                        refs++;
-                                        if (candidates_size >= candidates_max_size) {
-                                            candidates_max_size *= 2;
-                                            PICC_REALLOC_N_CRASH(candidates, PICC_PiThread*, candidates_max_size) { }
-                                        }
-                                        candidates[candidates_size] = incommit->thread;
-                                        candidates_size++;
-                                    }
-                                }
-                            } else {
-                                PICC_commit_list_remove(chan->incommits, incommit);
-                            }
-                            incommitEl = incommitEl->next;
-                        }
-
-                        PICC_CommitListElement* outcommitEl = chan->outcommits->head;
-                        PICC_Commit *outcommit = NULL;
-                        while(outcommitEl){
-                            outcommit = outcommitEl->commit;
-                            if(PICC_is_valid_commit(outcommit)){
-                                if (outcommit->thread != candidate) {
-                                    if(outcommit->thread->status != PICC_STATUS_WAIT){
-                                        goto abandon_gc;
-                                    }
-
-                                    if(!(PICC_try_acquire(outcommit->thread->lock))){
-                                        goto abandon_gc;
-                                    }
-                                    PICC_wait_queue_fetch(sched->wait, outcommit->thread);
-
-                                    int can_add = 1;
-                                    for(int i = 0; i < candidates_size; i++){
-                                        if(candidates[i] == outcommit->thread){
-                                            can_add = 0;
-                                            break;
-                                        }
-                                    }
-                                    if(can_add){
-                                        refs++;
-                                        if (candidates_size >= candidates_max_size) {
-                                            candidates_max_size *= 2;
-                                            PICC_REALLOC_N_CRASH(candidates, PICC_PiThread*, candidates_max_size) { }
-                                        }
-                                        candidates[candidates_size] = outcommit->thread;
-                                        candidates_size++;
-                                    }
-                                }
-                            } else {
-                                PICC_commit_list_remove(chan->outcommits, outcommit);
-                            }
-                            outcommitEl = outcommitEl->next;
-                        }
-
-                        if(refs < chan->global_rc){
-                            goto abandon_gc;
-                        }
-                    }
-                    commitEl = commitEl->next;
-                }
-
-                int can_add = 1;
-                for(int i = 0; i < clique_size; i++){
-                    if(clique[i] == candidate){
-                        can_add = 0;
-                        break;
-                    }
-                }
-                if(can_add){
-                    if (clique_size >= clique_max_size) {
-                        clique_max_size *= 2;
-                        PICC_REALLOC_N_CRASH(clique, PICC_PiThread*, clique_max_size) { }
-                    }
-                    clique[clique_size] = candidate;
-                    clique_size++;
-                }
-            }
-
-            for(int i = 0; i < clique_size; i++){
-                //printf("inserted in clique: %p\n", clique[i]);
-                PICC_reclaim_pi_thread(clique[i]);
-            }
-
-            free(clique);
-            free(candidates);
-            //printf("<GC clique found and freed>\n");
+/**
+ * Empties the set, in constant time but once every 2^32 times.
+ */
+static void gc_set_clear(PICC_GCSet *set)
+{
+    set->size = 0;
+    if (++set->epoch == 0) {
+        memset(set->entries, 0, set->capacity * sizeof(PICC_GCSetEntry));
+        set->epoch = 1;
+    }
+}
+
+/**
+ * Returns the first slot of the given address in the set.
+ */
+static inline int gc_set_slot(const PICC_GCSet *set, const void *key)
+{
+    uint64_t hash = ((uintptr_t) key >> 4) * 0x9E3779B97F4A7C15ULL;
+    return (int) (hash >> 32) & (set->capacity - 1);
+}
+
+/**
+ * Returns whether the given address is in the set.
+ */
+static bool gc_set_contains(const PICC_GCSet *set, const void *key)
+{
+    int mask = set->capacity - 1;
+    int i;
+    for (i = gc_set_slot(set, key); set->entries[i].epoch == set->epoch; i = (i + 1) & mask) {
+        if (set->entries[i].key == key)
             return true;
+    }
+    return false;
+}
+
+/**
+ * Adds the given address to the set, whose capacity doubles once it is
+ * half full.
+ *
+ * @return Whether the address was not in the set yet
+ */
+static bool gc_set_add(PICC_GCSet *set, const void *key)
+{
+    int i, mask;
+
+    if (2 * (set->size + 1) > set->capacity) {
+        PICC_GCSetEntry *old = set->entries;
+        int old_capacity = set->capacity;
+        unsigned epoch = set->epoch;
+        int size = set->size;
+
+        gc_set_init(set, 2 * old_capacity);
+        set->epoch = epoch;
+        set->size = size;
+        mask = set->capacity - 1;
+        for (i = 0; i < old_capacity; i++) {
+            if (old[i].epoch != epoch)
+                continue;
+            int j = gc_set_slot(set, old[i].key);
+            while (set->entries[j].epoch == epoch)
+                j = (j + 1) & mask;
+            set->entries[j] = old[i];
+        }
+        free(old);
+    }
 
-            abandon_gc:
-            for(int i = 0; i < clique_size; i++){
-                //printf("2. GC pushed in wait queue: %p\n", clique[i]);
-                PICC_wait_queue_push(sched->wait, clique[i]);
-                PICC_release(clique[i]->lock);
-            }
-
-            for(int i = 0; i < candidates_size; i++){
-                //printf("3. GC pushed in wait queue: %p\n", candidates[i]);
-                PICC_wait_queue_push(sched->wait, candidates[i]);
-                PICC_release(candidates[i]->lock);
-            }
-            //printf("4. GC pushed in wait queue: %p\n", candidate);
-            PICC_wait_queue_push(sched->wait, candidate);
-            PICC_release(candidate->lock);
-
-            //printf("<GC no clique found, abandon>\n");
-            PICC_release_all_channels(chans); //-> released one by one in the loop
-            free(clique);
-            free(candidates);
+    mask = set->capacity - 1;
+    for (i = gc_set_slot(set, key); set->entries[i].epoch == set->epoch; i = (i + 1) & mask) {
+        if (set->entries[i].key == key)
             return false;
+    }
+    set->entries[i].key = key;
+    set->entries[i].epoch = set->epoch;
+    set->size++;
+    return true;
+}
+
+/**
+ * Returns the search of the collector of the scheduler pool, created by
+ * its first GC.
+ */
+static PICC_GCScratch *gc_scratch(PICC_SchedPool *sched)
+{
+    if (sched->gc_scratch != NULL)
+        return sched->gc_scratch;
+
+    PICC_ALLOC_CRASH(scratch, PICC_GCScratch) {
+        scratch->members_max = PICC_init_clique_max_size;
+        scratch->channels_max = PICC_init_channels_max_size;
+        scratch->retries_max = PICC_init_channels_max_size;
+        PICC_ALLOC_N_CRASH(members, PICC_PiThread *, scratch->members_max) {
+            scratch->members = members;
+        }
+        PICC_ALLOC_N_CRASH(clocks, uint64_t, scratch->members_max) {
+            scratch->clocks = clocks;
+        }
+        PICC_ALLOC_N_CRASH(channels, PICC_Channel *, scratch->channels_max) {
+            scratch->channels = channels;
+        }
+        PICC_ALLOC_N_CRASH(retries, PICC_Channel *, scratch->retries_max) {
+            scratch->retries = retries;
         }
+        scratch->searching = false;
+        scratch->nb_members = 0;
+        scratch->nb_channels = 0;
+        scratch->nb_retries = 0;
+        gc_set_init(&scratch->visited, PICC_init_visited_capacity);
+        gc_set_init(&scratch->counted, PICC_init_visited_capacity);
+        sched->gc_scratch = scratch;
+    }
+    return sched->gc_scratch;
+}
+
+/**
+ * Frees the search of a collector. A search in progress must have been
+ * ended.
+ *
+ * @param scratch Search to free, may be NULL
+ */
+void PICC_free_gc_scratch(PICC_GCScratch *scratch)
+{
+    if (scratch == NULL)
+        return;
+    free(scratch->members);
+    free(scratch->clocks);
+    free(scratch->channels);
+    free(scratch->retries);
+    free(scratch->visited.entries);
+    free(scratch->counted.entries);
+    free(scratch);
+}
+
+/**
+ * Adds a locked pi-thread, out of the wait queue, to the members of the
+ * clique.
+ */
+static void gc_add_member(PICC_GCScratch *scratch, PICC_PiThread *pt)
+{
+    if (scratch->nb_members >= scratch->members_max) {
+        scratch->members_max *= 2;
+        PICC_REALLOC_N_CRASH(scratch->members, PICC_PiThread *, scratch->members_max) { }
+        PICC_REALLOC_N_CRASH(scratch->clocks, uint64_t, scratch->members_max) { }
+    }
+    scratch->clocks[scratch->nb_members] = PICC_pithread_clock(pt);
+    scratch->members[scratch->nb_members++] = pt;
+}
+
+/**
+ * Adds a channel to the channels to walk.
+ */
+static void gc_add_channel(PICC_GCScratch *scratch, PICC_Channel *chan)
+{
+    if (scratch->nb_channels >= scratch->channels_max) {
+        scratch->channels_max *= 2;
+        PICC_REALLOC_N_CRASH(scratch->channels, PICC_Channel *, scratch->channels_max) { }
+    }
+    scratch->channels[scratch->nb_channels++] = chan;
+}
+
+/**
+ * Adds a channel to the channels to walk again.
+ */
+static void gc_add_retry(PICC_GCScratch *scratch, PICC_Channel *chan)
+{
+    if (scratch->nb_retries >= scratch->retries_max) {
+        scratch->retries_max *= 2;
+        PICC_REALLOC_N_CRASH(scratch->retries, PICC_Channel *, scratch->retries_max) { }
+    }
+    scratch->retries[scratch->nb_retries++] = chan;
+}
+
+/**
+ * Starts a search from the oldest pi-thread of the wait queue.
+ *
+ * @return false if there is none or it can't be locked
+ */
+static bool gc_start(PICC_SchedPool *sched, PICC_GCScratch *scratch)
+{
+    PICC_PiThread *candidate = PICC_wait_queue_pop_old(sched->wait);
+    if (candidate == NULL)
+        return false;
+    if (!(PICC_try_acquire(candidate->lock))) {
+        PICC_wait_queue_push(sched->wait, candidate);
+        return false;
     }
 
+    scratch->searching = true;
+    scratch->nb_members = 0;
+    scratch->next_member = 0;
+    scratch->nb_channels = 0;
+    scratch->next_channel = 0;
+    scratch->nb_retries = 0;
+    scratch->stalls = 0;
+    gc_set_clear(&scratch->visited);
+    gc_set_add(&scratch->visited, candidate);
+    gc_add_member(scratch, candidate);
     return true;
 }
+
+/**
+ * Ends the search: the members are reclaimed if a clique was found, put
+ * back in the wait queue and unlocked otherwise.
+ */
+static PICC_GCResult gc_end(PICC_SchedPool *sched, PICC_GCScratch *scratch, bool found)
+{
+    int i;
+    for (i = 0; i < scratch->nb_members; i++) {
+        PICC_PiThread *member = scratch->members[i];
+        if (found) {
+            PICC_reclaim_pi_thread(member);
+        } else {
+            PICC_wait_queue_push(sched->wait, member);
+            PICC_release(member->lock);
+        }
+    }
+    scratch->searching = false;
+    return found ? PICC_GC_RECLAIMED : PICC_GC_ABANDONED;
+}
+
+/**
+ * Pauses the search between two slices: the members are put back in the
+ * old zone of the wait queue and unlocked.
+ *
+ * @return PICC_GC_PENDING
+ */
+static PICC_GCResult gc_pause(PICC_SchedPool *sched, PICC_GCScratch *scratch)
+{
+    ALLOC_ERROR(error);
+    int i;
+    for (i = 0; i < scratch->nb_members; i++) {
+        PICC_PiThread *member = scratch->members[i];
+        PICC_wait_queue_push_old(sched->wait, member, &error);
+        atomic_store(&member->gc_pin, PICC_GC_PIN_PAUSED);
+        PICC_release(member->lock);
+    }
+    if (HAS_ERROR(error))
+        CRASH(&error);
+    return PICC_GC_PENDING;
+}
+
+/**
+ * Resumes a paused search: the members are locked and fetched from the
+ * wait queue again. A member that can't be locked, that is no longer
+ * waiting, or that has been chosen or awoken since it was taken (its
+ * clock tells) abandons the search, the members go back to the wait
+ * queue. A member reclaimed meanwhile was left to the collector, it is
+ * reclaimed now.
+ *
+ * @return false if the search is abandoned
+ */
+static bool gc_resume(PICC_SchedPool *sched, PICC_GCScratch *scratch)
+{
+    bool reclaimed = false;
+    int i, n = 0;
+    for (i = 0; i < scratch->nb_members; i++) {
+        PICC_PiThread *member = scratch->members[i];
+        if (atomic_exchange(&member->gc_pin, PICC_GC_PIN_NONE) == PICC_GC_PIN_RECLAIMED) {
+            PICC_reclaim_pi_thread(member);
+            reclaimed = true;
+        } else {
+            scratch->clocks[n] = scratch->clocks[i];
+            scratch->members[n++] = member;
+        }
+    }
+    scratch->nb_members = n;
+    if (reclaimed) {
+        // the other members are unlocked in the wait queue
+        scratch->nb_members = 0;
+        gc_end(sched, scratch, false);
+        return false;
+    }
+
+    for (i = 0; i < scratch->nb_members; i++) {
+        PICC_PiThread *member = scratch->members[i];
+        if (!(PICC_try_acquire(member->lock)))
+            break;
+        if (member->status != PICC_STATUS_WAIT || member->commit != NULL
+            || PICC_pithread_clock(member) != scratch->clocks[i]
+            || PICC_wait_queue_fetch(sched->wait, member) == NULL) {
+            PICC_release(member->lock);
+            break;
+        }
+    }
+    if (i == scratch->nb_members)
+        return true;
+
+    // the members not taken again are still in the wait queue
+    scratch->nb_members = i;
+    gc_end(sched, scratch, false);
+    return false;
+}
+
+/**
+ * Walks a commit list of a locked channel: the pi-thread of each valid
+ * commitment is counted in the counted set, and, if not met yet, locked,
+ * fetched from the wait queue and added to the members. The invalid
+ * commitments are removed on the way.
+ *
+ * @param budget Commitments left to the slice, decremented
+ * @return false if one of the pi-threads could not be taken yet
+ */
+static bool gc_walk(PICC_SchedPool *sched, PICC_GCScratch *scratch, PICC_CommitList *clist,
+                    int *budget)
+{
+    PICC_CommitListElement *el = clist->head;
+    bool taken = true;
+
+    while (el != NULL) {
+        PICC_Commit *commit = el->commit;
+        PICC_PiThread *pt = commit->thread;
+        // kept by the removal
+        el = el->next;
+        (*budget)--;
+
+        if (!PICC_is_valid_commit(commit)) {
+            PICC_commit_list_remove(clist, commit);
+            continue;
+        }
+        gc_set_add(&scratch->counted, pt);
+        if (gc_set_contains(&scratch->visited, pt))
+            continue;
+
+        // a pi-thread on its way to wait or to be awoken is retried
+        if (pt->status != PICC_STATUS_WAIT || !(PICC_try_acquire(pt->lock))) {
+            taken = false;
+            continue;
+        }
+        if (PICC_wait_queue_fetch(sched->wait, pt) == NULL) {
+            PICC_release(pt->lock);
+            taken = false;
+            continue;
+        }
+        gc_set_add(&scratch->visited, pt);
+        gc_add_member(scratch, pt);
+    }
+    return taken;
+}
+
+/**
+ * Walks a channel of the search. A channel that can't be locked, or some
+ * of whose pi-threads can't be taken, is retried.
+ *
+ * @param budget Commitments left to the slice, decremented
+ * @return false if the channel is known by a pi-thread out of the clique
+ */
+static bool gc_channel(PICC_SchedPool *sched, PICC_GCScratch *scratch, PICC_Channel *chan,
+                       int *budget)
+{
+    if (!(PICC_try_acquire(chan->lock))) {
+        gc_add_retry(scratch, chan);
+        return true;
+    }
+    // fewer commitments than references: known elsewhere
+    bool garbage = chan->incommits->size + chan->outcommits->size >= chan->global_rc;
+    if (garbage) {
+        gc_set_clear(&scratch->counted);
+        bool taken = gc_walk(sched, scratch, chan->incommits, budget);
+        taken = gc_walk(sched, scratch, chan->outcommits, budget) && taken;
+        garbage = scratch->counted.size >= chan->global_rc;
+        if (garbage && !taken)
+            gc_add_retry(scratch, chan);
+    }
+    PICC_release(chan->lock);
+    return garbage;
+}
+
+/**
+ * Follows the commitments of a member: their channels not met yet are
+ * added to the channels to walk.
+ *
+ * @param budget Commitments left to the slice, decremented
+ */
+static void gc_member(PICC_GCScratch *scratch, PICC_PiThread *pt, int *budget)
+{
+    PICC_CommitListElement *el;
+    for (el = pt->commits->head; el != NULL; el = el->next) {
+        (*budget)--;
+        if (PICC_is_valid_commit(el->commit) && gc_set_add(&scratch->visited, el->commit->channel))
+            gc_add_channel(scratch, el->commit->channel);
+    }
+}
+
+/**
+ * Runs a slice of the search of a clique of waiting PiThreads, the
+ * PiThreads being garbage if every reference to the channels they wait
+ * on comes from one of them. A search starts from the oldest pi-thread
+ * of the wait queue and goes on breadth first, from slice to slice, as
+ * described by PICC_GCScratch: a slice first walks the retries again, then
+ * follows the members and channels until it has examined budget
+ * commitments. A pi-thread that does not wait or a channel known by
+ * another pi-thread abandons the search, the members go back to the wait
+ * queue. The members are only locked while a slice runs, the channels
+ * while walked: a member awoken between two slices abandons the search
+ * (see PICC_GCScratch).
+ *
+ * Only one collector may run slices on a scheduler pool.
+ *
+ * @pre sched != NULL && budget > 0
+ * @param sched Scheduler pool
+ * @param budget Commitments the slice may examine; a channel is always
+ *               walked at once
+ * @return PICC_GC_PENDING until the search ends
+ */
+PICC_GCResult PICC_gc_slice(PICC_SchedPool *sched, int budget)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sched != NULL);
+        ASSERT(budget > 0);
+    #endif
+
+    PICC_GCScratch *scratch = gc_scratch(sched);
+    int i, nb_retries;
+
+    if (!scratch->searching) {
+        if (!gc_start(sched, scratch))
+            return PICC_GC_ABANDONED;
+    } else if (!gc_resume(sched, scratch)) {
+        return PICC_GC_ABANDONED;
+    }
+
+    nb_retries = scratch->nb_retries;
+    scratch->nb_retries = 0;
+    for (i = 0; i < nb_retries; i++) {
+        if (!gc_channel(sched, scratch, scratch->retries[i], &budget)) {
+            scratch->nb_retries = 0;
+            return gc_end(sched, scratch, false);
+        }
+    }
+
+    bool progress = scratch->nb_retries < nb_retries;
+    while (budget > 0) {
+        if (scratch->next_channel < scratch->nb_channels) {
+            PICC_Channel *chan = scratch->channels[scratch->next_channel++];
+            if (!gc_channel(sched, scratch, chan, &budget))
+                return gc_end(sched, scratch, false);
+        } else if (scratch->next_member < scratch->nb_members) {
+            gc_member(scratch, scratch->members[scratch->next_member++], &budget);
+        } else {
+            break;
+        }
+        progress = true;
+    }
+
+    if (scratch->next_channel < scratch->nb_channels || scratch->next_member < scratch->nb_members)
+        return gc_pause(sched, scratch);
+    if (scratch->nb_retries == 0)
+        return gc_end(sched, scratch, true);
+    scratch->stalls = progress ? 0 : scratch->stalls + 1;
+    if (scratch->stalls >= PICC_GC_MAX_STALLS)
+        return gc_end(sched, scratch, false);
+    return gc_pause(sched, scratch);
+}
+
+/**
+ * Runs a whole search of a clique with PICC_gc_slice, yielding the CPU
+ * between two slices.
+ *
+ * @param sched Scheduler pool
+ * @return Whether a clique was found and reclaimed
+ */
+bool PICC_GC2(PICC_SchedPool* sched)
+{
+    PICC_GCResult result;
+    while ((result = PICC_gc_slice(sched, PICC_GC_SLICE)) == PICC_GC_PENDING)
+        PICC_low_level_yield();
+    return result == PICC_GC_RECLAIMED;
+}
+
+/**
+ * Walks a commit list of a channel while the world is stopped: the
+ * pi-thread of each valid commitment is counted in the counted set and,
+ * if not met yet, added to the members. The invalid commitments are
+ * removed on the way.
+ *
+ * @return false if one of the pi-threads is not in the wait queue
+ */
+static bool gc_full_walk(PICC_GCScratch *scratch, PICC_CommitList *clist)
+{
+    PICC_CommitListElement *el = clist->head;
+    bool waiting = true;
+
+    while (el != NULL) {
+        PICC_Commit *commit = el->commit;
+        PICC_PiThread *pt = commit->thread;
+        // kept by the removal
+        el = el->next;
+
+        if (!PICC_is_valid_commit(commit)) {
+            PICC_commit_list_remove(clist, commit);
+            continue;
+        }
+        gc_set_add(&scratch->counted, pt);
+        // a pi-thread met by another component may be running
+        if (pt->status != PICC_STATUS_WAIT || pt->wait_zone == PICC_WAIT_ZONE_NONE)
+            waiting = false;
+        else if (gc_set_add(&scratch->visited, pt))
+            gc_add_member(scratch, pt);
+    }
+    return waiting;
+}
+
+/**
+ * Follows the component of a waiting pi-thread while the world is
+ * stopped: the pi-threads it reaches are added to the members after it,
+ * including the ones of the components met before.
+ *
+ * @return Whether the component is a clique
+ */
+static bool gc_full_component(PICC_GCScratch *scratch, PICC_PiThread *root)
+{
+    int next_member = scratch->nb_members;
+    int budget = INT_MAX;
+    bool garbage = true;
+
+    scratch->nb_channels = 0;
+    scratch->next_channel = 0;
+    gc_add_member(scratch, root);
+    while (next_member < scratch->nb_members) {
+        gc_member(scratch, scratch->members[next_member++], &budget);
+        while (scratch->next_channel < scratch->nb_channels) {
+            PICC_Channel *chan = scratch->channels[scratch->next_channel++];
+            gc_set_clear(&scratch->counted);
+            bool waiting = gc_full_walk(scratch, chan->incommits);
+            waiting = gc_full_walk(scratch, chan->outcommits) && waiting;
+            // the component is still followed, so that none of it is met again
+            garbage = garbage && waiting && scratch->counted.size >= chan->global_rc;
+        }
+    }
+    return garbage;
+}
+
+/**
+ * Collects every clique of the wait queue at once, without taking the
+ * locks of the pi-threads and channels: each waiting pi-thread not met
+ * yet starts a component, garbage if all its channels are known only by
+ * its pi-threads (see PICC_gc_slice). The members of the cliques are then
+ * reclaimed.
+ *
+ * No PiThread may run meanwhile: the collector has stopped the world
+ * (see PICC_sched_pool_collect), or the scheduler pool is serial. No
+ * search of PICC_gc_slice may be in progress.
+ *
+ * @pre sched != NULL && nb_components != NULL
+ * @param sched Scheduler pool
+ * @param nb_components Set to the number of components followed
+ * @return The number of cliques reclaimed
+ */
+long PICC_gc_full(PICC_SchedPool *sched, long *nb_components)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sched != NULL);
+        ASSERT(nb_components != NULL);
+    #endif
+
+    PICC_GCScratch *scratch = gc_scratch(sched);
+    PICC_WaitQueue *wq = sched->wait;
+    PICC_PiThread *pt;
+    long cliques = 0;
+    int i;
+
+    #ifdef CONTRACT_PRE
+        ASSERT(!scratch->searching);
+    #endif
+
+    gc_set_clear(&scratch->visited);
+    scratch->nb_members = 0;
+    *nb_components = 0;
+    // the active zone is linked before the old one
+    pt = wq->active.head != NULL ? wq->active.head : wq->old.head;
+    for (; pt != NULL; pt = pt->wait_next) {
+        if (!gc_set_add(&scratch->visited, pt))
+            continue;
+        int first = scratch->nb_members;
+        (*nb_components)++;
+        if (gc_full_component(scratch, pt))
+            cliques++;
+        else
+            scratch->nb_members = first;
+    }
+
+    for (i = 0; i < scratch->nb_members; i++) {
+        PICC_wait_queue_fetch(wq, scratch->members[i]);
+        PICC_reclaim_pi_thread(scratch->members[i]);
+    }
+    scratch->nb_members = 0;
+    return cliques;
+}
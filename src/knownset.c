@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <knownset_repr.h>
 #include <tools.h>
@@ -51,6 +52,8 @@ PICC_KnownSet *PICC_create_knownset(int init_max_size, PICC_Error *error)
     PICC_ALLOC(knownset, PICC_KnownSet, error) {
         knownset->max_size = init_max_size;
         knownset->current_size = 0;
+        knownset->embedded = false;
+        knownset->embedded_content = false;
 
         PICC_KnownElement *elts = malloc(sizeof(PICC_KnownElement) * init_max_size);
         if (elts == NULL) {
@@ -107,15 +110,51 @@ PICC_KnownSet *PICC_create_empty_knownset()
 }
 
 /**
- * Deallocates the given known set.
+ * Initializes a known set embedded in another memory block, with the given
+ * initial content storage.
+ *
+ * @pre max_size > 0
+ * @post knownset.max_size = max_size
+ * @post knowset.current_size = 0
+ * @param knownset Known set to initialize
+ * @param content Storage for max_size elements
+ * @param max_size Initial set size
+ */
+void PICC_init_knownset(PICC_KnownSet *knownset, PICC_KnownElement *content, int max_size)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(max_size > 0);
+    #endif
+
+    knownset->max_size = max_size;
+    knownset->current_size = 0;
+    knownset->content = content;
+    knownset->embedded = true;
+    knownset->embedded_content = true;
+    for (int i = 0; i < max_size; i++) {
+        content[i].state = PICC_UNKNOWN;
+        content[i].value.header = MAKE_HEADER(TAG_NOVALUE, 0);
+        content[i].value.handle = NULL;
+    }
+
+    #ifdef CONTRACT_POST_INV
+        PICC_KnownSet_inv(knownset);
+    #endif
+}
+
+/**
+ * Deallocates the given known set. The embedded parts are left to their
+ * owner.
  *
  * @param knownset Known set to deallocate
  */
 void PICC_free_knownset(PICC_KnownSet *knownset)
 {
     if (knownset != NULL) {
-        free(knownset->content);
-        free(knownset);
+        if (!knownset->embedded_content)
+            free(knownset->content);
+        if (!knownset->embedded)
+            free(knownset);
     }
 }
 
@@ -178,6 +217,10 @@ PICC_KnownElement *PICC_knownset_get_element(PICC_KnownSet *knownset, PICC_Known
  *     if the channel is in the FORGET state, switches it to KNOWN and returns false
  *   else adds the channel to the known set with a KNOWN state and returns true
  *
+ * When the channel is added, the caller takes the reference that
+ * PICC_process_end drops. A worker takes it through
+ * PICC_handle_defer_incr_ref_count, which cancels a decrement it buffered.
+ *
  * @pre ks != null
  * @pre val != null
  * @post if (val in ks and val@pre.state = KNOWN) then false
@@ -273,7 +316,16 @@ bool PICC_knownset_add(PICC_KnownSet *ks, PICC_KnownValue *val)
     if (elem == NULL) { // not in set, we need to add it
         if (ks->current_size == ks->max_size) { // set full, we need to realloc
 	    int new_max_size = ks->current_size + SET_INIT_MAXSIZE;
-	    PICC_KnownElement *new_elts = realloc(ks->content, sizeof(PICC_KnownElement) * new_max_size);
+	    PICC_KnownElement *new_elts;
+	    if (ks->embedded_content) {
+	        // the initial content belongs to the owner block, move out of it
+	        new_elts = malloc(sizeof(PICC_KnownElement) * new_max_size);
+	        if (new_elts != NULL)
+	            memcpy(new_elts, ks->content, sizeof(PICC_KnownElement) * ks->current_size);
+	        ks->embedded_content = false;
+	    } else {
+	        new_elts = realloc(ks->content, sizeof(PICC_KnownElement) * new_max_size);
+	    }
 	    if (new_elts == NULL) {
 		CRASH_NEW_ERROR(ERR_OUT_OF_MEMORY);
 	    }
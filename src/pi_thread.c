@@ -17,25 +17,193 @@
 #include <value_repr.h>
 #include <atomic_repr.h>
 #include <knownset_repr.h>
+#include <topology_repr.h>
 #include <tools.h>
 
+/**
+ * The recycling pool of the current worker.
+ */
+static __thread PICC_PiThreadPool local_pool;
+
+/**
+ * The depots shared by the workers of each NUMA node, filled by the
+ * pre-warming and by the workers whose pool overflows. A worker only uses
+ * the depot of its node, so that it reuses node-local memory.
+ */
+static PICC_PiThreadPool depots[PICC_MAX_NODES];
+static pthread_mutex_t depot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The number of pi-thread blocks allocated so far.
+ */
+static atomic_long nb_allocs;
+
+/**
+ * Returns the bucket of the given shape in a pool, adding it if create is
+ * true and there is room for a new shape.
+ *
+ * @return The bucket, NULL if there is none
+ */
+static PICC_PiThreadBucket *pool_bucket(PICC_PiThreadPool *pool, int env_length,
+                                        int knowns_length, int enabled_length, bool create)
+{
+    int i;
+    for (i = 0; i < pool->nb_buckets; i++) {
+        PICC_PiThreadBucket *bucket = &pool->buckets[i];
+        if (bucket->env_length == env_length && bucket->knowns_length == knowns_length
+            && bucket->enabled_length == enabled_length)
+            return bucket;
+    }
+    if (!create || pool->nb_buckets == PICC_PITHREAD_POOL_SHAPES)
+        return NULL;
+
+    PICC_PiThreadBucket *bucket = &pool->buckets[pool->nb_buckets++];
+    bucket->env_length = env_length;
+    bucket->knowns_length = knowns_length;
+    bucket->enabled_length = enabled_length;
+    bucket->free = NULL;
+    bucket->size = 0;
+    return bucket;
+}
+
+static void bucket_push(PICC_PiThreadBucket *bucket, PICC_PiThread *pt)
+{
+    pt->ready_next = bucket->free;
+    bucket->free = pt;
+    bucket->size++;
+}
+
+static PICC_PiThread *bucket_pop(PICC_PiThreadBucket *bucket)
+{
+    PICC_PiThread *pt = bucket->free;
+    if (pt != NULL) {
+        bucket->free = pt->ready_next;
+        bucket->size--;
+    }
+    return pt;
+}
+
+/**
+ * Moves up to count pi-threads from a bucket to another one.
+ */
+static void bucket_move(PICC_PiThreadBucket *from, PICC_PiThreadBucket *to, int count)
+{
+    PICC_PiThread *pt;
+    while (count-- > 0 && (pt = bucket_pop(from)) != NULL)
+        bucket_push(to, pt);
+}
+
+/**
+ * Rounds the given size up to the alignment of a value.
+ */
+static size_t pithread_align(size_t size)
+{
+    size_t align = _Alignof(PICC_Value);
+    return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * Computes the size of the block of a PiThread with the given lengths,
+ * rounded up to a multiple of the cache line size.
+ */
+static size_t pithread_block_size(int env_length, int knowns_length, int enabled_length)
+{
+    size_t size = pithread_align(sizeof(PICC_PiThread));
+    size += pithread_align(sizeof(PICC_Value) * env_length);
+    size += pithread_align(sizeof(PICC_KnownElement) * knowns_length);
+    size += sizeof(bool) * enabled_length;
+    return (size + PICC_CACHE_LINE_SIZE - 1) & ~((size_t) PICC_CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * Allocates the block of a PiThread of the given shape. The PiThread is
+ * initialised by pithread_init.
+ */
+static PICC_PiThread *pithread_alloc(int env_length, int knowns_length, int enabled_length)
+{
+    size_t block_size = pithread_block_size(env_length, knowns_length, enabled_length);
+    PICC_PiThread *thread = aligned_alloc(PICC_CACHE_LINE_SIZE, block_size);
+    if (thread == NULL) {
+        CRASH_NEW_ERROR(ERR_OUT_OF_MEMORY);
+    }
+    atomic_fetch_add_explicit(&nb_allocs, 1, memory_order_relaxed);
+    thread->block_size = block_size;
+    thread->env_length = env_length;
+    thread->knowns_length = knowns_length;
+    thread->enabled_length = enabled_length;
+    // nothing to free in the knowns set until pithread_init
+    thread->knowns = &thread->knowns_set;
+    thread->knowns->embedded = true;
+    thread->knowns->embedded_content = true;
+    atomic_init(&thread->clock, 0);
+    atomic_init(&thread->gc_pin, PICC_GC_PIN_NONE);
+    return thread;
+}
+
+/**
+ * (Re)initialises a PiThread in its block. A knowns set content that had
+ * grown out of the block is freed.
+ */
+static void pithread_init(PICC_PiThread *thread)
+{
+    int i;
+    unsigned char *storage = (unsigned char *) thread + pithread_align(sizeof(PICC_PiThread));
+    thread->env = thread->env_length > 0 ? (PICC_Value *) storage : NULL;
+    storage += pithread_align(sizeof(PICC_Value) * thread->env_length);
+
+    thread->knowns = &thread->knowns_set;
+    PICC_free_knownset(thread->knowns);
+    PICC_init_knownset(thread->knowns, (PICC_KnownElement *) storage, thread->knowns_length);
+    storage += pithread_align(sizeof(PICC_KnownElement) * thread->knowns_length);
+
+    thread->enabled = thread->enabled_length > 0 ? (bool *) storage : NULL;
+    for (i = 0; i < thread->enabled_length; i++) {
+        thread->enabled[i] = false;
+    }
+
+    thread->commits = &thread->commits_list;
+    PICC_init_commit_list(thread->commits, PICC_COMMIT_THREAD_LINK);
+    thread->commit = NULL;
+
+    // the GC reclaims pi-threads while holding their lock
+    thread->lock = &thread->lock_storage;
+    PICC_init_lock(thread->lock);
+
+    thread->proc = NULL;
+    thread->pc = PICC_DEFAULT_ENTRY_LABEL;
+    thread->fuel = PICC_FUEL_INIT;
+    thread->priority = PICC_PRIORITY_NORMAL;
+    PICC_INIT_NO_VALUE(&thread->val);
+    thread->ready_next = NULL;
+    thread->wait_next = NULL;
+    thread->wait_prev = NULL;
+    thread->wait_zone = PICC_WAIT_ZONE_NONE;
+    thread->status = PICC_STATUS_RUN;
+}
+
 /**
  * Creates a new PiThread with given environment and knowns set length.
  *
+ * The PiThread, its environment, the initial content of its knowns set and
+ * its enabled flags are allocated as one cache-line aligned block. A
+ * reclaimed PiThread of the same shape is reused when the pool of the
+ * current worker, or else the depot of its node, has one.
+ *
  * @pre env_length >= 0
  * @pre knowns_length >= 0
+ * @pre enabled_length >= 0
  *
  * @post thread->env_length == env_length
- * @post thread->enabled == NULL
- * @post thread->enabled_length == 0
+ * @post thread->enabled_length == enabled_length
  * @post thread->commit == NULL
  * @post thread->proc == NULL
  * @post thread->pc == PICC_DEFAULT_ENTRY_LABEL
  * @post thread->fuel == PICC_FUEL_INIT
- * @post thread->val == NULL
+ * @post thread->val.header == MAKE_HEADER(TAG_NOVALUE, 0)
  *
  * @param env_length Size of the environment
  * @param knowns_length Size of the knowns set
+ * @param enabled_length Number of enabled flags
  * @return Created PiThread
  */
 PICC_PiThread *PICC_create_pithread(int env_length, int knowns_length, int enabled_length)
@@ -46,48 +214,27 @@ PICC_PiThread *PICC_create_pithread(int env_length, int knowns_length, int enabl
         ASSERT(knowns_length >= 0);
         ASSERT(enabled_length >= 0);
     #endif
-	int i;
-    PICC_ALLOC_CRASH(thread, PICC_PiThread) {
-        ALLOC_ERROR(sub_error);
-        /* thread->chans = PICC_create_empty_knownset(); */
-        thread->knowns = PICC_create_knownset(knowns_length, &sub_error);
-        thread->clock = PICC_create_clock(&sub_error);
-        if (HAS_ERROR(sub_error)) {
-            CRASH(&sub_error);
-        } else {
-            PICC_ALLOC_N_CRASH(env, PICC_Value, env_length) {
-                
-                if (HAS_ERROR(sub_error)) {
-                    CRASH(&sub_error);
-                } else {
-                    thread->commits = PICC_create_commit_list(&sub_error);
-                    thread->commit = NULL;
-                    if (HAS_ERROR(sub_error)) {
-                        CRASH(&sub_error);
-                    } else {
-                        thread->env = env;
-                        thread->env_length = env_length;
-                        PICC_ALLOC_N_CRASH(enabled, bool, enabled_length) {
-                            thread->enabled = enabled;
-                            for(i=0; i<enabled_length; i++){
-                                thread->enabled[i] = false;
-                            }
-                            thread->enabled_length = enabled_length;
-                            thread->proc = NULL;
-                            thread->pc = PICC_DEFAULT_ENTRY_LABEL;
-                            thread->fuel = PICC_FUEL_INIT;
-                            PICC_INIT_NO_VALUE(&thread->val);
-                            thread->lock = PICC_create_lock(&sub_error);
-                            thread->status = PICC_STATUS_RUN;
-                            if (HAS_ERROR(sub_error)) {
-                                CRASH(&sub_error);
-                            }
-                        }
-                    }
-                }
-            }
+
+    if (knowns_length < SET_INIT_MAXSIZE)
+        knowns_length = SET_INIT_MAXSIZE;
+
+    PICC_PiThread *thread = NULL;
+    PICC_PiThreadBucket *bucket =
+        pool_bucket(&local_pool, env_length, knowns_length, enabled_length, true);
+    if (bucket != NULL) {
+        if (bucket->free == NULL) {
+            pthread_mutex_lock(&depot_lock);
+            PICC_PiThreadBucket *shared =
+                pool_bucket(&depots[PICC_current_node()], env_length, knowns_length, enabled_length, false);
+            if (shared != NULL)
+                bucket_move(shared, bucket, PICC_PITHREAD_POOL_MAX / 2);
+            pthread_mutex_unlock(&depot_lock);
         }
+        thread = bucket_pop(bucket);
     }
+    if (thread == NULL)
+        thread = pithread_alloc(env_length, knowns_length, enabled_length);
+    pithread_init(thread);
 
     #ifdef CONTRACT_POST_INV
         // inv
@@ -109,29 +256,167 @@ PICC_PiThread *PICC_create_pithread(int env_length, int knowns_length, int enabl
 }
 
 /**
- * Reclaims the given PiThread.
+ * Frees the block of the given PiThread.
+ */
+static void pithread_free(PICC_PiThread *pt)
+{
+    PICC_free_knownset(pt->knowns);
+    /* PICC_free_knownset(pt->chans); */
+    free(pt);
+}
+
+/**
+ * Reclaims the given PiThread, ended or collected by the GC. It is kept in
+ * the pool of the current worker for a later PICC_create_pithread of the
+ * same shape. When the pool is full, half of it goes to the depot of its
+ * node, and when the depot is full the PiThread is freed.
  *
  * @param pt PiThread to reclaim
  */
 void PICC_reclaim_pi_thread(PICC_PiThread *pt)
 {
-    free(pt->enabled);
-    PICC_free_knownset(pt->knowns);
-    /* PICC_free_knownset(pt->chans); */
-    free(pt->env);
-    free(pt->clock);
-    free(pt->commits);
-    PICC_lock_free(pt->lock);
+    // the clock is kept across reuses so that the commitments left in the
+    // channel lists stay invalid: the ended PiThreads have withdrawn theirs
+    // (see PICC_process_end), a clique collected by the GC leaves its own
+    // in garbage channels only
+    atomic_fetch_add_explicit(&pt->clock, 1, memory_order_acq_rel);
+
+    // a member of a paused GC search is reclaimed by the collector when it
+    // resumes, the block must stay valid until then
+    int paused = PICC_GC_PIN_PAUSED;
+    if (atomic_compare_exchange_strong(&pt->gc_pin, &paused, PICC_GC_PIN_RECLAIMED))
+        return;
+
+    PICC_PiThreadBucket *bucket =
+        pool_bucket(&local_pool, pt->env_length, pt->knowns_length, pt->enabled_length, true);
+    if (bucket == NULL) {
+        pithread_free(pt);
+        return;
+    }
+
+    if (bucket->size >= PICC_PITHREAD_POOL_MAX) {
+        pthread_mutex_lock(&depot_lock);
+        PICC_PiThreadBucket *shared =
+            pool_bucket(&depots[PICC_current_node()], pt->env_length, pt->knowns_length, pt->enabled_length, true);
+        if (shared != NULL && shared->size < PICC_PITHREAD_DEPOT_MAX)
+            bucket_move(bucket, shared, PICC_PITHREAD_POOL_MAX / 2);
+        pthread_mutex_unlock(&depot_lock);
+    }
+
+    if (bucket->size >= PICC_PITHREAD_POOL_MAX)
+        pithread_free(pt);
+    else
+        bucket_push(bucket, pt);
 }
 
+/**
+ * Pre-allocates pi-threads of the given shape in the depot of the current
+ * node, until it holds count of them, so that the workers spawning them do
+ * not allocate in steady state. A runtime pre-warms the shape of each
+ * entry pi-thread it spawns, the generated code may pre-warm its other
+ * shapes before. The depots outlive the runtimes: a restarted runtime
+ * reuses the pi-threads of the previous one.
+ *
+ * @pre env_length >= 0
+ * @pre knowns_length >= 0
+ * @pre enabled_length >= 0
+ *
+ * @param env_length Size of the environment
+ * @param knowns_length Size of the knowns set
+ * @param enabled_length Number of enabled flags
+ * @param count Number of pi-threads the depot should hold
+ */
+void PICC_pithread_pool_prewarm(int env_length, int knowns_length, int enabled_length, int count)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(env_length >= 0);
+        ASSERT(knowns_length >= 0);
+        ASSERT(enabled_length >= 0);
+    #endif
+
+    if (knowns_length < SET_INIT_MAXSIZE)
+        knowns_length = SET_INIT_MAXSIZE;
+
+    pthread_mutex_lock(&depot_lock);
+    PICC_PiThreadBucket *shared =
+        pool_bucket(&depots[PICC_current_node()], env_length, knowns_length, enabled_length, true);
+    if (shared != NULL) {
+        while (shared->size < count && shared->size < PICC_PITHREAD_DEPOT_MAX) {
+            bucket_push(shared, pithread_alloc(env_length, knowns_length, enabled_length));
+        }
+    }
+    pthread_mutex_unlock(&depot_lock);
+}
 
 /**
- * Returns whether a PiThread can be awaken with the given commit.
+ * Frees the pi-threads of a pool.
+ */
+static void pool_clear(PICC_PiThreadPool *pool)
+{
+    PICC_PiThread *pt;
+    int i;
+    for (i = 0; i < pool->nb_buckets; i++) {
+        while ((pt = bucket_pop(&pool->buckets[i])) != NULL)
+            pithread_free(pt);
+    }
+    pool->nb_buckets = 0;
+}
+
+/**
+ * Gives the pool of the current worker back to the depot of its node,
+ * before the worker exits. The pi-threads the depot cannot hold are
+ * freed.
+ */
+void PICC_pithread_pool_flush()
+{
+    int i;
+
+    pthread_mutex_lock(&depot_lock);
+    for (i = 0; i < local_pool.nb_buckets; i++) {
+        PICC_PiThreadBucket *bucket = &local_pool.buckets[i];
+        PICC_PiThreadBucket *shared =
+            pool_bucket(&depots[PICC_current_node()], bucket->env_length,
+                        bucket->knowns_length, bucket->enabled_length, true);
+        if (shared != NULL)
+            bucket_move(bucket, shared, PICC_PITHREAD_DEPOT_MAX - shared->size);
+    }
+    pthread_mutex_unlock(&depot_lock);
+
+    pool_clear(&local_pool);
+}
+
+/**
+ * Returns the number of pi-thread blocks allocated so far, the reused
+ * ones aside.
+ */
+long PICC_pithread_nb_allocs()
+{
+    return atomic_load_explicit(&nb_allocs, memory_order_relaxed);
+}
+
+/**
+ * Frees the pi-threads of the pool of the current worker and of the shared
+ * depots.
+ */
+void PICC_pithread_pool_clear()
+{
+    int node;
+
+    pool_clear(&local_pool);
+    pthread_mutex_lock(&depot_lock);
+    for (node = 0; node < PICC_MAX_NODES; node++)
+        pool_clear(&depots[node]);
+    pthread_mutex_unlock(&depot_lock);
+}
+
+
+/**
+ * Returns whether a PiThread can be awaken with the given commit. Only the
+ * first valid commitment of a choice can awake the PiThread.
  *
  * @pre PICC_PiThread_inv(pt) must pass
  * @pre PICC_Commit_inv(commit) must pass
  *
- * @post valid commitment implies pt->clock->val <= PICC_CLOCK_MAX_IN
  * @post valid commitment implies pt->commit == commit
  *
  * @param pt PiThread to check
@@ -156,7 +441,8 @@ PICC_CommitStatus PICC_can_awake(PICC_PiThread *pt, PICC_Commit *commit)
     if (!PICC_try_acquire(pt->lock)) {
         status = PICC_CANNOT_ACQUIRE;
 
-    } else if (commit->clock != pt->clock || commit->clockval != PICC_atomic_int_get(commit->clock->val)) {
+    } else if (commit->clockval != PICC_pithread_clock(pt) || pt->commit != NULL) {
+        // another commitment of a choice has already been chosen
         PICC_release(pt->lock);
         status = PICC_INVALID_COMMIT;
 
@@ -182,7 +468,8 @@ PICC_CommitStatus PICC_can_awake(PICC_PiThread *pt, PICC_Commit *commit)
 }
 
 /**
- * Awakes a PiThread in the given scheduler.
+ * Awakes a PiThread in the given scheduler. It is handed off to the
+ * current worker, to run there as soon as the running PiThread stops.
  *
  * @pre PICC_PiThread_inv(pt) must pass
  * @pre PICC_Commit_inv(commit) must pass
@@ -214,26 +501,15 @@ void PICC_awake(PICC_SchedPool *sched, PICC_PiThread *pt, PICC_Commit *commit)
     if (pt->commit != commit) {
         CRASH_NEW_ERROR(ERR_INVALID_COMMIT);
     }
-    PICC_PiThread *fetched;
-    do {
-        fetched = PICC_wait_queue_fetch(sched->wait, pt);
-    } while (fetched == NULL);
+    // its worker puts it in the wait queue once its procedure has returned
+    while (PICC_wait_queue_fetch(sched->wait, pt) == NULL)
+        PICC_low_level_yield();
     pt->commit = NULL;
     pt->pc = commit->cont_pc;
     pt->status = PICC_STATUS_RUN;    
 
-    int clock_val = PICC_atomic_int_get(pt->clock->val);
-    if (clock_val == PICC_CLOCK_MAX_INT) {
-        PICC_reclaim_clock(pt->clock);
-        pt->clock = NULL;
-        ALLOC_ERROR(error);
-        pt->clock = PICC_create_clock(&error);
-        if (HAS_ERROR(error)) {
-            CRASH(&error);
-        }
-    } else {
-        PICC_atomic_int_compare_and_swap(pt->clock->val, clock_val, clock_val + 1);
-    }
+    // invalidates the other commitments of the thread
+    atomic_fetch_add_explicit(&pt->clock, 1, memory_order_acq_rel);
 
     #ifdef CONTRACT_POST_INV
         // inv
@@ -247,15 +523,109 @@ void PICC_awake(PICC_SchedPool *sched, PICC_PiThread *pt, PICC_Commit *commit)
         ASSERT(pt->commit == NULL);
         ASSERT(pt->pc == commit->cont_pc);
         ASSERT(pt->status == PICC_STATUS_RUN);
-        ASSERT(PICC_atomic_int_get(pt->clock->val) <= PICC_CLOCK_MAX_INT);
+        ASSERT(PICC_pithread_clock(pt) > commit->clockval);
     #endif
     
     PICC_release(pt->lock);
-    PICC_ready_queue_add(sched->ready, pt);
+    PICC_ready_queue_handoff(sched->ready, pt);
+}
+
+/**
+ * Gives the worker back: the PiThread goes to the end of the ready queue,
+ * and gets a new slice of fuel once popped again. The worker yields the
+ * PiThread once its procedure has returned: a procedure yields by
+ * returning with the PICC_STATUS_CALL status and no fuel left (see
+ * PICC_FUEL_STEP).
+ *
+ * @pre sched != NULL
+ * @pre PICC_PiThread_inv(pt) must pass
+ *
+ * @post pt->status == PICC_STATUS_RUN
+ *
+ * @param sched Scheduler
+ * @param pt Running PiThread
+ */
+void PICC_yield(PICC_SchedPool *sched, PICC_PiThread *pt)
+{
+    #ifdef CONTRACT_PRE
+        // pre
+        ASSERT(sched != NULL);
+    #endif
+
+    #ifdef CONTRACT_PRE_INV
+        // inv
+        PICC_PiThread_inv(pt);
+    #endif
+
+    pt->status = PICC_STATUS_RUN;
+    PICC_ready_queue_yield(sched->ready, pt);
+}
+
+/**
+ * Spawns a batch of new PiThreads in the given scheduler: they are made
+ * ready and spread over the active workers, starting with the current one,
+ * each worker getting a contiguous chunk of the batch in a single
+ * operation (see PICC_ready_queue_scatter).
+ *
+ * @pre sched != NULL
+ * @pre pts != NULL && n >= 0
+ *
+ * @post pts[i]->status == PICC_STATUS_RUN
+ *
+ * @param sched Scheduler
+ * @param pts New PiThreads
+ * @param n Number of PiThreads
+ */
+void PICC_spawn(PICC_SchedPool *sched, PICC_PiThread **pts, int n)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sched != NULL);
+        ASSERT(pts != NULL);
+        ASSERT(n >= 0);
+    #endif
+
+    int i;
+    for (i = 0; i < n; i++) {
+        #ifdef CONTRACT_PRE_INV
+            PICC_PiThread_inv(pts[i]);
+        #endif
+        pts[i]->status = PICC_STATUS_RUN;
+    }
+
+    // the master is always active
+    int nb_active = atomic_load_explicit(&sched->nb_active, memory_order_relaxed) + 1;
+    PICC_ready_queue_scatter(sched->ready, pts, n, nb_active);
+}
+
+/**
+ * Withdraws the commitments of a PiThread from the lists of their
+ * channels, so that none of them refers to the PiThread once it is
+ * reclaimed, and possibly freed. The channel of each commitment is locked,
+ * also when the commitment was already fetched: its awakener holds the
+ * lock while it uses the commitment.
+ *
+ * @param pt PiThread whose commitments are withdrawn
+ */
+static void pithread_withdraw_commitments(PICC_PiThread *pt)
+{
+    PICC_CommitListElement *el;
+    for (el = pt->commits->head; el != NULL; el = el->next) {
+        PICC_Commit *commit = el->commit;
+        PICC_Channel *ch = commit->channel;
+        LOCK_CHANNEL(ch);
+        PICC_commit_list_remove(commit->type == PICC_IN_COMMIT ? ch->incommits : ch->outcommits,
+                                commit);
+        RELEASE_CHANNEL(ch);
+    }
+    PICC_init_commit_list(pt->commits, PICC_COMMIT_THREAD_LINK);
 }
 
 /**
- * End a PiThread.
+ * End a PiThread. Its commitments are withdrawn from their channels, which
+ * the procedure must not hold locked anymore. The references of its known
+ * and forgotten channels are then dropped through the buffer of the
+ * current worker, see PICC_handle_defer_dec_ref_count. Once the procedure
+ * has returned, the worker reclaims an ended PiThread in its pool.
  *
  * @pre pt != NULL
  * @pre PICC_PiThread_inv(pt) must pass
@@ -266,27 +636,16 @@ void PICC_awake(PICC_SchedPool *sched, PICC_PiThread *pt, PICC_Commit *commit)
  * @param status the termination status (Ended or Blocked)
  */
 void PICC_process_end(PICC_PiThread *pt, PICC_StatusKind status) {
-        
-  PICC_KnownValue chan;
-  PICC_KnownSet* s=PICC_knownset_known( pt->knowns );
-  
-  PICC_KNOWNSET_FOREACH(s, 
-                        chan){
-    PICC_handle_dec_ref_count( &PICC_GET_HANDLE( &chan ) );  
-    PICC_free_knownset(s);
-  }
-      
-  s=PICC_knownset_forget( pt->knowns );
-  PICC_KNOWNSET_FOREACH(s, 
-                        chan){
-    PICC_handle_dec_ref_count( &PICC_GET_HANDLE( &chan ) );
-    
+  int i;
+
+  pithread_withdraw_commitments(pt);
+  for (i = 0; i < pt->knowns->current_size; i++) {
+    PICC_KnownElement *elem = &pt->knowns->content[i];
+    if (elem->state == PICC_KNOWN || elem->state == PICC_FORGET)
+      PICC_handle_defer_dec_ref_count(elem->value.handle);
   }
 
-  PICC_free_knownset(s);
-  
   pt->status = status;
-
 }
 
 
@@ -303,39 +662,6 @@ void PICC_low_level_yield()
 }
 
 
-// Clocks //////////////////////////////////////////////////////////////////////
-
-/**
- * Creates a new clock.
- *
- * @param error Error stack
- * @return Created clock
- */
-PICC_Clock *PICC_create_clock(PICC_Error *error)
-{
-    PICC_ALLOC(clock, PICC_Clock, error) {
-        ALLOC_ERROR(sub_error);
-        clock->val = PICC_create_atomic_int(0, &sub_error);
-        if (HAS_ERROR(sub_error)) {
-            ADD_ERROR(error, sub_error, ERR_CLOCK_CREATE);
-            free(clock);
-            clock = NULL;
-        }
-    }
-    return clock;
-}
-
-/**
- * Frees the given clock.
- */
-void PICC_reclaim_clock(PICC_Clock *clock)
-{
-    PICC_free_atomic_int(clock->val);
-    free(clock);
-}
-
-
-
 // Invariants //////////////////////////////////////////////////////////////////
 
 /**
@@ -353,7 +679,6 @@ void PICC_reclaim_clock(PICC_Clock *clock)
  * @inv env_length != NULL implies env != NULL
  * @inv env_length == NULL implies env == NULL
  * @inv commits != NULL
- * @inv clock != NULL
  */
 void PICC_PiThread_inv(PICC_PiThread *pt)
 {
@@ -378,5 +703,4 @@ void PICC_PiThread_inv(PICC_PiThread *pt)
         ASSERT(pt->env != NULL);
     }
     ASSERT(pt->commits != NULL);
-    ASSERT(pt->clock != NULL);
 }
@@ -21,52 +21,337 @@
 #define RELEASE_QUEUE(q) \
     PICC_release((q->lock));
 
-// used for wait queue zones
-const static int ACTIVE = 1;
-const static int OLD = 0;
+// READY QUEUES ////////////////////////////////////////////////////////////////
+
+/**
+ * The ready queue and worker index the current posix thread is bound to.
+ */
+static __thread PICC_ReadyQueue *bound_queue = NULL;
+static __thread int bound_worker = -1;
+
+/**
+ * Returns the deque of the worker bound to the current posix thread, or NULL
+ * if the current thread is not a worker of the given ready queue.
+ *
+ * @param rq Ready queue
+ * @return Deque of the current worker
+ */
+static PICC_WorkDeque *current_deque(PICC_ReadyQueue *rq)
+{
+    if (bound_queue != rq || bound_worker < 0 || bound_worker >= rq->nb_workers)
+        return NULL;
+    return &rq->deques[bound_worker];
+}
+
+/**
+ * Initializes an empty inbox.
+ */
+static void inbox_init(PICC_ReadyInbox *inbox)
+{
+    atomic_init(&inbox->top, NULL);
+    atomic_init(&inbox->size, 0);
+}
 
 /**
- * Allocates a new queue cell.
+ * Pushes a chain of PiThreads linked by ready_next on the given inbox. The
+ * first PiThread of the chain becomes the top of the inbox.
  *
- * @return Allocated queue cell
+ * @param inbox Inbox
+ * @param first First PiThread of the chain
+ * @param last Last PiThread of the chain
+ * @param n Length of the chain
  */
-PICC_QueueCell *PICC_create_queue_cell(PICC_Error *error)
+static void inbox_push_chain(PICC_ReadyInbox *inbox, PICC_PiThread *first,
+                             PICC_PiThread *last, int n)
 {
-    PICC_QueueCell *cell = malloc(sizeof(PICC_QueueCell));
-    if (cell == NULL) {
+    // the size is published first so that it never underflows when the
+    // chain is grabbed right after the CAS
+    atomic_fetch_add_explicit(&inbox->size, n, memory_order_relaxed);
+
+    PICC_PiThread *top = atomic_load_explicit(&inbox->top, memory_order_relaxed);
+    do {
+        last->ready_next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&inbox->top, &top, first,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/**
+ * Grabs the whole content of the given inbox.
+ *
+ * @param inbox Inbox
+ * @return The grabbed chain, youngest PiThread first
+ */
+static PICC_PiThread *inbox_grab(PICC_ReadyInbox *inbox)
+{
+    if (atomic_load_explicit(&inbox->top, memory_order_relaxed) == NULL)
+        return NULL;
+
+    PICC_PiThread *chain = atomic_exchange_explicit(&inbox->top, NULL,
+                                                    memory_order_acquire);
+    int n = 0;
+    PICC_PiThread *pt;
+    for (pt = chain; pt != NULL; pt = pt->ready_next)
+        n++;
+    atomic_fetch_sub_explicit(&inbox->size, n, memory_order_relaxed);
+
+    return chain;
+}
+
+/**
+ * Allocates a deque array of the given capacity.
+ *
+ * @param capacity Capacity of the array (a power of two)
+ * @param error Error stack
+ */
+static PICC_DequeArray *deque_array_create(long capacity, PICC_Error *error)
+{
+    PICC_DequeArray *array = malloc(sizeof(PICC_DequeArray)
+                                    + capacity * sizeof(_Atomic(PICC_PiThread *)));
+    if (array == NULL) {
         NEW_ERROR(error, ERR_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    array->capacity = capacity;
+    array->prev = NULL;
+    return array;
+}
+
+/**
+ * Initializes an empty work deque.
+ */
+static void deque_init(PICC_WorkDeque *deque, PICC_Error *error)
+{
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, deque_array_create(PICC_DEQUE_INIT_CAPACITY, error));
+    inbox_init(&deque->inbox);
+    atomic_init(&deque->runnext, NULL);
+    deque->handoffs = 0;
+}
+
+/**
+ * Doubles the capacity of a full deque array. Only called by the owner.
+ */
+static PICC_DequeArray *deque_grow(PICC_WorkDeque *deque, PICC_DequeArray *array,
+                                   long top, long bottom, PICC_Error *error)
+{
+    PICC_DequeArray *bigger = deque_array_create(array->capacity * 2, error);
+    if (bigger == NULL)
+        return NULL;
+
+    long i;
+    for (i = top; i < bottom; i++) {
+        PICC_PiThread *pt = atomic_load_explicit(&array->slots[i & (array->capacity - 1)],
+                                                 memory_order_relaxed);
+        atomic_store_explicit(&bigger->slots[i & (bigger->capacity - 1)], pt,
+                              memory_order_relaxed);
+    }
+    bigger->prev = array;
+    atomic_store_explicit(&deque->array, bigger, memory_order_release);
+
+    return bigger;
+}
+
+/**
+ * Pushes a PiThread at the bottom of a work deque. Only called by the owner.
+ */
+static void deque_push(PICC_WorkDeque *deque, PICC_PiThread *pt, PICC_Error *error)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    PICC_DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (bottom - top > array->capacity - 1) {
+        array = deque_grow(deque, array, top, bottom, error);
+        if (array == NULL)
+            return;
+    }
+
+    atomic_store_explicit(&array->slots[bottom & (array->capacity - 1)], pt,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+/**
+ * Pops the PiThread at the bottom of a work deque. Only called by the owner.
+ *
+ * @return The popped PiThread, NULL if the deque is empty
+ */
+static PICC_PiThread *deque_pop(PICC_WorkDeque *deque)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    PICC_DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    PICC_PiThread *pt = NULL;
+    if (top <= bottom) {
+        pt = atomic_load_explicit(&array->slots[bottom & (array->capacity - 1)],
+                                  memory_order_relaxed);
+        if (top == bottom) {
+            // last PiThread: race against the thieves
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                         memory_order_seq_cst,
+                                                         memory_order_relaxed))
+                pt = NULL;
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
     } else {
-        cell->thread = NULL;
-        cell->next = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
     }
 
-    #ifdef CONTRACT_POST_INV
-        // inv@post
-        PICC_QueueCell_inv(cell);
-    #endif
+    return pt;
+}
 
-    return cell;
+/**
+ * Steals the PiThread at the top of a work deque.
+ *
+ * @return The stolen PiThread, NULL if the deque is empty or if another
+ * worker won the race
+ */
+static PICC_PiThread *deque_steal(PICC_WorkDeque *deque)
+{
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return NULL;
+
+    PICC_DequeArray *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    PICC_PiThread *pt = atomic_load_explicit(&array->slots[top & (array->capacity - 1)],
+                                             memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return NULL;
+
+    return pt;
 }
 
-// READY QUEUES ////////////////////////////////////////////////////////////////
+/**
+ * Takes the PiThread of the runnext slot of a work deque, either as its
+ * owner or as a thief.
+ *
+ * @return The PiThread of the slot, NULL if the slot is empty
+ */
+static PICC_PiThread *runnext_take(PICC_WorkDeque *deque)
+{
+    if (atomic_load_explicit(&deque->runnext, memory_order_relaxed) == NULL)
+        return NULL;
+    return atomic_exchange_explicit(&deque->runnext, NULL, memory_order_acquire);
+}
+
+/**
+ * Returns the number of PiThreads in a work deque, inbox excluded.
+ */
+static int deque_size(PICC_WorkDeque *deque)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    int runnext = atomic_load_explicit(&deque->runnext, memory_order_relaxed) != NULL;
+    return (bottom > top ? (int) (bottom - top) : 0) + runnext;
+}
 
 /**
- * Creates a new empty ready queue.
+ * Takes the oldest PiThread of the given inbox. The other grabbed PiThreads
+ * are moved to the deque of the current worker if any, so that they are
+ * popped in arrival order, or given back to the inbox otherwise.
+ *
+ * @param rq Ready queue
+ * @param inbox Inbox
+ * @return The oldest PiThread of the inbox, NULL if the inbox is empty
+ */
+static PICC_PiThread *inbox_take(PICC_ReadyQueue *rq, PICC_ReadyInbox *inbox)
+{
+    PICC_PiThread *chain = inbox_grab(inbox);
+    if (chain == NULL)
+        return NULL;
+
+    PICC_WorkDeque *deque = current_deque(rq);
+    PICC_PiThread *pt = chain;
+
+    if (deque != NULL) {
+        ALLOC_ERROR(error);
+        while (pt->ready_next != NULL) {
+            PICC_PiThread *next = pt->ready_next;
+            deque_push(deque, pt, &error);
+            if (HAS_ERROR(error))
+                CRASH(&error);
+            pt = next;
+        }
+    } else if (chain->ready_next != NULL) {
+        int n = 1;
+        PICC_PiThread *last = chain;
+        while (last->ready_next->ready_next != NULL) {
+            last = last->ready_next;
+            n++;
+        }
+        pt = last->ready_next;
+        inbox_push_chain(inbox, chain, last, n);
+    }
+
+    return pt;
+}
+
+/**
+ * Creates a new empty ready queue, without worker deques.
  *
  * @param error Error stack
  */
 PICC_ReadyQueue *PICC_create_ready_queue(PICC_Error *error)
 {
-    PICC_ReadyQueue *queue = malloc(sizeof(PICC_ReadyQueue));
+    return PICC_create_worker_ready_queue(0, error);
+}
+
+/**
+ * Creates a new empty ready queue with one deque per worker.
+ *
+ * @pre nb_workers >= 0
+ * @post queue->nb_workers == nb_workers
+ * @param nb_workers Number of workers
+ * @param error Error stack
+ */
+PICC_ReadyQueue *PICC_create_worker_ready_queue(int nb_workers, PICC_Error *error)
+{
+    #ifdef CONTRACT_PRE
+        // pre: nb_workers >= 0
+        ASSERT(nb_workers >= 0);
+    #endif
+
+    PICC_ReadyQueue *queue = aligned_alloc(PICC_CACHE_LINE_SIZE, sizeof(PICC_ReadyQueue));
     if (queue == NULL) {
         NEW_ERROR(error, ERR_OUT_OF_MEMORY);
-    } else {
-        queue->q.head = NULL;
-        queue->q.tail = NULL;
-        queue->q.size = 0;
-
-	queue->lock = PICC_create_lock(error);
+        return NULL;
+    }
 
+    inbox_init(&queue->shared);
+    inbox_init(&queue->urgent);
+    queue->policy = PICC_READY_MIXED;
+    queue->deques = NULL;
+    queue->nb_workers = 0;
+    queue->nodes = NULL;
+    queue->nb_nodes = 1;
+    atomic_init(&queue->in_flight, 0);
+    PICC_init_eventcount(&queue->idle);
+    queue->seed = 0;
+
+    if (nb_workers > 0) {
+        queue->deques = aligned_alloc(PICC_CACHE_LINE_SIZE,
+                                      sizeof(PICC_WorkDeque) * nb_workers);
+        queue->nodes = calloc(nb_workers, sizeof(int));
+        if (queue->deques == NULL || queue->nodes == NULL) {
+            NEW_ERROR(error, ERR_OUT_OF_MEMORY);
+        } else {
+            int i;
+            for (i = 0; i < nb_workers; i++)
+                deque_init(&queue->deques[i], error);
+            queue->nb_workers = nb_workers;
+        }
     }
 
     #ifdef CONTRACT_POST_INV
@@ -78,13 +363,126 @@ PICC_ReadyQueue *PICC_create_ready_queue(PICC_Error *error)
 }
 
 /**
- * Pushes a PiThread on the given ready queue.
+ * Binds the current posix thread to the given worker deque of the ready
+ * queue. Subsequent pushes, adds and pops from this thread use that deque.
+ *
+ * @pre rq != null
+ * @pre worker >= 0 && worker < rq.nb_workers
+ * @param rq Ready queue
+ * @param worker Index of the worker
+ */
+void PICC_ready_queue_bind_worker(PICC_ReadyQueue *rq, int worker)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(worker >= 0 && worker < rq->nb_workers);
+    #endif
+
+    bound_queue = rq;
+    bound_worker = worker;
+}
+
+/**
+ * Pushes a PiThread so that it runs next: at the bottom of the deque of
+ * the current worker, or in the shared inbox if the current thread is not
+ * a worker. An idle worker is woken up to run or steal it.
+ */
+static void ready_push_next(PICC_ReadyQueue *rq, PICC_PiThread *pt)
+{
+    PICC_WorkDeque *deque = current_deque(rq);
+    atomic_fetch_add_explicit(&rq->in_flight, 1, memory_order_relaxed);
+
+    if (deque == NULL) {
+        inbox_push_chain(&rq->shared, pt, pt, 1);
+        PICC_eventcount_notify(&rq->idle);
+        return;
+    }
+
+    #ifdef CONTRACT_PRE_INV
+        // inv@pre
+        PICC_WorkDeque_inv(deque);
+    #endif
+
+    ALLOC_ERROR(error);
+    ALLOC_ERROR(push_error);
+    deque_push(deque, pt, &push_error);
+
+    if (HAS_ERROR(push_error))
+        ADD_ERROR(&error, push_error, ERR_READY_QUEUE_PUSH);
+
+    if (HAS_ERROR(error))
+        CRASH(&error);
+
+    PICC_eventcount_notify(&rq->idle);
+
+    #ifdef CONTRACT_POST_INV
+        // inv@post
+        PICC_WorkDeque_inv(deque);
+    #endif
+}
+
+/**
+ * Pushes a PiThread at the end: in the inbox of the current worker, which
+ * it only pops once its deque is empty, or in the shared inbox if the
+ * current thread is not a worker. An idle worker is woken up to run or
+ * steal it.
+ */
+static void ready_push_last(PICC_ReadyQueue *rq, PICC_PiThread *pt)
+{
+    PICC_WorkDeque *deque = current_deque(rq);
+    PICC_ReadyInbox *inbox = deque ? &deque->inbox : &rq->shared;
+
+    atomic_fetch_add_explicit(&rq->in_flight, 1, memory_order_relaxed);
+    inbox_push_chain(inbox, pt, pt, 1);
+    PICC_eventcount_notify(&rq->idle);
+}
+
+/**
+ * Pushes a PiThread of the ready queue given the policy of the queue, as
+ * asked by the call site (next) under PICC_READY_MIXED.
+ *
+ * @param rq Ready queue
+ * @param pt PiThread
+ * @param next Whether the call site asks the PiThread to run next
+ */
+static void ready_enqueue(PICC_ReadyQueue *rq, PICC_PiThread *pt, bool next)
+{
+    switch (rq->policy) {
+    case PICC_READY_LIFO:
+        next = true;
+        break;
+    case PICC_READY_FIFO:
+        next = false;
+        break;
+    case PICC_READY_PRIORITY:
+        if (pt->priority == PICC_PRIORITY_HIGH) {
+            atomic_fetch_add_explicit(&rq->in_flight, 1, memory_order_relaxed);
+            inbox_push_chain(&rq->urgent, pt, pt, 1);
+            PICC_eventcount_notify(&rq->idle);
+            return;
+        }
+        if (pt->priority == PICC_PRIORITY_LOW)
+            next = false;
+        break;
+    default:
+        break;
+    }
+
+    if (next)
+        ready_push_next(rq, pt);
+    else
+        ready_push_last(rq, pt);
+}
+
+/**
+ * Pushes a PiThread on the given ready queue, so that it runs next under
+ * the default policy: if the current thread is a worker, the PiThread is
+ * pushed at the bottom of its own deque and will be the next one it pops.
+ * Otherwise it goes to the shared inbox. An idle worker is woken up to
+ * run or steal it. See PICC_ReadyPolicy for the other policies.
  *
  * @pre rq != null and pt != null
- * @pre pt not in rq
  * @post pt in rq
- * @post rq.size == rq.size@pre + 1
- * @post rq.head.thread == pt
  * @param rq Ready queue
  * @param pt PiThread
  */
@@ -93,197 +491,432 @@ void PICC_ready_queue_push(PICC_ReadyQueue *rq, PICC_PiThread *pt)
     #ifdef CONTRACT_PRE
         // pre: rq != null
         ASSERT(rq != NULL);
+        // pre: pt != null
+        ASSERT(pt != NULL);
     #endif
 
-    LOCK_QUEUE(rq);
-
     #ifdef CONTRACT_PRE_INV
         // inv@pre
-        PICC_ReadyQueue_inv(rq);
         PICC_PiThread_inv(pt);
     #endif
 
+    ready_enqueue(rq, pt, true);
+}
+
+/**
+ * Adds a PiThread at the end of the given ready queue under the default
+ * policy: if the current thread is a worker, the PiThread goes to its
+ * inbox, which it only pops once its deque is empty. Otherwise it goes to
+ * the shared inbox. An idle worker is woken up to run or steal it. See
+ * PICC_ReadyPolicy for the other policies.
+ *
+ * @pre rq != null && pt != null
+ * @post pt in rq
+ * @param rq Ready queue
+ * @param pt PiThread
+ */
+void PICC_ready_queue_add(PICC_ReadyQueue *rq, PICC_PiThread *pt)
+{
     #ifdef CONTRACT_PRE
+        // pre: rq != null
+        ASSERT(rq != NULL);
         // pre: pt != null
         ASSERT(pt != NULL);
-
-        // pre: pt not in rq
-        bool found = false;
-        PICC_QueueCell *c = rq->q.head;
-        while (c != NULL) {
-            if (c->thread == pt) {
-                found = true;
-                break;
-            }
-            c = c->next;
-        }
-        ASSERT(found == false);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int size_at_pre = rq->q.size;
+    #ifdef CONTRACT_PRE_INV
+        // inv@pre
+        PICC_PiThread_inv(pt);
     #endif
 
-    ALLOC_ERROR(error);
-    // create queue cell
-    ALLOC_ERROR(cell_error);
-    PICC_QueueCell *cell = PICC_create_queue_cell(&cell_error);
-
-    if (HAS_ERROR(cell_error)) {
-        ADD_ERROR(&error, cell_error, ERR_READY_QUEUE_PUSH);
-    } else {
-        cell->thread = pt;
-        if (rq->q.size == 0) {
-            rq->q.head = cell;
-            rq->q.tail = cell;
-            cell->next = NULL;
-        } else {
-            cell->next = rq->q.head;
-            rq->q.head = cell;
-        }
+    ready_enqueue(rq, pt, false);
+}
 
-        rq->q.size++;
-    }
+/**
+ * Links the given PiThreads into a chain for an inbox, pts[0] last so that
+ * it is the oldest one.
+ *
+ * @return The first PiThread of the chain, pts[n - 1]
+ */
+static PICC_PiThread *ready_chain(PICC_PiThread **pts, int n)
+{
+    int i;
+    for (i = n - 1; i > 0; i--)
+        pts[i]->ready_next = pts[i - 1];
+    return pts[n - 1];
+}
 
-    if (HAS_ERROR(error))
-        CRASH(&error);
+/**
+ * Tells whether a batch may be chained in an inbox under the policy of
+ * the ready queue, or must be pushed one PiThread at a time.
+ */
+static bool ready_chainable(PICC_ReadyQueue *rq)
+{
+    return rq->policy == PICC_READY_MIXED || rq->policy == PICC_READY_FIFO;
+}
 
-    #ifdef CONTRACT_POST_INV
-        // inv@post
-        PICC_ReadyQueue_inv(rq);
-        PICC_PiThread_inv(pt);
+/**
+ * Adds a batch of PiThreads at the end of the given ready queue, in order,
+ * as PICC_ready_queue_add would one after the other: the whole batch is
+ * chained in the inbox of the current worker (or in the shared inbox) in
+ * a single operation, and idle workers are woken up to steal from it.
+ * Under PICC_READY_LIFO and PICC_READY_PRIORITY, the PiThreads are pushed
+ * one at a time.
+ *
+ * @pre rq != null && pts != null && n >= 0
+ * @post pts[0..n) in rq
+ * @param rq Ready queue
+ * @param pts PiThreads
+ * @param n Number of PiThreads
+ */
+void PICC_ready_queue_add_batch(PICC_ReadyQueue *rq, PICC_PiThread **pts, int n)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(pts != NULL);
+        ASSERT(n >= 0);
     #endif
 
-    #ifdef CONTRACT_POST
-        // post: pt in rq
-        found = false;
-        c = rq->q.head;
-        while (c != NULL) {
-            if (c->thread == pt) {
-                found = true;
-                break;
-            }
-            c = c->next;
-        }
-        ASSERT(found == true);
-        // post: rq.size == rq.size@pre + 1
-        ASSERT(rq->q.size == size_at_pre + 1)
-        // post: rq.head.thread == pt
-        ASSERT(rq->q.head->thread == pt);
+    PICC_ready_queue_scatter(rq, pts, n, 1);
+}
+
+/**
+ * Spreads a batch of PiThreads over the inboxes of nb_workers workers,
+ * starting with the current one (or the worker 0 if the current thread is
+ * not a worker): each worker gets a contiguous chunk of the batch, chained
+ * in a single operation. Idle workers are woken up. Under PICC_READY_LIFO
+ * and PICC_READY_PRIORITY, the PiThreads are pushed one at a time on the
+ * current worker.
+ *
+ * @pre rq != null && pts != null && n >= 0
+ * @pre nb_workers >= 1
+ * @post pts[0..n) in rq
+ * @param rq Ready queue
+ * @param pts PiThreads
+ * @param n Number of PiThreads
+ * @param nb_workers Number of workers to spread the batch over
+ */
+void PICC_ready_queue_scatter(PICC_ReadyQueue *rq, PICC_PiThread **pts, int n, int nb_workers)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(pts != NULL);
+        ASSERT(n >= 0);
+        ASSERT(nb_workers >= 1);
     #endif
 
-    RELEASE_QUEUE(rq);
+    int i;
+
+    if (n == 0)
+        return;
+    if (!ready_chainable(rq)) {
+        for (i = 0; i < n; i++)
+            ready_enqueue(rq, pts[i], false);
+        return;
+    }
+
+    PICC_WorkDeque *deque = current_deque(rq);
+    int self = deque ? bound_worker : 0;
+    if (deque == NULL && rq->nb_workers == 0)
+        nb_workers = 1;
+    else if (nb_workers > rq->nb_workers)
+        nb_workers = rq->nb_workers;
+    if (nb_workers > n)
+        nb_workers = n;
+
+    atomic_fetch_add_explicit(&rq->in_flight, n, memory_order_relaxed);
+
+    int start = 0;
+    for (i = 0; i < nb_workers; i++) {
+        int end = (int) ((long) n * (i + 1) / nb_workers);
+        PICC_ReadyInbox *inbox;
+        if (i == 0 && deque == NULL)
+            inbox = &rq->shared;
+        else
+            inbox = &rq->deques[(self + i) % rq->nb_workers].inbox;
+        inbox_push_chain(inbox, ready_chain(pts + start, end - start), pts[start],
+                         end - start);
+        start = end;
+    }
+
+    if (n == 1)
+        PICC_eventcount_notify(&rq->idle);
+    else
+        PICC_eventcount_notify_all(&rq->idle);
 }
 
 /**
- * Adds a PiThread at the end of the given ready queue.
+ * Adds a preempted PiThread at the end of the given ready queue, whatever
+ * the policy and its priority, so that the other ready PiThreads run
+ * before it: a high priority PiThread computing forever does not starve
+ * them.
  *
  * @pre rq != null && pt != null
- * @pre pt not in rq
  * @post pt in rq
- * @post rq.size == rq.size@pre + 1
- * @post rq.tail.thread == pt
  * @param rq Ready queue
  * @param pt PiThread
  */
-void PICC_ready_queue_add(PICC_ReadyQueue *rq, PICC_PiThread *pt)
+void PICC_ready_queue_yield(PICC_ReadyQueue *rq, PICC_PiThread *pt)
 {
     #ifdef CONTRACT_PRE
-        // pre: rq != null
         ASSERT(rq != NULL);
+        ASSERT(pt != NULL);
     #endif
 
-    LOCK_QUEUE(rq);
+    ready_push_last(rq, pt);
+}
 
+/**
+ * Sets the policy of the given ready queue, before any PiThread is pushed.
+ *
+ * @pre rq != null
+ * @param rq Ready queue
+ * @param policy Policy
+ */
+void PICC_ready_queue_set_policy(PICC_ReadyQueue *rq, PICC_ReadyPolicy policy)
+{
     #ifdef CONTRACT_PRE
-        // pre: pt != null
-        ASSERT(pt != NULL);
-
-        // pre: pt not in rq
-        bool found = false;
-        PICC_QueueCell *c = rq->q.head;
-        while (c != NULL) {
-            if (c->thread == pt) {
-                found = true;
-                break;
-            }
-            c = c->next;
-        }
-        ASSERT(found == false);
+        ASSERT(rq != NULL);
     #endif
 
-    #ifdef CONTRACT_PRE_INV
-        // inv@pre
-        PICC_ReadyQueue_inv(rq);
-        PICC_PiThread_inv(pt);
+    rq->policy = policy;
+}
+
+/**
+ * Sets the NUMA node of the given worker, whose idle workers steal from
+ * first.
+ *
+ * @pre rq != null
+ * @pre worker >= 0 && worker < rq.nb_workers
+ * @pre node >= 0
+ * @param rq Ready queue
+ * @param worker Index of the worker
+ * @param node Node of the worker
+ */
+void PICC_ready_queue_set_node(PICC_ReadyQueue *rq, int worker, int node)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(worker >= 0 && worker < rq->nb_workers);
+        ASSERT(node >= 0);
     #endif
 
-    #ifdef CONTRACT_POST
-        // captures
-        int size_at_pre = rq->q.size;
+    rq->nodes[worker] = node;
+    if (node >= rq->nb_nodes)
+        rq->nb_nodes = node + 1;
+}
+
+/**
+ * Seeds the pops of the given ready queue, which must then only be used by
+ * a single thread bound to the worker 0. With a non-zero seed, each pop
+ * takes a PiThread drawn at random among the ready ones, the same ones
+ * for the same seed and the same pushes. A zero seed restores the
+ * canonical order (see PICC_ready_queue_pop).
+ *
+ * @pre rq != null
+ * @pre rq.nb_workers == 1
+ * @param rq Ready queue
+ * @param seed Seed of the pops
+ */
+void PICC_ready_queue_set_seed(PICC_ReadyQueue *rq, unsigned long seed)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(rq->nb_workers == 1);
     #endif
 
+    rq->seed = seed;
+}
+
+/**
+ * Pops a PiThread drawn at random from the deque of a seeded ready queue.
+ * The runnext slot and the inboxes are moved into the deque first, the
+ * drawn PiThread is swapped with the bottom one and popped: the policy of
+ * the queue is ignored.
+ *
+ * @param rq Seeded ready queue
+ * @param deque Deque of the current worker, the only one
+ * @return Popped PiThread, NULL if the ready queue is empty
+ */
+static PICC_PiThread *seeded_pop(PICC_ReadyQueue *rq, PICC_WorkDeque *deque)
+{
     ALLOC_ERROR(error);
+    PICC_PiThread *pt;
+
+    if ((pt = runnext_take(deque)) != NULL)
+        deque_push(deque, pt, &error);
+    while (!(HAS_ERROR(error)) && (pt = inbox_take(rq, &deque->inbox)) != NULL)
+        deque_push(deque, pt, &error);
+    while (!(HAS_ERROR(error)) && (pt = inbox_take(rq, &rq->shared)) != NULL)
+        deque_push(deque, pt, &error);
+    while (!(HAS_ERROR(error)) && (pt = inbox_take(rq, &rq->urgent)) != NULL)
+        deque_push(deque, pt, &error);
+    if (HAS_ERROR(error))
+        CRASH(&error);
 
-    // create queue cell
-    ALLOC_ERROR(cell_error);
-    PICC_QueueCell *cell = PICC_create_queue_cell(&cell_error);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    if (top >= bottom)
+        return NULL;
+
+    // xorshift64
+    rq->seed ^= rq->seed << 13;
+    rq->seed ^= rq->seed >> 7;
+    rq->seed ^= rq->seed << 17;
+
+    PICC_DequeArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    long mask = array->capacity - 1;
+    long drawn = top + (long) (rq->seed % (unsigned long) (bottom - top));
+    pt = atomic_load_explicit(&array->slots[drawn & mask], memory_order_relaxed);
+    atomic_store_explicit(&array->slots[drawn & mask],
+                          atomic_load_explicit(&array->slots[(bottom - 1) & mask],
+                                               memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom - 1, memory_order_relaxed);
+    return pt;
+}
 
-    if (HAS_ERROR(cell_error)) {
-        ADD_ERROR(&error, cell_error, ERR_READY_QUEUE_ADD);
-    } else {
-        cell->thread = pt;
-        if (rq->q.size == 0) {
-            rq->q.head = cell;
-            rq->q.tail = cell;
-            cell->next = NULL;
-        } else {
-            rq->q.tail->next = cell;
-            rq->q.tail = cell;
-            cell->next = NULL;
-        }
+/**
+ * Hands a PiThread off to the current worker, typically the partner of a
+ * rendezvous of the running PiThread: it runs on the same worker as soon
+ * as the running PiThread stops. It goes to the runnext slot of the worker
+ * if the slot is free, and is added to the ready queue otherwise (or if
+ * the current thread is not a worker). No idle worker is woken up, it may
+ * only steal the slot once nothing else is left. Under PICC_READY_FIFO,
+ * and for the PiThreads of a priority class under PICC_READY_PRIORITY, the
+ * PiThread is added as by PICC_ready_queue_add instead.
+ *
+ * @pre rq != null && pt != null
+ * @post pt in rq
+ * @param rq Ready queue
+ * @param pt PiThread
+ */
+void PICC_ready_queue_handoff(PICC_ReadyQueue *rq, PICC_PiThread *pt)
+{
+    #ifdef CONTRACT_PRE
+        // pre: rq != null
+        ASSERT(rq != NULL);
+        // pre: pt != null
+        ASSERT(pt != NULL);
+    #endif
+
+    PICC_WorkDeque *deque = current_deque(rq);
 
-        rq->q.size++;
+    if (rq->policy == PICC_READY_FIFO
+        || (rq->policy == PICC_READY_PRIORITY && pt->priority != PICC_PRIORITY_NORMAL)) {
+        ready_enqueue(rq, pt, false);
+        return;
     }
 
-    if (HAS_ERROR(error))
-        CRASH(&error);
+    // only the owner fills the slot, a thief may only empty it
+    if (deque == NULL || atomic_load_explicit(&deque->runnext, memory_order_relaxed) != NULL) {
+        PICC_ready_queue_add(rq, pt);
+        return;
+    }
 
-    #ifdef CONTRACT_POST_INV
-        // inv@post
-        PICC_ReadyQueue_inv(rq);
+    #ifdef CONTRACT_PRE_INV
+        // inv@pre
         PICC_PiThread_inv(pt);
     #endif
 
-    #ifdef CONTRACT_POST
-        // post: pt in rq
-        found = false;
-        c = rq->q.head;
-        while (c != NULL) {
-            if (c->thread == pt) {
-                found = true;
-                break;
-            }
-            c = c->next;
-        }
-        ASSERT(found == true);
-        // post: rq.size == rq.size@pre + 1
-        ASSERT(rq->q.size == size_at_pre + 1)
-        // post: rq.tail.thread == pt
-        ASSERT(rq->q.tail->thread == pt);
+    atomic_fetch_add_explicit(&rq->in_flight, 1, memory_order_relaxed);
+    atomic_store_explicit(&deque->runnext, pt, memory_order_release);
+}
+
+/**
+ * Steals a PiThread from the given worker: the top of its deque, or else the
+ * oldest PiThread of its inbox, or else its runnext PiThread.
+ *
+ * @pre rq != null
+ * @pre victim >= 0 && victim < rq.nb_workers
+ * @post if (victim.size@pre == 0) then NULL
+ * @param rq Ready queue
+ * @param victim Index of the worker to steal from
+ * @return Stolen PiThread
+ */
+PICC_PiThread *PICC_ready_queue_steal(PICC_ReadyQueue *rq, int victim)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(victim >= 0 && victim < rq->nb_workers);
     #endif
 
-    RELEASE_QUEUE(rq);
+    PICC_WorkDeque *deque = &rq->deques[victim];
+
+    PICC_PiThread *stolen = deque_steal(deque);
+    if (stolen == NULL)
+        stolen = inbox_take(rq, &deque->inbox);
+    if (stolen == NULL)
+        stolen = runnext_take(deque);
+
+    return stolen;
+}
+
+/**
+ * Moves up to half of the deque of a victim, PICC_READY_STEAL_BATCH - 1
+ * PiThreads at most, to the deque of the stealing worker, so that it does
+ * not come back to steal after each PiThread.
+ *
+ * @param victim Deque stolen from
+ * @param own Deque of the stealing worker
+ */
+static void steal_batch(PICC_WorkDeque *victim, PICC_WorkDeque *own)
+{
+    ALLOC_ERROR(error);
+    PICC_PiThread *pt;
+    int n = deque_size(victim) / 2;
+
+    if (n > PICC_READY_STEAL_BATCH - 1)
+        n = PICC_READY_STEAL_BATCH - 1;
+    while (n-- > 0 && (pt = deque_steal(victim)) != NULL) {
+        deque_push(own, pt, &error);
+        if (HAS_ERROR(error))
+            CRASH(&error);
+    }
+}
+
+/**
+ * Tries to steal a PiThread from the workers of the node of self, or from
+ * the workers of the other nodes, starting after self. A worker takes a
+ * batch of the victim's deque along.
+ *
+ * @param rq Ready queue
+ * @param self Index of the stealing worker (0 if the thread is not a worker)
+ * @param worker Whether the thread is a worker, which does not steal from itself
+ * @param local Whether to steal from the node of self or from the others
+ * @return Stolen PiThread, NULL if none
+ */
+static PICC_PiThread *steal_node(PICC_ReadyQueue *rq, int self, bool worker, bool local)
+{
+    PICC_PiThread *stolen = NULL;
+    int node = rq->nodes[self];
+    int i;
+    for (i = 1; i <= rq->nb_workers && stolen == NULL; i++) {
+        int victim = (self + i) % rq->nb_workers;
+        if ((victim != self || !worker) && (rq->nodes[victim] == node) == local) {
+            stolen = PICC_ready_queue_steal(rq, victim);
+            if (stolen != NULL && worker)
+                steal_batch(&rq->deques[victim], &rq->deques[self]);
+        }
+    }
+    return stolen;
 }
 
 /**
  * Pops a PiThread from the given ready queue.
  *
+ * A worker first pops its runnext slot, then the bottom of its own deque,
+ * then its inbox, then the shared inbox, and finally tries to steal from
+ * the other workers, those of its NUMA node first, taking up to half of
+ * the victim's deque along (see PICC_READY_STEAL_BATCH). After
+ * PICC_RUNNEXT_MAX_HANDOFFS pops in a row from the slot, the slot is
+ * spilled to the inbox instead. A thread which is not a worker pops the
+ * shared inbox and then steals. Under PICC_READY_PRIORITY, the urgent inbox
+ * is popped before anything else. The worker of a seeded ready queue pops
+ * a PiThread drawn at random instead.
+ *
  * @pre rq != null
  * @post if (rq@pre.size == 0) then NULL
- * @post if (rq@pre.size > 0) then rq@pre.head.thread
- * @post if (rq@pre.size > 0) then rq.size == rq@pre.size - 1
  * @param rq Ready queue
  * @return Popped PiThread
  */
@@ -294,63 +927,90 @@ PICC_PiThread *PICC_ready_queue_pop(PICC_ReadyQueue *rq)
         ASSERT(rq != NULL);
     #endif
 
-    LOCK_QUEUE(rq);
+    PICC_PiThread *popped_thread = NULL;
+    PICC_WorkDeque *deque = current_deque(rq);
 
-    #ifdef CONTRACT_PRE_INV
-        // inv@pre
-        PICC_ReadyQueue_inv(rq);
-    #endif
+    if (deque != NULL && rq->seed != 0)
+        return seeded_pop(rq, deque);
 
-    #ifdef CONTRACT_POST
-        // captures
-        int size_at_pre = rq->q.size;
-        PICC_PiThread *head_at_pre = NULL;
-        if (rq->q.head != NULL)
-            head_at_pre = rq->q.head->thread;
-    #endif
+    // the rest of the urgent inbox goes to the bottom of the deque, next
+    if (rq->policy == PICC_READY_PRIORITY
+        && (popped_thread = inbox_take(rq, &rq->urgent)) != NULL)
+        return popped_thread;
 
-    PICC_PiThread *popped_thread = NULL;
-    
-    if (rq->q.size > 0) {
+    if (deque != NULL) {
+        #ifdef CONTRACT_PRE_INV
+            // inv@pre
+            PICC_WorkDeque_inv(deque);
+        #endif
 
-        PICC_QueueCell *popped_cell = rq->q.head;
-        popped_thread = popped_cell->thread;
-        
-        rq->q.head = popped_cell->next;
-        free(popped_cell);
-        rq->q.size--;
+        if (deque->handoffs < PICC_RUNNEXT_MAX_HANDOFFS) {
+            popped_thread = runnext_take(deque);
+        } else {
+            PICC_PiThread *spilled = runnext_take(deque);
+            if (spilled != NULL)
+                inbox_push_chain(&deque->inbox, spilled, spilled, 1);
+        }
 
-        if (rq->q.size == 0)
-            rq->q.tail = NULL;
+        if (popped_thread != NULL) {
+            deque->handoffs++;
+        } else {
+            deque->handoffs = 0;
+            popped_thread = deque_pop(deque);
+            if (popped_thread == NULL)
+                popped_thread = inbox_take(rq, &deque->inbox);
+        }
+
+        #ifdef CONTRACT_POST_INV
+            // inv@post
+            PICC_WorkDeque_inv(deque);
+        #endif
     }
 
-    #ifdef CONTRACT_POST_INV
-        // inv@post
-        PICC_ReadyQueue_inv(rq);
-    #endif
+    if (popped_thread == NULL)
+        popped_thread = inbox_take(rq, &rq->shared);
 
-    #ifdef CONTRACT_POST
-        // post: if (rq@pre.size == 0) then NULL
-        if (size_at_pre == 0) {
-            ASSERT(popped_thread == NULL);
-        } else if (size_at_pre > 0) {
-            // post: if (rq@pre.size > 0) then rq@pre.head.thread
-            ASSERT(popped_thread == head_at_pre);
-            ASSERT(popped_thread != NULL);
-            // post if (rq@pre.size > 0) then rq.size == rq@pre.size - 1
-            ASSERT(rq->q.size == size_at_pre - 1);
-        }
-    #endif
+    if (popped_thread == NULL && rq->nb_workers > 0) {
+        int self = deque ? bound_worker : 0;
+        popped_thread = steal_node(rq, self, deque != NULL, true);
+        if (popped_thread == NULL && rq->nb_nodes > 1)
+            popped_thread = steal_node(rq, self, deque != NULL, false);
+    }
 
-    RELEASE_QUEUE(rq);
     return popped_thread;
 }
 
 /**
- * Returns the size of the given ready queue.
+ * Pops up to k PiThreads from the given ready queue into the given buffer,
+ * in the order PICC_ready_queue_pop pops them. They are in flight until
+ * each one is done.
+ *
+ * @pre rq != null && buf != null && k >= 0
+ * @param rq Ready queue
+ * @param buf Buffer of at least k PiThreads
+ * @param k Maximum number of PiThreads to pop
+ * @return Number of PiThreads popped, less than k once the queue is empty
+ */
+int PICC_ready_queue_pop_batch(PICC_ReadyQueue *rq, PICC_PiThread **buf, int k)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(buf != NULL);
+        ASSERT(k >= 0);
+    #endif
+
+    int n = 0;
+    while (n < k && (buf[n] = PICC_ready_queue_pop(rq)) != NULL)
+        n++;
+    return n;
+}
+
+/**
+ * Returns the size of the given ready queue, that is the number of PiThreads
+ * in the shared and urgent inboxes and in all the worker deques and inboxes.
+ * The result is only a snapshot when the queue is used concurrently.
  *
  * @pre rq != null
- * @post size == SUM(rq.head => rq.tail)
  * @return Size of the ready queue
  */
 int PICC_ready_queue_size(PICC_ReadyQueue *rq)
@@ -360,37 +1020,91 @@ int PICC_ready_queue_size(PICC_ReadyQueue *rq)
         ASSERT(rq != NULL);
     #endif
 
-    LOCK_QUEUE(rq);
-
     #ifdef CONTRACT_PRE_INV
         // inv@pre
         PICC_ReadyQueue_inv(rq);
     #endif
 
-    int size = rq->q.size;
+    int size = atomic_load_explicit(&rq->shared.size, memory_order_relaxed)
+        + atomic_load_explicit(&rq->urgent.size, memory_order_relaxed);
 
-    #ifdef CONTRACT_POST_INV
-        // inv@post
-        PICC_ReadyQueue_inv(rq);
+    int i;
+    for (i = 0; i < rq->nb_workers; i++) {
+        size += deque_size(&rq->deques[i]);
+        size += atomic_load_explicit(&rq->deques[i].inbox.size, memory_order_relaxed);
+    }
+
+    return size;
+}
+
+/**
+ * Tells the ready queue that a popped PiThread has stopped running, on its
+ * own or by waiting. Since a PiThread only becomes ready through a running
+ * one, the runtime is quiescent when the last PiThread in flight is done.
+ *
+ * @pre rq != null
+ * @pre rq.in_flight > 0
+ * @param rq Ready queue
+ * @return true if no PiThread is left ready nor running
+ */
+bool PICC_ready_queue_done(PICC_ReadyQueue *rq)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
+        ASSERT(atomic_load(&rq->in_flight) > 0);
     #endif
 
-    #ifdef CONTRACT_POST
-        // post: size == SUM(rq.head => rq.tail)
-        int count = 0;
-        PICC_QueueCell *cell = rq->q.head;
-        while (cell != NULL) {
-            count++;
-            cell = cell->next;
-        }
-        ASSERT(size == count);
+    return atomic_fetch_sub_explicit(&rq->in_flight, 1, memory_order_acq_rel) == 1;
+}
+
+/**
+ * Returns the number of PiThreads in flight: pushed or added and not done
+ * yet. The result is only a snapshot when the queue is used concurrently.
+ *
+ * @pre rq != null
+ * @param rq Ready queue
+ * @return Number of PiThreads ready or running
+ */
+int PICC_ready_queue_in_flight(PICC_ReadyQueue *rq)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rq != NULL);
     #endif
 
-    RELEASE_QUEUE(rq);
-    return size;
+    return atomic_load_explicit(&rq->in_flight, memory_order_acquire);
 }
 
 // WAIT QUEUES /////////////////////////////////////////////////////////////////
 
+/**
+ * Unlinks a PiThread from the zone of the wait queue it belongs to, in
+ * constant time. The wait queue must be locked.
+ *
+ * @param wq Wait queue
+ * @param pt PiThread in wq
+ */
+static void wait_queue_unlink(PICC_WaitQueue *wq, PICC_PiThread *pt)
+{
+    PICC_Queue *zone = pt->wait_zone == wq->active_zone ? &wq->active : &wq->old;
+    PICC_PiThread *prev = pt->wait_prev;
+    PICC_PiThread *next = pt->wait_next;
+
+    if (prev != NULL)
+        prev->wait_next = next;
+    if (next != NULL)
+        next->wait_prev = prev;
+
+    if (zone->head == pt)
+        zone->head = zone->size > 1 ? next : NULL;
+    if (zone->tail == pt)
+        zone->tail = zone->size > 1 ? prev : NULL;
+    zone->size--;
+
+    pt->wait_prev = NULL;
+    pt->wait_next = NULL;
+    pt->wait_zone = PICC_WAIT_ZONE_NONE;
+}
+
 /**
  * Creates a new empty wait queue.
  *
@@ -410,6 +1124,7 @@ PICC_WaitQueue *PICC_create_wait_queue(PICC_Error *error)
         queue->old.tail = NULL;
         queue->old.size = 0;
 
+        queue->active_zone = PICC_WAIT_ZONE_FIRST_ACTIVE;
 	queue->lock = PICC_create_lock(error);
     }
 
@@ -422,7 +1137,8 @@ PICC_WaitQueue *PICC_create_wait_queue(PICC_Error *error)
 }
 
 /**
- * Pushes a PiThread on the given wait queue.
+ * Pushes a PiThread on the given wait queue. The worker pushes a PiThread
+ * whose procedure has returned waiting, and the GC the ones it put back.
  *
  * @pre wq != null and pt != null
  * @pre pt not in wq.active
@@ -451,18 +1167,22 @@ void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt)
     #ifdef CONTRACT_PRE
         // pre: pt != null
         ASSERT(pt != NULL);
+        // pre: pt not in wq
+        ASSERT(pt->wait_zone == PICC_WAIT_ZONE_NONE);
+    #endif
 
+    #ifdef CONTRACT_FULL
         // pre: pt not in wq.active
         bool found = false;
-        PICC_QueueCell *c = wq->active.head;
+        PICC_PiThread *c = wq->active.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 found = true;
                 break;
             }
             if (c == wq->active.tail)
                 break;
-            c = c->next;
+            c = c->wait_next;
         }
         ASSERT(found == false);
 
@@ -470,11 +1190,11 @@ void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt)
         found = false;
         c = wq->old.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 found = true;
                 break;
             }
-            c = c->next;
+            c = c->wait_next;
         }
         ASSERT(found == false);
     #endif
@@ -484,30 +1204,17 @@ void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt)
         int size_at_pre = wq->active.size;
     #endif
 
-    ALLOC_ERROR(error);
-
-    // create queue cell
-    ALLOC_ERROR(cell_error);
-    PICC_QueueCell *cell = PICC_create_queue_cell(&cell_error);
+    pt->wait_zone = wq->active_zone;
+    pt->wait_prev = NULL;
+    pt->wait_next = wq->active.size == 0 ? wq->old.head : wq->active.head;
 
-    if (HAS_ERROR(cell_error)) {
-        ADD_ERROR(&error, cell_error, ERR_WAIT_QUEUE_PUSH);
-    } else {
-        cell->thread = pt;
-        if (wq->active.size == 0) {
-            wq->active.head = cell;
-            wq->active.tail = cell;
-            cell->next = wq->old.head;
-        } else {
-            cell->next = wq->active.head;
-            wq->active.head = cell;
-        }
-
-        wq->active.size++;
-    }
+    if (pt->wait_next != NULL)
+        pt->wait_next->wait_prev = pt;
+    if (wq->active.size == 0)
+        wq->active.tail = pt;
 
-    if (HAS_ERROR(error))
-        CRASH(&error);
+    wq->active.head = pt;
+    wq->active.size++;
 
     #ifdef CONTRACT_POST_INV
         // inv@post
@@ -520,20 +1227,20 @@ void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt)
         found = false;
         c = wq->active.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 found = true;
                 break;
             }
-            if (cell == wq->active.tail)
+            if (c == wq->active.tail)
                 break;
-            c = c->next;
+            c = c->wait_next;
         }
         ASSERT(found == true);
 
         // post: wq.active.size == wq.size@pre + 1
         ASSERT(wq->active.size == size_at_pre + 1);
         // post: wq.active.head.thread == pt
-        ASSERT(wq->active.head->thread == pt);
+        ASSERT(wq->active.head == pt);
     #endif
 
     RELEASE_QUEUE(wq);
@@ -541,7 +1248,8 @@ void PICC_wait_queue_push(PICC_WaitQueue *wq, PICC_PiThread *pt)
 
 
 /**
- * Gets a given PiThread from the wait queue.
+ * Gets a given PiThread from the wait queue. The PiThread knows its zone and
+ * its neighbours, so it is unlinked in constant time.
  *
  * @pre wq != null and pt != null
  * @post if (pt in wq@pre) then pt
@@ -568,27 +1276,29 @@ PICC_PiThread *PICC_wait_queue_fetch(PICC_WaitQueue *wq, PICC_PiThread *pt)
     #ifdef CONTRACT_PRE
         // pre: pt != null
         ASSERT(pt != NULL);
+    #endif
 
+    #ifdef CONTRACT_POST
         // captures
         bool pt_in_active_at_pre = false;
-        PICC_QueueCell *c = wq->active.head;
+        PICC_PiThread *c = wq->active.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 pt_in_active_at_pre = true;
                 break;
             }
             if (c == wq->active.tail)
                 break;
-            c = c->next;
+            c = c->wait_next;
         }
         bool pt_in_old_at_pre = false;
         c = wq->old.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 pt_in_old_at_pre = true;
                 break;
             }
-            c = c->next;
+            c = c->wait_next;
         }
         bool pt_in_wq_at_pre = pt_in_active_at_pre || pt_in_old_at_pre;
         int active_size_at_pre = wq->active.size;
@@ -596,54 +1306,10 @@ PICC_PiThread *PICC_wait_queue_fetch(PICC_WaitQueue *wq, PICC_PiThread *pt)
     #endif
 
     PICC_PiThread *result = NULL;
-    int zone = ACTIVE;
-    PICC_QueueCell *current = wq->active.head;
-    PICC_QueueCell *prev = NULL;
 
-    if (current == NULL) {
-        zone = OLD;
-        current = wq->old.head;
-    }
-
-    while (current != NULL) {
-        if (current->thread == pt) {
-            if (prev != NULL)
-                prev->next = current->next;
-
-            if (zone == ACTIVE) {
-                if (current == wq->active.head)
-                    wq->active.head = current->next;
-                if (current == wq->active.tail)
-                    wq->active.tail = prev;
-                wq->active.size--;
-
-                if (wq->active.size == 0) {
-                    wq->active.head = NULL;
-                    wq->active.tail = NULL;
-                }
-
-            } else {
-                if (current == wq->old.head)
-                    wq->old.head = current->next;
-                if (current == wq->old.tail)
-                    wq->old.tail = prev;
-                wq->old.size--;
-
-                if (wq->old.size == 0) {
-                    wq->old.head = NULL;
-                    wq->old.tail = NULL;
-                }
-            }
-
-            result = current->thread;
-            break;
-        }
-
-        prev = current;
-        current = current->next;
-
-        if (zone == ACTIVE && current == wq->old.head)
-            zone = OLD;
+    if (pt->wait_zone != PICC_WAIT_ZONE_NONE) {
+        wait_queue_unlink(wq, pt);
+        result = pt;
     }
 
     #ifdef CONTRACT_POST_INV
@@ -665,13 +1331,13 @@ PICC_PiThread *PICC_wait_queue_fetch(PICC_WaitQueue *wq, PICC_PiThread *pt)
             found = false;
             c = wq->active.head;
             while (c != NULL) {
-                if (c->thread == pt) {
+                if (c == pt) {
                     found = true;
                     break;
                 }
                 if (c == wq->active.tail)
                     break;
-                c = c->next;
+                c = c->wait_next;
             }
             ASSERT(found == false);
             ASSERT(wq->active.size == active_size_at_pre - 1)
@@ -682,11 +1348,11 @@ PICC_PiThread *PICC_wait_queue_fetch(PICC_WaitQueue *wq, PICC_PiThread *pt)
             found = false;
             c = wq->old.head;
             while (c != NULL) {
-                if (c->thread == pt) {
+                if (c == pt) {
                     found = true;
                     break;
                 }
-                c = c->next;
+                c = c->wait_next;
             }
             ASSERT(found == false);
             ASSERT(wq->old.size == old_size_at_pre - 1)
@@ -728,59 +1394,56 @@ void PICC_wait_queue_push_old(PICC_WaitQueue *wq, PICC_PiThread *pt, PICC_Error
     #ifdef CONTRACT_PRE
         // pre: pt != null
         ASSERT(pt != NULL);
+        // pre: pt not in wq
+        ASSERT(pt->wait_zone == PICC_WAIT_ZONE_NONE);
+    #endif
 
+    #ifdef CONTRACT_FULL
         // pre: pt not in wq
         bool pt_in_active_at_pre = false;
-        PICC_QueueCell *c = wq->active.head;
+        PICC_PiThread *c = wq->active.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 pt_in_active_at_pre = true;
                 break;
             }
             if (c == wq->active.tail)
                 break;
-            c = c->next;
+            c = c->wait_next;
         }
         bool pt_in_old_at_pre = false;
         c = wq->old.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 pt_in_old_at_pre = true;
                 break;
             }
-            c = c->next;
+            c = c->wait_next;
         }
         ASSERT(!(pt_in_active_at_pre || pt_in_old_at_pre));
+    #endif
 
+    #ifdef CONTRACT_POST
         // captures
         int size_at_pre = wq->old.size;
         PICC_PiThread *head_at_pre = NULL;
         if (wq->old.head != NULL)
-            head_at_pre = wq->old.head->thread;
+            head_at_pre = wq->old.head;
     #endif
 
-    // create queue cell
-    ALLOC_ERROR(cell_error);
-    PICC_QueueCell *cell = PICC_create_queue_cell(&cell_error);
-
-    if (HAS_ERROR(cell_error)) {
-        ADD_ERROR(error, cell_error, ERR_WAIT_QUEUE_PUSH_OLD);
-    } else {
-        cell->thread = pt;
-        if (wq->old.size == 0) {
-            wq->old.head = cell;
-            wq->old.tail = cell;
-            cell->next = NULL;
-        } else {
-            cell->next = wq->old.head;
-            wq->old.head = cell;
-        }
+    pt->wait_zone = PICC_WAIT_ZONE_OLD;
+    pt->wait_prev = wq->active.tail;
+    pt->wait_next = wq->old.head;
 
-        if (wq->active.size != 0)
-            wq->active.tail->next = cell;
+    if (wq->active.size != 0)
+        wq->active.tail->wait_next = pt;
+    if (wq->old.size == 0)
+        wq->old.tail = pt;
+    else
+        wq->old.head->wait_prev = pt;
 
-        wq->old.size++;
-    }
+    wq->old.head = pt;
+    wq->old.size++;
 
     #ifdef CONTRACT_POST_INV
         // inv@post
@@ -793,19 +1456,19 @@ void PICC_wait_queue_push_old(PICC_WaitQueue *wq, PICC_PiThread *pt, PICC_Error
         bool found = false;
         c = wq->old.head;
         while (c != NULL) {
-            if (c->thread == pt) {
+            if (c == pt) {
                 found = true;
                 break;
             }
-            c = c->next;
+            c = c->wait_next;
         }
         ASSERT(found == true);
 
         // post: pt == wq.old.head.thread
-        ASSERT(pt == wq->old.head->thread);
+        ASSERT(pt == wq->old.head);
         // post: if (wq.old.size@pre > 0) then wq.old.head.next.thread == wq.old.head@pre
         if (size_at_pre > 0)
-            ASSERT(wq->old.head->next->thread == head_at_pre);
+            ASSERT(wq->old.head->wait_next == head_at_pre);
         // post: wq.old.size == wq.old.size@pre + 1
         ASSERT(wq->old.size == size_at_pre + 1);
     #endif
@@ -843,34 +1506,14 @@ PICC_PiThread *PICC_wait_queue_pop_old(PICC_WaitQueue *wq)
         int size_at_pre = wq->old.size;
         PICC_PiThread *tail_at_pre = NULL;
         if (wq->old.tail != NULL)
-            tail_at_pre = wq->old.tail->thread;
+            tail_at_pre = wq->old.tail;
     #endif
 
     PICC_PiThread *popped_thread = NULL;
 
     if (wq->old.size > 0) {
-        PICC_QueueCell *popped_cell = wq->old.tail;
-        popped_thread = popped_cell->thread;
-
-        if (wq->old.size == 1) {
-            wq->old.tail = NULL;
-            wq->old.head = NULL;
-            if (wq->active.size > 0) {
-                wq->active.tail->next = NULL;
-            }
-        } else {
-            PICC_QueueCell *prev = wq->old.head;
-            while (prev != NULL && prev->next != popped_cell) {
-                prev = prev->next;
-            }
-
-            if (prev != NULL) {
-                free(prev->next);
-                prev->next = NULL;
-                wq->old.tail = prev;
-            }
-        }
-        wq->old.size--;
+        popped_thread = wq->old.tail;
+        wait_queue_unlink(wq, popped_thread);
     }
 
     #ifdef CONTRACT_POST_INV
@@ -926,17 +1569,17 @@ int PICC_wait_queue_size(PICC_WaitQueue *wq)
     #ifdef CONTRACT_POST
         // post: size == SUM(wq.active.head => wq.active.tail) + SUM(wq.old.head => wq.old.tail)
         int count = 0;
-        PICC_QueueCell *cell = wq->active.head;
-        while (cell != NULL) {
+        PICC_PiThread *c = wq->active.head;
+        while (c != NULL) {
             count++;
-            if (cell == wq->active.tail)
+            if (c == wq->active.tail)
                 break;
-            cell = cell->next;
+            c = c->wait_next;
         }
-        cell = wq->old.head;
-        while (cell != NULL) {
+        c = wq->old.head;
+        while (c != NULL) {
             count++;
-            cell = cell->next;
+            c = c->wait_next;
         }
         ASSERT(size == count);
     #endif
@@ -976,12 +1619,12 @@ int PICC_wait_queue_max_active(PICC_WaitQueue *wq)
     #ifdef CONTRACT_POST
         // post: size == SUM(wq.active.head => wq.active.tail)
         int count = 0;
-        PICC_QueueCell *cell = wq->active.head;
-        while (cell != NULL) {
+        PICC_PiThread *c = wq->active.head;
+        while (c != NULL) {
             count++;
-            if (cell == wq->active.tail)
+            if (c == wq->active.tail)
                 break;
-            cell = cell->next;
+            c = c->wait_next;
         }
         ASSERT(size == count);
     #endif
@@ -991,7 +1634,7 @@ int PICC_wait_queue_max_active(PICC_WaitQueue *wq)
 }
 
 /**
- * Resets the active wait queue by pushing its cells in the old wait queue.
+ * Resets the active wait queue by pushing its PiThreads in the old wait queue.
  *
  * @pre wq != null
  * @post wq.old.size == wq.old.size@pre + wq.active.size@pre
@@ -1020,7 +1663,7 @@ void PICC_wait_queue_max_active_reset(PICC_WaitQueue *wq)
         int old_size_at_pre = wq->old.size;
         PICC_PiThread *active_head_at_pre = NULL;
         if (wq->active.head != NULL)
-            active_head_at_pre = wq->active.head->thread;
+            active_head_at_pre = wq->active.head;
     #endif
 
     wq->old.size = wq->old.size + wq->active.size;
@@ -1034,6 +1677,9 @@ void PICC_wait_queue_max_active_reset(PICC_WaitQueue *wq)
     wq->active.head = NULL;
     wq->active.tail = NULL;
 
+    // the PiThreads of the previous active zone now belong to the old one
+    wq->active_zone++;
+
     #ifdef CONTRACT_POST_INV
         // inv@post
         PICC_WaitQueue_inv(wq);
@@ -1048,7 +1694,7 @@ void PICC_wait_queue_max_active_reset(PICC_WaitQueue *wq)
         ASSERT(wq->active.head == NULL);
         ASSERT(wq->active.tail == NULL);
         // post: wq.old.head == wq.active.head@pre if wq.active.size > 0
-        ASSERT(active_head_at_pre ? wq->old.head->thread == active_head_at_pre : true);
+        ASSERT(active_head_at_pre ? wq->old.head == active_head_at_pre : true);
     #endif
 
     RELEASE_QUEUE(wq);
@@ -1058,14 +1704,10 @@ void PICC_free_queue(PICC_Queue *q)
 {
     if(q!=NULL)
     {
-        PICC_QueueCell *c = q->head;
-        PICC_QueueCell *tmp;
-        while (c != NULL) 
-        {
-                tmp = c->next;
-                    free(c);
-                c = tmp;
-        }
+        // the PiThreads are linked intrusively, there is no cell to free
+        q->head = NULL;
+        q->tail = NULL;
+        q->size = 0;
     }
 }
 
@@ -1086,9 +1728,22 @@ void PICC_free_ready_queue(PICC_ReadyQueue *rq)
 {
     if(rq!=NULL)
     {
-        PICC_free_queue(&rq->q);
-        PICC_lock_free(rq->lock);
+        int i;
+        for (i = 0; i < rq->nb_workers; i++) {
+            // the arrays replaced by a bigger one are only freed now
+            PICC_DequeArray *array = atomic_load(&rq->deques[i].array);
+            while (array != NULL) {
+                PICC_DequeArray *prev = array->prev;
+                free(array);
+                array = prev;
+            }
+        }
+        free(rq->deques);
+        free(rq->nodes);
         free(rq);
+        // a new ready queue may be allocated at the same address
+        if (bound_queue == rq)
+            bound_queue = NULL;
     }
 }
 
@@ -1108,12 +1763,12 @@ void PICC_Queue_inv(PICC_Queue *queue)
     ASSERT(queue->size >= 0);
 
     int size = 0;
-    PICC_QueueCell *cell = queue->head;
-    while (cell != NULL) {
+    PICC_PiThread *c = queue->head;
+    while (c != NULL) {
         size++;
-        if (cell == queue->tail)
+        if (c == queue->tail)
             break;
-        cell = cell->next;
+        c = c->wait_next;
     }
     ASSERT(size == queue->size);
 
@@ -1131,24 +1786,32 @@ void PICC_Queue_inv(PICC_Queue *queue)
 }
 
 /**
- * Checks queue cell invariant.
+ * Checks ready queue invariant.
  *
- * @inv cell != null
+ * @inv nb_workers >= 0
+ * @inv shared.size >= 0
  */
-void PICC_QueueCell_inv(PICC_QueueCell *cell)
+void PICC_ReadyQueue_inv(PICC_ReadyQueue *queue)
 {
-    ASSERT(cell != NULL);
+    ASSERT(queue->nb_workers >= 0);
+    ASSERT(queue->nb_workers == 0 || queue->deques != NULL);
+    ASSERT(atomic_load(&queue->shared.size) >= 0);
+    ASSERT(atomic_load(&queue->in_flight) >= 0);
 }
 
 /**
- * Checks ready queue invariant.
+ * Checks work deque invariant. Only meaningful from the owner of the deque.
  *
- * @inv check_inv(q)
+ * @inv array != NULL
+ * @inv 0 <= bottom - top <= array.capacity
  */
-void PICC_ReadyQueue_inv(PICC_ReadyQueue *queue)
+void PICC_WorkDeque_inv(PICC_WorkDeque *deque)
 {
-    PICC_Queue_inv(&queue->q);
-    ASSERT(queue->q.tail == NULL || queue->q.tail->next == NULL);
+    PICC_DequeArray *array = atomic_load(&deque->array);
+    ASSERT(array != NULL);
+    long size = atomic_load(&deque->bottom) - atomic_load(&deque->top);
+    ASSERT(size >= 0);
+    ASSERT(size <= array->capacity);
 }
 
 /**
@@ -1159,10 +1822,21 @@ void PICC_ReadyQueue_inv(PICC_ReadyQueue *queue)
  */
 void PICC_WaitQueue_inv(PICC_WaitQueue *queue)
 {
+    ASSERT(queue->active_zone >= PICC_WAIT_ZONE_FIRST_ACTIVE);
+    if (queue->active.head != NULL) {
+        ASSERT(queue->active.head->wait_prev == NULL);
+        ASSERT(queue->active.head->wait_zone == queue->active_zone);
+        ASSERT(queue->active.tail->wait_zone == queue->active_zone);
+    }
+    if (queue->old.head != NULL) {
+        ASSERT(queue->old.head->wait_prev == queue->active.tail);
+        ASSERT(queue->old.head->wait_zone != queue->active_zone);
+        ASSERT(queue->old.tail->wait_zone != queue->active_zone);
+    }
     PICC_Queue_inv(&queue->active);
     if (queue->old.head == NULL) {
-        ASSERT(queue->active.tail == NULL || queue->active.tail->next == NULL);
+        ASSERT(queue->active.tail == NULL || queue->active.tail->wait_next == NULL);
     }
     PICC_Queue_inv(&queue->old);
-    ASSERT(queue->old.tail == NULL || queue->old.tail->next == NULL);
+    ASSERT(queue->old.tail == NULL || queue->old.tail->wait_next == NULL);
 }
@@ -12,11 +12,14 @@
 
 #include <pthread.h>
 #include <runtime.h>
+#include <runtime_repr.h>
 #include <pi_thread_repr.h>
 #include <queue_repr.h>
 #include <scheduler_repr.h>
 #include <limits.h>
 #include <value_repr.h>
+#include <gc.h>
+#include <tools.h>
 
 /**
  * Temporary main entry point.
@@ -28,8 +31,422 @@
 }*/
 
 /**
- * The entry point of the Runtime library. Initialises the real running
- * threads and starts the scheduler
+ * The fuel budget of the pi-thread slices of the next PICC_main.
+ */
+static int fuel_budget = PICC_FUEL_INIT;
+
+/**
+ * Sets the fuel budget of the runtime started by the next PICC_main: the
+ * number of steps a pi-thread runs before yielding to the ready queue when
+ * each worker has at most one pi-thread ready. The slices shrink as the
+ * ready queue gets deeper, down to PICC_FUEL_MIN.
+ *
+ * @pre fuel > 0
+ * @param fuel Fuel budget
+ */
+void PICC_set_fuel(int fuel)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(fuel > 0);
+    #endif
+
+    fuel_budget = fuel;
+}
+
+/**
+ * The placement of the scheduler threads of the next PICC_main.
+ */
+static PICC_PinMode pin_mode = PICC_PIN_NONE;
+static const char *pin_cpus = NULL;
+
+/**
+ * Sets how the runtime started by the next PICC_main places its scheduler
+ * threads. With PICC_PIN_CPU each worker is pinned to one of the allowed
+ * CPUs, with PICC_PIN_NODE to all the allowed CPUs of one NUMA node. The
+ * workers fill the nodes one after the other, steal from their own node
+ * first and recycle their pi-threads on it. By default (PICC_PIN_NONE)
+ * the system places the threads.
+ *
+ * @param mode Pinning mode
+ * @param cpus Cpulist of the allowed CPUs, as "0-7,16-23", NULL for the
+ *             affinity of the process
+ */
+void PICC_set_pinning(PICC_PinMode mode, const char *cpus)
+{
+    pin_mode = mode;
+    pin_cpus = cpus;
+}
+
+/**
+ * Initialises a runtime configuration with the defaults: the master
+ * alone, no adaptive sizing, the default GC parameters, fuel budget and
+ * ready queue policy, no pinning.
+ *
+ * @pre config != NULL
+ * @param config Configuration to initialise
+ */
+void PICC_runtime_config_init(PICC_RuntimeConfig *config)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(config != NULL);
+    #endif
+
+    config->nb_core_threads = 0;
+    config->min_core_threads = -1;
+    config->std_gc_fuel = PICC_STD_GC_FUEL;
+    config->quick_gc_fuel = PICC_QUICK_GC_FUEL;
+    config->active_factor = PICC_ACTIVE_FACTOR;
+    config->stw_threshold = 0;
+    config->fuel = PICC_FUEL_INIT;
+    config->policy = PICC_READY_MIXED;
+    config->pin_mode = PICC_PIN_NONE;
+    config->cpus = NULL;
+    config->serial = false;
+    config->seed = 0;
+}
+
+/**
+ * The runtimes alive: their number, or -1 while a serial one is, which
+ * must run alone since the synchronisation is disabled.
+ */
+static atomic_int live_runtimes = 0;
+
+/**
+ * Registers a new runtime among the live ones.
+ *
+ * @return false if it can't run alongside them
+ */
+static bool runtime_enter(bool serial)
+{
+    int live = atomic_load(&live_runtimes);
+    do {
+        if (live < 0 || (serial && live > 0))
+            return false;
+    } while (!atomic_compare_exchange_weak(&live_runtimes, &live, serial ? -1 : live + 1));
+    return true;
+}
+
+/**
+ * Unregisters a runtime registered by runtime_enter.
+ */
+static void runtime_leave(bool serial)
+{
+    if (serial)
+        atomic_store(&live_runtimes, 0);
+    else
+        atomic_fetch_sub(&live_runtimes, 1);
+}
+
+/**
+ * Empties the error stack of a worker.
+ */
+static void runtime_clear_error(PICC_Error *error)
+{
+    if (error->file != NULL)
+        free(error->file);
+    if (error->prev != NULL)
+        PICC_free_error(error->prev);
+    *error = (PICC_Error){.id = 0, .file = NULL, .line = 0, .prev = NULL};
+}
+
+/**
+ * Moves the first error of the workers to the given error stack, and
+ * empties the error stacks of the workers.
+ *
+ * @return true if a worker had an error
+ */
+static bool runtime_take_errors(PICC_Runtime *rt, PICC_ErrorId id, PICC_Error *error)
+{
+    bool failed = false;
+    int i;
+
+    for (i = 0; i < rt->nb_workers; i++) {
+        if (!(HAS_ERROR(rt->errors[i])))
+            continue;
+        if (!failed) {
+            // the copy made by ADD_ERROR takes the rest of the stack over
+            ADD_ERROR(error, rt->errors[i], id);
+            rt->errors[i].prev = NULL;
+            failed = true;
+        }
+        runtime_clear_error(&rt->errors[i]);
+    }
+    return failed;
+}
+
+/**
+ * Stops the workers of the runtime, joins their threads and frees the
+ * runtime. The pi-threads recycled by the workers stay in the depots for
+ * the next runtime.
+ */
+static void runtime_free(PICC_Runtime *rt)
+{
+    int i;
+
+    if (rt->sched_pool != NULL) {
+        PICC_sched_pool_stop(rt->sched_pool);
+        for (i = 0; i < rt->nb_threads; i++)
+            pthread_join(rt->threads[i], NULL);
+        if (rt->has_collector)
+            pthread_join(rt->collector, NULL);
+        PICC_free_sched_pool(rt->sched_pool);
+        // the waiting pi-threads were reclaimed by the current thread,
+        // whose buffered reference counts are applied as a worker does
+        PICC_pithread_pool_flush();
+        PICC_handle_flush_ref_counts();
+    }
+    if (rt->args != NULL) {
+        for (i = 0; i < rt->nb_workers; i++)
+            free(rt->args[i]);
+    }
+    if (rt->errors != NULL) {
+        for (i = 0; i < rt->nb_workers; i++)
+            runtime_clear_error(&rt->errors[i]);
+    }
+    free(rt->args);
+    free(rt->errors);
+    free(rt->threads);
+    PICC_free_topology(rt->topology);
+    if (rt->serial)
+        PICC_set_locking(true);
+    runtime_leave(rt->serial);
+    free(rt);
+}
+
+/**
+ * Creates a runtime with the given configuration and starts its workers:
+ * the master (worker 0) and nb_core_threads slaves, each in its own posix
+ * thread, and the collector thread running the GC unless it is disabled.
+ * The workers park until a PiThread is spawned and stay alive until
+ * PICC_runtime_shutdown. With a min_core_threads below nb_core_threads,
+ * only min_core_threads slaves are active at first, the pool then grows
+ * and shrinks with the load.
+ *
+ * A serial runtime only has the master, run by PICC_runtime_join on the
+ * calling thread, which also runs the GC, and the locks and eventcounts
+ * do nothing until it is shut down (see PICC_set_locking): it can't be
+ * created while another runtime is alive, nor another runtime while it
+ * is. Its ready PiThreads run in an order drawn from the seed, always the
+ * same for a seed.
+ *
+ * @pre config != NULL
+ * @pre config->nb_core_threads >= 0 && config->fuel > 0
+ * @param config Configuration of the runtime
+ * @param error Error stack
+ * @return Created runtime, NULL on error
+ */
+PICC_Runtime *PICC_create_runtime(const PICC_RuntimeConfig *config, PICC_Error *error)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(config != NULL);
+        ASSERT(config->nb_core_threads >= 0);
+        ASSERT(config->fuel > 0);
+    #endif
+
+    PICC_ALLOC(rt, PICC_Runtime, error) {
+        ALLOC_ERROR(sub_error);
+        int i;
+
+        if (!runtime_enter(config->serial)) {
+            NEW_ERROR(&sub_error, ERR_RUNTIME_SERIAL);
+            ADD_ERROR(error, sub_error, ERR_RUNTIME_CREATE);
+            free(sub_error.file); // copied by ADD_ERROR
+            free(rt);
+            return NULL;
+        }
+
+        rt->serial = config->serial;
+        rt->nb_workers = rt->serial ? 1 : config->nb_core_threads + 1;
+        rt->nb_threads = 0;
+        rt->has_collector = false;
+        rt->topology = NULL;
+        rt->sched_pool = PICC_create_sched_pool(rt->nb_workers, &sub_error);
+        rt->threads = malloc(rt->nb_workers * sizeof(pthread_t));
+        rt->args = calloc(rt->nb_workers, sizeof(PICC_Args *));
+        rt->errors = calloc(rt->nb_workers, sizeof(PICC_Error));
+        if (rt->threads == NULL || rt->args == NULL || rt->errors == NULL)
+            NEW_ERROR(&sub_error, ERR_OUT_OF_MEMORY);
+
+        if (!(HAS_ERROR(sub_error)) && rt->serial) {
+            PICC_SchedPool *sp = rt->sched_pool;
+            sp->fuel = config->fuel;
+            PICC_sched_pool_set_gc(sp, config->std_gc_fuel, config->quick_gc_fuel,
+                                   config->active_factor);
+            PICC_sched_pool_set_stw(sp, config->stw_threshold);
+            PICC_ready_queue_set_policy(sp->ready, config->policy);
+            sp->serial = true;
+            PICC_ready_queue_set_seed(sp->ready, config->seed);
+            atomic_store(&sp->running, true);
+            rt->args[0] = PICC_create_args(sp, 0, &rt->errors[0], &sub_error);
+            if (!(HAS_ERROR(sub_error)))
+                PICC_set_locking(false);
+        }
+
+        if (!(HAS_ERROR(sub_error)) && !rt->serial) {
+            PICC_SchedPool *sp = rt->sched_pool;
+            sp->fuel = config->fuel;
+            PICC_sched_pool_set_gc(sp, config->std_gc_fuel, config->quick_gc_fuel,
+                                   config->active_factor);
+            PICC_sched_pool_set_stw(sp, config->stw_threshold);
+            PICC_ready_queue_set_policy(sp->ready, config->policy);
+            if (config->min_core_threads >= 0 && config->min_core_threads < config->nb_core_threads)
+                PICC_sched_pool_set_active(sp, config->min_core_threads, config->min_core_threads);
+            if (config->pin_mode != PICC_PIN_NONE) {
+                rt->topology = PICC_create_topology(config->cpus, &sub_error);
+                if (rt->topology != NULL)
+                    PICC_sched_pool_place(sp, rt->topology, config->pin_mode);
+            }
+        }
+
+        if (!(HAS_ERROR(sub_error)) && !rt->serial) {
+            atomic_store(&rt->sched_pool->running, true);
+            for (i = 0; i < rt->nb_workers && !(HAS_ERROR(sub_error)); i++) {
+                void *function = i == 0 ? PICC_sched_pool_master : PICC_sched_pool_slave;
+                rt->args[i] = PICC_create_args(rt->sched_pool, i, &rt->errors[i], &sub_error);
+                if (HAS_ERROR(sub_error))
+                    break;
+                if (pthread_create(&rt->threads[i], NULL, function, rt->args[i]))
+                    NEW_ERROR(&sub_error, ERR_PTHREAD_CREATE);
+                else
+                    rt->nb_threads++;
+            }
+            if (!(HAS_ERROR(sub_error)) && config->std_gc_fuel > 0) {
+                void *function = PICC_sched_pool_collector;
+                if (pthread_create(&rt->collector, NULL, function, rt->sched_pool))
+                    NEW_ERROR(&sub_error, ERR_PTHREAD_CREATE);
+                else
+                    rt->has_collector = true;
+            }
+            // the pinning errors are known once the workers are started
+            PICC_sched_pool_wait_started(rt->sched_pool, rt->nb_threads);
+            if (!(HAS_ERROR(sub_error)))
+                runtime_take_errors(rt, ERR_RUNTIME_WORKER, &sub_error);
+        }
+
+        if (HAS_ERROR(sub_error)) {
+            ADD_ERROR(error, sub_error, ERR_RUNTIME_CREATE);
+            free(sub_error.file); // copied by ADD_ERROR
+            runtime_free(rt);
+            rt = NULL;
+        }
+    }
+    return rt;
+}
+
+/**
+ * Spawns a PiThread running the given entry procedure in the runtime. The
+ * depot is pre-warmed with PiThreads of its shape first.
+ *
+ * @pre rt != NULL && entrypoint != NULL
+ * @param rt Runtime
+ * @param entrypoint Entry procedure of the PiThread
+ * @param env_length Size of the environment
+ * @param knowns_length Size of the knowns set
+ * @param enabled_length Number of enabled flags
+ */
+void PICC_runtime_spawn(PICC_Runtime *rt, PICC_PiThreadProc *entrypoint,
+                int env_length, int knowns_length, int enabled_length)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rt != NULL);
+        ASSERT(entrypoint != NULL);
+    #endif
+
+    PICC_pithread_pool_prewarm(env_length, knowns_length, enabled_length,
+                               PICC_PITHREAD_POOL_PREWARM);
+
+    PICC_PiThread *thread = PICC_create_pithread(env_length, knowns_length, enabled_length);
+    thread->proc = entrypoint;
+    PICC_ready_queue_push(rt->sched_pool->ready, thread);
+}
+
+/**
+ * Waits until the runtime is quiescent: every spawned PiThread, and every
+ * PiThread they created, has ended or waits. The runtime keeps running and
+ * may be given new PiThreads afterwards. The master of a serial runtime
+ * runs the PiThreads on the calling thread meanwhile.
+ *
+ * @pre rt != NULL
+ * @param rt Runtime
+ * @param error Error stack, given the first error of the workers
+ * @return PICC_RUNTIME_ERROR if a worker failed since the last join,
+ *         PICC_RUNTIME_BLOCKED if some PiThreads wait forever,
+ *         PICC_RUNTIME_DONE otherwise
+ */
+PICC_RuntimeStatus PICC_runtime_join(PICC_Runtime *rt, PICC_Error *error)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rt != NULL);
+    #endif
+
+    if (rt->serial)
+        PICC_sched_pool_master(rt->args[0]);
+    PICC_sched_pool_wait_quiescent(rt->sched_pool);
+
+    if (runtime_take_errors(rt, ERR_RUNTIME_WORKER, error))
+        return PICC_RUNTIME_ERROR;
+    // no PiThread is left to awake the waiting ones
+    if (PICC_wait_queue_size(rt->sched_pool->wait) > 0)
+        return PICC_RUNTIME_BLOCKED;
+    return PICC_RUNTIME_DONE;
+}
+
+/**
+ * Takes a snapshot of the sizing and of the GC of the runtime. The
+ * figures are read while the workers run, they are only consistent once
+ * it is quiescent.
+ *
+ * @pre rt != NULL && stats != NULL
+ * @param rt Runtime
+ * @param stats Snapshot to fill
+ */
+void PICC_runtime_stats(PICC_Runtime *rt, PICC_RuntimeStats *stats)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rt != NULL);
+        ASSERT(stats != NULL);
+    #endif
+
+    PICC_SchedPool *sp = rt->sched_pool;
+    stats->nb_workers = rt->nb_workers;
+    stats->nb_active = atomic_load(&sp->nb_active) + 1;
+    stats->nb_idle = atomic_load(&sp->nb_idle);
+    stats->in_flight = PICC_ready_queue_in_flight(sp->ready);
+    stats->nb_samples = atomic_load(&sp->nb_samples);
+    stats->nb_grows = atomic_load(&sp->nb_grows);
+    stats->nb_shrinks = atomic_load(&sp->nb_shrinks);
+    stats->nb_gc_runs = atomic_load(&sp->nb_gc_runs);
+    stats->nb_gc_cliques = atomic_load(&sp->nb_gc_cliques);
+    stats->nb_gc_slices = atomic_load(&sp->nb_gc_slices);
+    stats->nb_gc_stops = atomic_load(&sp->nb_gc_stops);
+    stats->gc_seconds = atomic_load(&sp->gc_nanos) * 1e-9;
+}
+
+/**
+ * Waits until the runtime is quiescent, then stops its workers and
+ * releases everything it owns: the threads and error stacks of the
+ * workers, the queues, the PiThreads left waiting and the topology. The
+ * recycled PiThreads stay in the depots, so that a new runtime restarts
+ * without allocating them, until PICC_pithread_pool_clear.
+ *
+ * @pre rt != NULL
+ * @param rt Runtime
+ */
+void PICC_runtime_shutdown(PICC_Runtime *rt)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(rt != NULL);
+    #endif
+
+    PICC_sched_pool_wait_quiescent(rt->sched_pool);
+    runtime_free(rt);
+}
+
+/**
+ * The entry point of the Runtime library. Runs a runtime on the given
+ * entry procedure until it is quiescent, then shuts it down. The fuel
+ * budget and the pinning are the ones set by PICC_set_fuel and
+ * PICC_set_pinning.
  *
  * @param nb_core_threads Maximum number of core threads that can run at the same time
  * @param entrypoint Entry procedure the for the first thread
@@ -41,51 +458,25 @@ void PICC_main(int nb_core_threads, PICC_PiThreadProc entrypoint,
                 int std_gc_fuel, int quick_gc_fuel, int active_factor,
                 int entry_env_length, int entry_knowns_length, int entry_enabled_length)
 {
-    // defining word size, 32bit by default
-    // #ifdef WORD_BIT
-    // #define WORD_SIZE WORD_BIT;
-    // #endif
-
-    // #ifdef __WORDSIZE
-    // #define WORD_SIZE __WORDSIZE;
-    // #endif
-
     // contains all the errors
     ALLOC_ERROR(error);
 
-    PICC_SchedPool *sched_pool = PICC_create_sched_pool(&error);
-    if (HAS_ERROR(error)) CRASH(&error);
-    PICC_Args *args = PICC_create_args(sched_pool, &error, &error);
-    if (HAS_ERROR(error)) CRASH(&error);
-
-    int i, status;
-    void *function = PICC_sched_pool_slave;
-    pthread_t *threads = malloc(nb_core_threads * sizeof(pthread_t));
-    if (threads == NULL) {
-        NEW_ERROR(&error, ERR_OUT_OF_MEMORY);
-        CRASH(&error);
-    }
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.nb_core_threads = nb_core_threads;
+    config.std_gc_fuel = std_gc_fuel;
+    config.quick_gc_fuel = quick_gc_fuel;
+    config.active_factor = active_factor;
+    config.fuel = fuel_budget;
+    config.pin_mode = pin_mode;
+    config.cpus = pin_cpus;
 
-    sched_pool->running = true;
-    for (i = 0; i < nb_core_threads; i++) {
-        status = pthread_create(&threads[i], NULL, function, args);
-        if (status) {
-            NEW_ERROR(&error, ERR_PTHREAD_CREATE);
-            CRASH(&error);
-        }
-        sched_pool->nb_slaves++;
-    }
-
-    while (sched_pool->nb_waiting_slaves != sched_pool->nb_slaves) {
-        PICC_low_level_yield();
-    }
-
-    PICC_PiThread *init_thread =
-        PICC_create_pithread(entry_env_length, entry_knowns_length, entry_enabled_length);
-    init_thread->proc = entrypoint;
+    PICC_Runtime *rt = PICC_create_runtime(&config, &error);
+    if (HAS_ERROR(error)) CRASH(&error);
 
-    PICC_ready_queue_push(sched_pool->ready, init_thread);
+    PICC_runtime_spawn(rt, entrypoint, entry_env_length, entry_knowns_length, entry_enabled_length);
+    PICC_RuntimeStatus status = PICC_runtime_join(rt, &error);
+    PICC_runtime_shutdown(rt);
 
-    PICC_sched_pool_master(sched_pool, std_gc_fuel, quick_gc_fuel, active_factor, &error);
-    if (HAS_ERROR(error)) CRASH(&error);
+    if (status == PICC_RUNTIME_ERROR) CRASH(&error);
 }
@@ -8,6 +8,10 @@
  * @author Mickaël MENU
  */
 
+#define _GNU_SOURCE
+
+#include <time.h>
+#include <sys/resource.h>
 #include <gc.h>
 #include <scheduler_repr.h>
 #include <queue_repr.h>
@@ -16,32 +20,23 @@
 #include <error.h>
 #include <stdio.h>
 
-#define LOCK_SCHED_POOL(sp) \
-    PICC_acquire(&(sp->lock));
-
-#define RELEASE_SCHED_POOL(sp) \
-    PICC_release(&(sp->lock));
-
-#define WAIT_SCHED_POOL(sp) \
-    PICC_cond_wait(&(sp->cond), &(sp->lock));
-
-#define SIGNAL_SCHED_POOL(sp, error) \
-    PICC_cond_signal(&(sp->cond), error);
-
-#define BROADCAST_SCHED_POOL(sp, error) \
-    PICC_cond_broadcast(&(sp->cond), error);
+/**
+ * Number of times an idle worker looks for a ready PiThread before parking.
+ */
+#define PICC_SCHED_IDLE_SPINS 16
 
 /**
  * Creates a new scheduler.
  *
+ * @param nb_workers Number of workers (master included) owning a ready deque
  * @param error Error stack
  * @return Created scheduler
  */
-PICC_SchedPool *PICC_create_sched_pool(PICC_Error *error)
+PICC_SchedPool *PICC_create_sched_pool(int nb_workers, PICC_Error *error)
 {
     PICC_ALLOC(pool, PICC_SchedPool, error) {
         ALLOC_ERROR(sub_error);
-        pool->ready = PICC_create_ready_queue(&sub_error);
+        pool->ready = PICC_create_worker_ready_queue(nb_workers, &sub_error);
         pool->wait = PICC_create_wait_queue(&sub_error);
         if (HAS_ERROR(sub_error)) {
             ADD_ERROR(error, sub_error, ERR_SCHED_POOL_CREATE);
@@ -49,34 +44,578 @@ PICC_SchedPool *PICC_create_sched_pool(PICC_Error *error)
             pool = NULL;
         } else {
             pool->nb_slaves = 0;
-            pool->nb_waiting_slaves = 0;
-            pool->running = false;
+            pool->nb_workers = nb_workers;
+            pool->topology = NULL;
+            pool->pin_mode = PICC_PIN_NONE;
+            pool->fuel = PICC_FUEL_INIT;
+            pool->std_gc_fuel = 0;
+            pool->quick_gc_fuel = 0;
+            pool->active_factor = 0;
+            atomic_init(&pool->gc_fuel, 0);
+            atomic_init(&pool->gc_pending, false);
+            PICC_init_eventcount(&pool->collect);
+            pool->gc_scratch = NULL;
+            pool->stw_threshold = 0;
+            pool->last_wait_size = 0;
+            atomic_init(&pool->stopping, false);
+            atomic_init(&pool->nb_mutators, 0);
+            PICC_init_eventcount(&pool->resume);
+            pool->serial = false;
+            atomic_init(&pool->running, false);
+            atomic_init(&pool->nb_started, 0);
+            PICC_init_eventcount(&pool->quiescent);
+            pool->min_active = nb_workers - 1;
+            atomic_init(&pool->nb_active, nb_workers - 1);
+            atomic_init(&pool->nb_idle, 0);
+            atomic_init(&pool->nb_idle_polls, 0);
+            pool->last_idle_polls = 0;
+            PICC_init_eventcount(&pool->dormant);
+            atomic_flag_clear(&pool->adapting);
+            pool->pressure_samples = 0;
+            pool->idle_samples = 0;
+            atomic_init(&pool->nb_samples, 0);
+            atomic_init(&pool->nb_grows, 0);
+            atomic_init(&pool->nb_shrinks, 0);
+            atomic_init(&pool->nb_gc_runs, 0);
+            atomic_init(&pool->nb_gc_cliques, 0);
+            atomic_init(&pool->nb_gc_slices, 0);
+            atomic_init(&pool->nb_gc_stops, 0);
+            atomic_init(&pool->gc_nanos, 0);
         }
-        PICC_init_lock(&(pool->lock));
-        PICC_init_condition(&(pool->cond));
     }
     return pool;
 }
 
+/**
+ * Frees the given scheduler pool and its queues. The PiThreads left in the
+ * wait queue are reclaimed, as the GC reclaims a clique. The workers and
+ * the collector must be stopped and joined, the topology is not freed.
+ *
+ * @param sp Scheduler pool
+ */
+void PICC_free_sched_pool(PICC_SchedPool *sp)
+{
+    PICC_PiThread *pt;
+
+    if (sp == NULL)
+        return;
+
+    // the active zone joins the old one
+    PICC_wait_queue_max_active_reset(sp->wait);
+    while ((pt = PICC_wait_queue_pop_old(sp->wait)) != NULL)
+        PICC_reclaim_pi_thread(pt);
+    PICC_free_wait_queue(sp->wait);
+    PICC_free_ready_queue(sp->ready);
+    PICC_free_gc_scratch(sp->gc_scratch);
+    free(sp);
+}
+
 /**
  * Creates a new set of arguments to passe to a scheduler.
  *
  * @param sp Scheduler pool
+ * @param worker Index of the worker deque of the scheduler
  * @param err Scheduler error stack
  * @param error Error stack
  * @return Created set of arguments
  */
-PICC_Args *PICC_create_args(PICC_SchedPool *sp, PICC_Error *err, PICC_Error *error)
+PICC_Args *PICC_create_args(PICC_SchedPool *sp, int worker, PICC_Error *err, PICC_Error *error)
 {
     PICC_ALLOC(args, PICC_Args, error) {
         args->sched_pool = sp;
+        args->worker = worker;
         args->error = err;
     }
     return args;
 }
 
 /**
- * Handles the behavior of secondary real threads in scheduler pool.
+ * Places the workers of the scheduler pool on the given topology, node by
+ * node: the workers of a node steal from each other first. Each worker
+ * pins itself with PICC_sched_pool_pin.
+ *
+ * @pre sp != NULL && topo != NULL
+ * @param sp Scheduler pool
+ * @param topo Topology of the allowed CPUs
+ * @param mode How the workers are pinned
+ */
+void PICC_sched_pool_place(PICC_SchedPool *sp, PICC_Topology *topo, PICC_PinMode mode)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+        ASSERT(topo != NULL);
+    #endif
+
+    int worker;
+    sp->topology = topo;
+    sp->pin_mode = mode;
+    for (worker = 0; worker < sp->nb_workers; worker++)
+        PICC_ready_queue_set_node(sp->ready, worker, PICC_topology_worker_node(topo, worker));
+}
+
+/**
+ * Pins the current posix thread as the given worker of the scheduler pool,
+ * if the pool was placed on a topology.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ * @param worker Index of the worker
+ * @param error Error stack
+ */
+void PICC_sched_pool_pin(PICC_SchedPool *sp, int worker, PICC_Error *error)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    if (sp->topology != NULL && !PICC_topology_pin(sp->topology, sp->pin_mode, worker))
+        NEW_ERROR(error, ERR_THREAD_AFFINITY);
+}
+
+/**
+ * Returns the slice of fuel of a popped PiThread: the whole fuel budget
+ * while each worker has at most one PiThread in flight, and a share of it
+ * as the ready queue gets deeper, so that the ready PiThreads wait less.
+ *
+ * @pre sp != NULL
+ * @post PICC_FUEL_MIN <= result <= max(sp->fuel, PICC_FUEL_MIN)
+ * @param sp Scheduler pool
+ * @return Fuel of the slice
+ */
+int PICC_sched_pool_fuel(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    int depth = PICC_ready_queue_in_flight(sp->ready) / sp->nb_workers;
+    int fuel = depth > 1 ? sp->fuel / depth : sp->fuel;
+    return fuel < PICC_FUEL_MIN ? PICC_FUEL_MIN : fuel;
+}
+
+/**
+ * Sets the bounds of the adaptive sizing of the scheduler pool: at least
+ * min_active slaves are active, nb_active at first. By default every
+ * slave is always active.
+ *
+ * @pre sp != NULL
+ * @pre 0 <= min_active <= nb_active <= sp->nb_workers - 1
+ * @param sp Scheduler pool
+ * @param min_active Number of slaves always active
+ * @param nb_active Number of slaves active at first
+ */
+void PICC_sched_pool_set_active(PICC_SchedPool *sp, int min_active, int nb_active)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+        ASSERT(0 <= min_active && min_active <= nb_active);
+        ASSERT(nb_active <= sp->nb_workers - 1);
+    #endif
+
+    sp->min_active = min_active;
+    atomic_store(&sp->nb_active, nb_active);
+    PICC_eventcount_notify_all(&sp->dormant);
+}
+
+/**
+ * Sets the GC parameters of the scheduler pool: a GC is requested every
+ * std_gc_fuel PiThreads run by the workers, every quick_gc_fuel ones after
+ * an unsuccessful GC, and collects when the wait queue has grown
+ * active_factor times the PiThreads that waited since the last GC. A
+ * std_gc_fuel of 0 disables the GC.
+ *
+ * @pre sp != NULL && std_gc_fuel >= 0
+ * @param sp Scheduler pool
+ * @param std_gc_fuel PiThreads run between two requests of a GC
+ * @param quick_gc_fuel The same after an unsuccessful GC
+ * @param active_factor Ratio between the waiting PiThreads and the active
+ *                      ones above which the GC collects
+ */
+void PICC_sched_pool_set_gc(PICC_SchedPool *sp, int std_gc_fuel, int quick_gc_fuel,
+                            int active_factor)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+        ASSERT(std_gc_fuel >= 0);
+    #endif
+
+    sp->std_gc_fuel = std_gc_fuel;
+    sp->quick_gc_fuel = quick_gc_fuel;
+    sp->active_factor = active_factor;
+    atomic_store(&sp->gc_fuel, std_gc_fuel);
+}
+
+/**
+ * Sets the threshold of the stop-the-world GCs of the scheduler pool: a
+ * requested GC collects every clique at once, with the workers parked,
+ * when the wait queue has grown stw_threshold PiThreads since the last
+ * GC. A stw_threshold of 0, the default, never stops the world. It must
+ * be set before the workers are started.
+ *
+ * @pre sp != NULL && stw_threshold >= 0
+ * @param sp Scheduler pool
+ * @param stw_threshold Growth of the wait queue above which the GC stops
+ *                      the world
+ */
+void PICC_sched_pool_set_stw(PICC_SchedPool *sp, int stw_threshold)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+        ASSERT(stw_threshold >= 0);
+    #endif
+
+    sp->stw_threshold = stw_threshold;
+}
+
+/**
+ * Samples the scheduler pool and wakes up or puts to sleep a slave, as
+ * described by PICC_SchedPool. Only one worker samples at a time, the
+ * others return at once.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ */
+void PICC_sched_pool_adapt(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    if (sp->min_active == sp->nb_workers - 1
+        || atomic_flag_test_and_set_explicit(&sp->adapting, memory_order_acquire))
+        return;
+
+    int active = atomic_load(&sp->nb_active);
+    int in_flight = PICC_ready_queue_in_flight(sp->ready);
+    long idle_polls = atomic_load_explicit(&sp->nb_idle_polls, memory_order_relaxed);
+    bool idle = idle_polls > sp->last_idle_polls || atomic_load(&sp->nb_idle) > 0;
+    sp->last_idle_polls = idle_polls;
+    atomic_fetch_add_explicit(&sp->nb_samples, 1, memory_order_relaxed);
+
+    // the master is always active; the pool is underused when a worker
+    // has no PiThread, or when there is one for each but some idled
+    bool pressure = in_flight > PICC_SCHED_GROW_DEPTH * (active + 1);
+    bool underused = in_flight < active + 1 || (idle && in_flight == active + 1);
+
+    if (pressure && active < sp->nb_workers - 1)
+        sp->pressure_samples++;
+    else
+        sp->pressure_samples = 0;
+    if (underused && active > sp->min_active)
+        sp->idle_samples++;
+    else
+        sp->idle_samples = 0;
+
+    if (sp->pressure_samples >= PICC_SCHED_ADAPT_SAMPLES) {
+        sp->pressure_samples = 0;
+        atomic_store(&sp->nb_active, active + 1);
+        atomic_fetch_add_explicit(&sp->nb_grows, 1, memory_order_relaxed);
+        PICC_eventcount_notify_all(&sp->dormant);
+    } else if (sp->idle_samples >= PICC_SCHED_ADAPT_SAMPLES) {
+        // the slave goes dormant once it is idle
+        sp->idle_samples = 0;
+        atomic_store(&sp->nb_active, active - 1);
+        atomic_fetch_add_explicit(&sp->nb_shrinks, 1, memory_order_relaxed);
+    }
+
+    atomic_flag_clear_explicit(&sp->adapting, memory_order_release);
+}
+
+/**
+ * Stops the scheduler pool and wakes up all its parked workers. Each
+ * worker returns once it is done with its current PiThread.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ */
+void PICC_sched_pool_stop(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    atomic_store(&sp->running, false);
+    PICC_eventcount_notify_all(&sp->ready->idle);
+    PICC_eventcount_notify_all(&sp->dormant);
+    PICC_eventcount_notify_all(&sp->collect);
+}
+
+/**
+ * Tells the waiters of the scheduler pool that the current worker is
+ * started: pinned and bound to its deque.
+ */
+static void sched_pool_started(PICC_SchedPool *sp)
+{
+    atomic_fetch_add_explicit(&sp->nb_started, 1, memory_order_acq_rel);
+    PICC_eventcount_notify_all(&sp->quiescent);
+}
+
+/**
+ * Waits until the given number of workers of the scheduler pool are
+ * started. Their pinning errors are then in their error stacks.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ * @param nb_workers Number of workers to wait for
+ */
+void PICC_sched_pool_wait_started(PICC_SchedPool *sp, int nb_workers)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    while (atomic_load_explicit(&sp->nb_started, memory_order_acquire) < nb_workers) {
+        unsigned key = PICC_eventcount_prepare(&sp->quiescent);
+        if (atomic_load_explicit(&sp->nb_started, memory_order_acquire) >= nb_workers) {
+            PICC_eventcount_cancel(&sp->quiescent);
+            break;
+        }
+        PICC_eventcount_wait(&sp->quiescent, key);
+    }
+}
+
+/**
+ * Returns whether a PiThread is in flight in the scheduler pool or a
+ * requested GC is not done.
+ */
+static bool sched_pool_busy(PICC_SchedPool *sp)
+{
+    return PICC_ready_queue_in_flight(sp->ready) > 0 || atomic_load(&sp->gc_pending);
+}
+
+/**
+ * Waits until no PiThread is in flight in the scheduler pool: every
+ * PiThread has ended or waits, and the requested GC is done. The workers
+ * keep running, a PiThread pushed afterwards is run as usual.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ */
+void PICC_sched_pool_wait_quiescent(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    while (sched_pool_busy(sp)) {
+        unsigned key = PICC_eventcount_prepare(&sp->quiescent);
+        if (!sched_pool_busy(sp)) {
+            PICC_eventcount_cancel(&sp->quiescent);
+            break;
+        }
+        PICC_eventcount_wait(&sp->quiescent, key);
+    }
+}
+
+/**
+ * Puts the current slave to sleep while it is not active. The wake-up it
+ * may have taken from the idle workers is passed on.
+ */
+static void sched_pool_dormant(PICC_SchedPool *sp, int worker)
+{
+    PICC_eventcount_notify(&sp->ready->idle);
+    PICC_handle_flush_ref_counts();
+    while (worker > atomic_load(&sp->nb_active) && atomic_load(&sp->running)) {
+        unsigned key = PICC_eventcount_prepare(&sp->dormant);
+        if (worker <= atomic_load(&sp->nb_active) || !atomic_load(&sp->running)) {
+            PICC_eventcount_cancel(&sp->dormant);
+            break;
+        }
+        PICC_eventcount_wait(&sp->dormant, key);
+    }
+}
+
+/**
+ * Returns the next PiThread the current worker runs. An idle worker looks
+ * for one a few times, then parks until a PiThread is pushed or the
+ * scheduler pool stops. An idle slave that is no longer active goes
+ * dormant until the pool grows again. A serial master has nobody to wait
+ * for: it returns as soon as no PiThread is ready.
+ *
+ * @param sp Scheduler pool
+ * @param worker Index of the current worker
+ * @return PiThread to run, NULL once the scheduler pool is stopped, or
+ *         idle if it is serial
+ */
+static PICC_PiThread *sched_pool_next(PICC_SchedPool *sp, int worker)
+{
+    PICC_PiThread *current;
+    int spins = 0;
+
+    while (atomic_load(&sp->running)) {
+        if ((current = PICC_ready_queue_pop(sp->ready)) != NULL || sp->serial)
+            return current;
+
+        // its deque is empty, no PiThread is left behind
+        if (worker > atomic_load_explicit(&sp->nb_active, memory_order_relaxed)) {
+            sched_pool_dormant(sp, worker);
+            spins = 0;
+            continue;
+        }
+
+        atomic_fetch_add_explicit(&sp->nb_idle_polls, 1, memory_order_relaxed);
+        if (spins < PICC_SCHED_IDLE_SPINS) {
+            spins++;
+            PICC_low_level_yield();
+            continue;
+        }
+
+        // the references dropped are applied before the worker parks
+        PICC_handle_flush_ref_counts();
+        unsigned key = PICC_eventcount_prepare(&sp->ready->idle);
+        if ((current = PICC_ready_queue_pop(sp->ready)) != NULL
+            || !atomic_load(&sp->running)) {
+            PICC_eventcount_cancel(&sp->ready->idle);
+            return current;
+        }
+        atomic_fetch_add_explicit(&sp->nb_idle, 1, memory_order_relaxed);
+        PICC_eventcount_wait(&sp->ready->idle, key);
+        atomic_fetch_sub_explicit(&sp->nb_idle, 1, memory_order_relaxed);
+        spins = 0;
+    }
+    return NULL;
+}
+
+/**
+ * Runs a popped PiThread until it stops. Each call of its procedure consumes
+ * one step of its slice of fuel, a PiThread still calling once the fuel is
+ * exhausted is preempted: it yields to the end of the ready queue. A
+ * PiThread that waits has registered its commitments, it is put in the wait
+ * queue only once its procedure has returned: the worker no longer touches
+ * it afterwards, another worker may awake it at once. An ended PiThread is
+ * reclaimed in the pool of the worker.
+ *
+ * @param sp Scheduler pool
+ * @param current PiThread to run
+ * @param error Error stack
+ */
+static void sched_pool_run(PICC_SchedPool *sp, PICC_PiThread *current, PICC_Error *error)
+{
+    PICC_StatusKind status;
+
+    current->fuel = PICC_sched_pool_fuel(sp);
+    do {
+        current->proc(sp, current);
+        status = current->status;
+    } while(status == PICC_STATUS_CALL && --current->fuel > 0);
+
+    if (status == PICC_STATUS_CALL)
+        PICC_yield(sp, current);
+    else if (status == PICC_STATUS_WAIT)
+        PICC_wait_queue_push(sp->wait, current);
+    else if (status == PICC_STATUS_ENDED)
+        PICC_reclaim_pi_thread(current);
+    else if (status == PICC_STATUS_BLOCKED) // && safe_choice
+        NEW_ERROR(error, ERR_DEADLOCK);
+}
+
+/**
+ * PiThreads the current worker runs before its next sample of the pool and
+ * flush of its reference counts.
+ */
+static __thread int adapt_fuel = PICC_SCHED_ADAPT_PERIOD;
+
+/**
+ * Counts a PiThread run down from the GC fuel of the scheduler pool, and
+ * requests a GC once it is exhausted. The collector of a serial pool is
+ * its master, which checks the request itself.
+ */
+static void sched_pool_request_gc(PICC_SchedPool *sp)
+{
+    if (sp->std_gc_fuel <= 0
+        || atomic_fetch_sub_explicit(&sp->gc_fuel, 1, memory_order_relaxed) != 1)
+        return;
+    atomic_store(&sp->gc_pending, true);
+    if (!sp->serial)
+        PICC_eventcount_notify(&sp->collect);
+}
+
+/**
+ * The safepoint of the workers, before each PiThread they run: the
+ * current worker counts itself among the mutators, and parks while the
+ * collector stops the world.
+ */
+static void sched_pool_safepoint(PICC_SchedPool *sp)
+{
+    if (sp->stw_threshold <= 0)
+        return;
+    // sequentially consistent with the stop of the collector: either it
+    // sees this worker or the worker sees it stopping
+    atomic_fetch_add(&sp->nb_mutators, 1);
+    while (atomic_load(&sp->stopping)) {
+        // the collector sees the references dropped so far
+        PICC_handle_flush_ref_counts();
+        if (atomic_fetch_sub(&sp->nb_mutators, 1) == 1)
+            PICC_eventcount_notify(&sp->collect);
+        unsigned key = PICC_eventcount_prepare(&sp->resume);
+        if (atomic_load(&sp->stopping))
+            PICC_eventcount_wait(&sp->resume, key);
+        else
+            PICC_eventcount_cancel(&sp->resume);
+        atomic_fetch_add(&sp->nb_mutators, 1);
+    }
+}
+
+/**
+ * Tells the collector that the current worker no longer runs a PiThread.
+ */
+static void sched_pool_unsafe_end(PICC_SchedPool *sp)
+{
+    if (sp->stw_threshold > 0
+        && atomic_fetch_sub(&sp->nb_mutators, 1) == 1 && atomic_load(&sp->stopping))
+        PICC_eventcount_notify(&sp->collect);
+}
+
+/**
+ * Stops the world: waits until no worker runs a PiThread. The workers
+ * park at their safepoint until sched_pool_resume_world.
+ */
+static void sched_pool_stop_world(PICC_SchedPool *sp)
+{
+    atomic_store(&sp->stopping, true);
+    while (atomic_load(&sp->nb_mutators) > 0) {
+        unsigned key = PICC_eventcount_prepare(&sp->collect);
+        if (atomic_load(&sp->nb_mutators) == 0) {
+            PICC_eventcount_cancel(&sp->collect);
+            break;
+        }
+        PICC_eventcount_wait(&sp->collect, key);
+    }
+}
+
+static void sched_pool_resume_world(PICC_SchedPool *sp)
+{
+    atomic_store(&sp->stopping, false);
+    PICC_eventcount_notify_all(&sp->resume);
+}
+
+/**
+ * Tells the ready queue that the current worker is done with its PiThread,
+ * and wakes up the waiters of the quiescence if it was the last PiThread
+ * in flight. Every PICC_SCHED_ADAPT_PERIOD PiThreads, the worker applies
+ * the reference counts it buffered and samples the pool.
+ *
+ * @param sp Scheduler pool
+ */
+static void sched_pool_done(PICC_SchedPool *sp)
+{
+    // requested first, so that the pool is not quiescent until the GC
+    sched_pool_request_gc(sp);
+    if (PICC_ready_queue_done(sp->ready))
+        PICC_eventcount_notify_all(&sp->quiescent);
+
+    if (--adapt_fuel <= 0) {
+        adapt_fuel = PICC_SCHED_ADAPT_PERIOD;
+        PICC_handle_flush_ref_counts();
+        PICC_sched_pool_adapt(sp);
+    }
+}
+
+/**
+ * Handles the behavior of secondary real threads in scheduler pool. The
+ * slave runs until the scheduler pool is stopped, then applies the
+ * reference counts it buffered and gives its recycled PiThreads back to
+ * the depot.
  *
  * @param args Arguments containing the scheduler pool and the error stack
  */
@@ -87,79 +626,162 @@ void PICC_sched_pool_slave(PICC_Args *args)
 
     PICC_PiThread *current;
 
-    while(sched_pool->running) {
-        while((current = PICC_ready_queue_pop(sched_pool->ready))) {
-            do {
-                current->proc(sched_pool, current);
-            } while(current->status == PICC_STATUS_CALL);
-
-            if (current->status == PICC_STATUS_BLOCKED) // && safe_choice
-                NEW_ERROR(error, ERR_DEADLOCK);
-        }
+    PICC_sched_pool_pin(sched_pool, args->worker, error);
+    PICC_ready_queue_bind_worker(sched_pool->ready, args->worker);
+    sched_pool_started(sched_pool);
 
-        LOCK_SCHED_POOL(sched_pool);
-        sched_pool->nb_waiting_slaves++;
-        WAIT_SCHED_POOL(sched_pool);
-        sched_pool->nb_waiting_slaves--;
-        RELEASE_SCHED_POOL(sched_pool);
+    while((current = sched_pool_next(sched_pool, args->worker))) {
+        sched_pool_safepoint(sched_pool);
+        sched_pool_run(sched_pool, current, error);
+        sched_pool_unsafe_end(sched_pool);
+        sched_pool_done(sched_pool);
     }
+
+    PICC_handle_flush_ref_counts();
+    PICC_pithread_pool_flush();
 }
 
 /**
- * Handles the main thread in the scheduler pool after the
- * initialisation in the main entry point
+ * Handles the master thread of the scheduler pool, the worker given by
+ * the arguments (0 for the runtime). It runs PiThreads as a slave does;
+ * the master of a serial pool also runs the requested GCs, between two
+ * PiThreads.
  *
- * @param sp the Scheduler pool
- * @param std_gc_fuel the standard garbedge collector fuel
- * @param quick_gc_fuel the quick garbedge collector fuel
- * @param active_factor contributes somehow in the garbedge collection
- * @param error Error stack
+ * @param args Arguments containing the scheduler pool and the error stack
  */
-void PICC_sched_pool_master(PICC_SchedPool *sp, int std_gc_fuel, int quick_gc_fuel, int active_factor, PICC_Error *error)
+void PICC_sched_pool_master(PICC_Args *args)
 {
+    PICC_SchedPool *sp = args->sched_pool;
+    PICC_Error *error = args->error;
+
     PICC_PiThread *current;
-    int gc_fuel = std_gc_fuel;
 
-    while(sp->running) {
-        while((current = PICC_ready_queue_pop(sp->ready))) {
+    PICC_sched_pool_pin(sp, args->worker, error);
+    PICC_ready_queue_bind_worker(sp->ready, args->worker);
+    sched_pool_started(sp);
+
+    while((current = sched_pool_next(sp, args->worker))) {
+        sched_pool_safepoint(sp);
+        sched_pool_run(sp, current, error);
+        sched_pool_unsafe_end(sp);
+        sched_pool_done(sp);
+        if (sp->serial && atomic_load_explicit(&sp->gc_pending, memory_order_relaxed)) {
+            PICC_handle_flush_ref_counts();
+            PICC_sched_pool_collect(sp);
+        }
+    }
+
+    PICC_handle_flush_ref_counts();
+    PICC_pithread_pool_flush();
+}
+
+/**
+ * Runs a requested GC. If the wait queue has grown stw_threshold
+ * PiThreads since the last GC, the world is stopped and every clique is
+ * collected at once by PICC_gc_full. Otherwise, if the wait queue has
+ * grown active_factor times the PiThreads that waited since the last GC,
+ * the cliques of the old ones are collected while the searches find some
+ * and the wait queue is still too large. Each search runs in slices of
+ * PICC_GC_SLICE commitments (see PICC_gc_slice), the collector thread
+ * yields the CPU between two of them; a search always ends before the GC.
+ * The next GC is then requested after std_gc_fuel PiThreads, after
+ * quick_gc_fuel ones if it was unsuccessful or the wait queue is still too
+ * large. The waiters of the quiescence are woken up once it is done.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ */
+void PICC_sched_pool_collect(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    int max_active = PICC_wait_queue_max_active(sp->wait);
+    int limit = max_active * sp->active_factor;
+    int size = PICC_wait_queue_size(sp->wait);
+    bool stop = sp->stw_threshold > 0 && size - sp->last_wait_size >= sp->stw_threshold;
+    PICC_GCResult result = PICC_GC_RECLAIMED;
+    int fuel = sp->std_gc_fuel;
 
-            if (PICC_ready_queue_size(sp->ready) >= 1 && sp->nb_waiting_slaves > 0) {
-                LOCK_SCHED_POOL(sp);
-                SIGNAL_SCHED_POOL(sp, error);
-                RELEASE_SCHED_POOL(sp);
-            }
+    PICC_wait_queue_max_active_reset(sp->wait);
+    if (stop || size > limit) {
+        struct timespec start, end;
+        long runs = 0, cliques = 0, slices = 0;
 
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (stop) {
+            // a serial master is the only mutator, and it is collecting
+            if (!sp->serial)
+                sched_pool_stop_world(sp);
+            cliques = PICC_gc_full(sp, &runs);
+            if (!sp->serial)
+                sched_pool_resume_world(sp);
+            atomic_fetch_add_explicit(&sp->nb_gc_stops, 1, memory_order_relaxed);
+        } else {
             do {
-//		printf("PICC_sched_pool_master :- current->proc(sp, current);\n");
-                current->proc(sp, current);
-            } while(current->status == PICC_STATUS_CALL);
-//	    printf("PICC_sched_pool_master :- current->status != PICC_STATUS_CALL\n");
-
-            if (current->status == PICC_STATUS_BLOCKED) // && safe_choice
-                NEW_ERROR(error, ERR_DEADLOCK);
-
-            gc_fuel--;
-            if(gc_fuel == 0){
-                int max_active = PICC_wait_queue_max_active(sp->wait);
-                PICC_wait_queue_max_active_reset(sp->wait);
-                if ( PICC_wait_queue_size(sp->wait) > max_active * active_factor){
-                    bool gc_ok = PICC_GC2(sp);
-
-                    if (!gc_ok || PICC_wait_queue_size(sp->wait) > max_active * active_factor )
-                        gc_fuel = quick_gc_fuel;
-                    else
-                        gc_fuel = std_gc_fuel;
-                } else {
-                    gc_fuel = std_gc_fuel;
+                result = PICC_gc_slice(sp, PICC_GC_SLICE);
+                slices++;
+                if (result == PICC_GC_PENDING) {
+                    if (!sp->serial)
+                        PICC_low_level_yield();
+                    continue;
                 }
-            }
+                runs++;
+                cliques += result == PICC_GC_RECLAIMED;
+            } while (result == PICC_GC_PENDING
+                     || (result == PICC_GC_RECLAIMED && PICC_wait_queue_size(sp->wait) > limit));
         }
+        clock_gettime(CLOCK_MONOTONIC, &end);
 
-        LOCK_SCHED_POOL(sp);
-        if (sp->nb_waiting_slaves == sp->nb_slaves) {
-            sp->running = false;
-            BROADCAST_SCHED_POOL(sp, error);
+        atomic_fetch_add_explicit(&sp->nb_gc_runs, runs, memory_order_relaxed);
+        atomic_fetch_add_explicit(&sp->nb_gc_cliques, cliques, memory_order_relaxed);
+        atomic_fetch_add_explicit(&sp->nb_gc_slices, slices, memory_order_relaxed);
+        atomic_fetch_add_explicit(&sp->gc_nanos, (end.tv_sec - start.tv_sec) * 1000000000L
+                                  + end.tv_nsec - start.tv_nsec, memory_order_relaxed);
+        if (result != PICC_GC_RECLAIMED || PICC_wait_queue_size(sp->wait) > limit)
+            fuel = sp->quick_gc_fuel;
+    }
+
+    sp->last_wait_size = PICC_wait_queue_size(sp->wait);
+    atomic_store(&sp->gc_fuel, fuel);
+    atomic_store(&sp->gc_pending, false);
+    PICC_eventcount_notify_all(&sp->quiescent);
+}
+
+/**
+ * Handles the collector thread of the scheduler pool: it sleeps until a
+ * GC is requested and runs it, off the workers, until the scheduler pool
+ * is stopped. On Linux its nice value is raised to
+ * PICC_SCHED_COLLECTOR_NICE, so that the workers have the CPUs first.
+ *
+ * @pre sp != NULL
+ * @param sp Scheduler pool
+ */
+void PICC_sched_pool_collector(PICC_SchedPool *sp)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(sp != NULL);
+    #endif
+
+    #ifdef __linux__
+        // the nice value is an attribute of the calling thread on Linux
+        setpriority(PRIO_PROCESS, 0, PICC_SCHED_COLLECTOR_NICE);
+    #endif
+
+    while (atomic_load(&sp->running)) {
+        if (atomic_load(&sp->gc_pending)) {
+            PICC_sched_pool_collect(sp);
+            continue;
+        }
+        unsigned key = PICC_eventcount_prepare(&sp->collect);
+        if (atomic_load(&sp->gc_pending) || !atomic_load(&sp->running)) {
+            PICC_eventcount_cancel(&sp->collect);
+            continue;
         }
-        RELEASE_SCHED_POOL(sp);
+        PICC_eventcount_wait(&sp->collect, key);
     }
+
+    // the reclaimed PiThreads go to the depot
+    PICC_pithread_pool_flush();
 }
@@ -0,0 +1,278 @@
+/**
+ * @file slab.c
+ * Per-worker slab allocator for the small runtime objects.
+ *
+ * Each posix thread owns a cache with one free list per size class, so that
+ * allocating and freeing an object does not synchronise with the other
+ * threads. An object freed by another thread than its owner is pushed on a
+ * lock-free return list of the owner, which the owner takes back as a whole
+ * when its free list is empty.
+ *
+ * A cache refills its slabs itself, so that their pages are first touched,
+ * hence placed, on the NUMA node its thread is pinned to.
+ *
+ * The slabs are never given back to the system: the cache of a posix thread
+ * that terminates becomes an orphan, adopted with its slabs by the next
+ * thread that needs a cache, so that restarting the workers of a runtime
+ * does not add caches. Its objects may still be used (and freed) by the
+ * other threads meanwhile.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <slab_repr.h>
+#include <concurrent.h>
+#include <tools.h>
+
+/**
+ * Object sizes of the size classes.
+ */
+static const size_t class_sizes[PICC_SLAB_NB_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256
+};
+
+/**
+ * Offset of the first object of a slab (the header rounded up).
+ */
+#define SLAB_FIRST_OBJECT ((sizeof(PICC_Slab) + 15) & ~((size_t) 15))
+
+#define COUNT(cache, counter) \
+    atomic_store_explicit(&(cache)->counter, \
+        atomic_load_explicit(&(cache)->counter, memory_order_relaxed) + 1, \
+        memory_order_relaxed);
+
+/**
+ * The cache of the current posix thread.
+ */
+static __thread PICC_SlabCache *local_cache = NULL;
+
+/**
+ * All the caches, for the statistics.
+ */
+static PICC_SlabCache *registry = NULL;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The caches of the terminated posix threads, waiting for a new owner
+ * (protected by the registry lock).
+ */
+static PICC_SlabCache *orphans = NULL;
+
+/**
+ * The key whose destructor makes the cache of a terminating posix thread
+ * an orphan.
+ */
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Returns the size class of the given object size.
+ */
+static int size_class_of(size_t size)
+{
+    int c = 0;
+    while (class_sizes[c] < size)
+        c++;
+    return c;
+}
+
+/**
+ * Makes the cache of a terminating posix thread an orphan.
+ */
+static void orphan_cache(void *cache)
+{
+    PICC_SlabCache *orphan = cache;
+    // a later destructor of the thread needs a cache of its own
+    local_cache = NULL;
+    pthread_mutex_lock(&registry_lock);
+    orphan->next_orphan = orphans;
+    orphans = orphan;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static void create_cache_key()
+{
+    pthread_key_create(&cache_key, orphan_cache);
+}
+
+/**
+ * Returns the cache of the current posix thread, adopting an orphan or
+ * creating it if needed.
+ *
+ * @return The cache, NULL if it could not be allocated
+ */
+static PICC_SlabCache *get_local_cache()
+{
+    if (local_cache != NULL)
+        return local_cache;
+
+    pthread_once(&cache_key_once, create_cache_key);
+
+    pthread_mutex_lock(&registry_lock);
+    PICC_SlabCache *cache = orphans;
+    if (cache != NULL)
+        orphans = cache->next_orphan;
+    pthread_mutex_unlock(&registry_lock);
+
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(PICC_SlabCache));
+        if (cache == NULL)
+            return NULL;
+
+        int c;
+        for (c = 0; c < PICC_SLAB_NB_CLASSES; c++)
+            atomic_init(&cache->classes[c].remote, NULL);
+
+        pthread_mutex_lock(&registry_lock);
+        cache->next = registry;
+        registry = cache;
+        pthread_mutex_unlock(&registry_lock);
+    }
+
+    pthread_setspecific(cache_key, cache);
+    local_cache = cache;
+    return cache;
+}
+
+/**
+ * Gives a new slab to the given size class of the cache.
+ *
+ * @return false if the slab could not be allocated
+ */
+static bool refill(PICC_SlabCache *cache, int size_class)
+{
+    PICC_Slab *slab = aligned_alloc(PICC_SLAB_SIZE, PICC_SLAB_SIZE);
+    if (slab == NULL)
+        return false;
+
+    slab->owner = cache;
+    slab->size_class = size_class;
+    slab->next = cache->slabs;
+    cache->slabs = slab;
+    COUNT(cache, nb_slabs);
+
+    PICC_SlabClass *class = &cache->classes[size_class];
+    class->bump = (char *) slab + SLAB_FIRST_OBJECT;
+    class->end = (char *) slab + PICC_SLAB_SIZE;
+    return true;
+}
+
+/**
+ * Allocates an object of the given size. Small objects come from the slabs
+ * of the current posix thread, bigger ones from malloc.
+ *
+ * @param size Size of the object
+ * @return The object, NULL if the memory is exhausted
+ */
+void *PICC_slab_alloc(size_t size)
+{
+    PICC_SlabCache *cache = get_local_cache();
+    if (cache == NULL)
+        return NULL;
+
+    if (size > PICC_SLAB_MAX_OBJECT) {
+        COUNT(cache, large_allocs);
+        return malloc(size);
+    }
+
+    int size_class = size_class_of(size);
+    PICC_SlabClass *class = &cache->classes[size_class];
+    PICC_SlabObject *object = class->free;
+
+    if (object == NULL) {
+        // take back the objects freed by the other threads
+        if (atomic_load_explicit(&class->remote, memory_order_relaxed) != NULL)
+            object = atomic_exchange_explicit(&class->remote, NULL, memory_order_acquire);
+    }
+
+    if (object != NULL) {
+        class->free = object->next;
+    } else {
+        size_t object_size = class_sizes[size_class];
+        if (class->bump == NULL || class->bump + object_size > class->end) {
+            if (!refill(cache, size_class))
+                return NULL;
+        }
+        object = (PICC_SlabObject *) class->bump;
+        class->bump += object_size;
+    }
+
+    COUNT(cache, allocs);
+    return object;
+}
+
+/**
+ * Frees an object allocated with PICC_slab_alloc.
+ *
+ * @param ptr The object (may be NULL)
+ * @param size Size given to PICC_slab_alloc
+ */
+void PICC_slab_free(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+
+    if (size > PICC_SLAB_MAX_OBJECT) {
+        free(ptr);
+        return;
+    }
+
+    PICC_Slab *slab = (PICC_Slab *) ((uintptr_t) ptr & ~((uintptr_t) PICC_SLAB_SIZE - 1));
+
+    #ifdef CONTRACT_PRE
+        ASSERT(slab->size_class == size_class_of(size));
+    #endif
+
+    PICC_SlabCache *cache = get_local_cache();
+    PICC_SlabObject *object = ptr;
+
+    if (slab->owner == cache) {
+        PICC_SlabClass *class = &cache->classes[slab->size_class];
+        object->next = class->free;
+        class->free = object;
+        COUNT(cache, frees);
+        return;
+    }
+
+    PICC_SlabClass *class = &slab->owner->classes[slab->size_class];
+    PICC_SlabObject *top = atomic_load_explicit(&class->remote, memory_order_relaxed);
+    do {
+        object->next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&class->remote, &top, object,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    if (cache != NULL) {
+        COUNT(cache, frees);
+        COUNT(cache, remote_frees);
+    }
+}
+
+/**
+ * Sums the counters of all the slab caches.
+ *
+ * @param stats Filled with the counters
+ */
+void PICC_slab_stats(PICC_SlabStats *stats)
+{
+    stats->allocs = 0;
+    stats->frees = 0;
+    stats->remote_frees = 0;
+    stats->slabs = 0;
+    stats->large_allocs = 0;
+    stats->caches = 0;
+
+    pthread_mutex_lock(&registry_lock);
+    PICC_SlabCache *cache;
+    for (cache = registry; cache != NULL; cache = cache->next) {
+        stats->allocs += atomic_load_explicit(&cache->allocs, memory_order_relaxed);
+        stats->frees += atomic_load_explicit(&cache->frees, memory_order_relaxed);
+        stats->remote_frees += atomic_load_explicit(&cache->remote_frees, memory_order_relaxed);
+        stats->slabs += atomic_load_explicit(&cache->nb_slabs, memory_order_relaxed);
+        stats->large_allocs += atomic_load_explicit(&cache->large_allocs, memory_order_relaxed);
+        stats->caches++;
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
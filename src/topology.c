@@ -0,0 +1,286 @@
+/**
+ * @file topology.c
+ * CPU and NUMA topology of the host, and placement of the scheduler
+ * threads on it.
+ *
+ * The NUMA nodes are read from sysfs (/sys/devices/system/node), a host
+ * without it is seen as a single node. The allowed CPUs are the affinity
+ * of the process, restricted to the given cpulist if any.
+ *
+ * This project is released under MIT License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <topology_repr.h>
+#include <tools.h>
+
+/**
+ * The NUMA node of the current posix thread, set when it is pinned.
+ */
+static __thread int current_node = 0;
+
+/**
+ * Parses a cpulist, the format of the kernel and of taskset -c (for
+ * instance "0-3,8,10-11"), setting the flags of the listed CPUs. The CPUs
+ * beyond max_cpus are ignored.
+ *
+ * @pre list != NULL && cpus != NULL
+ * @param list Cpulist
+ * @param cpus Flags of the CPUs
+ * @param max_cpus Number of flags
+ * @return false if the list is malformed
+ */
+bool PICC_parse_cpulist(const char *list, bool *cpus, int max_cpus)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(list != NULL);
+        ASSERT(cpus != NULL);
+    #endif
+
+    const char *p = list;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+            p = end;
+        }
+
+        long cpu;
+        for (cpu = first; cpu <= last && cpu < max_cpus; cpu++)
+            cpus[cpu] = true;
+
+        if (*p == ',')
+            p++;
+        else if (*p != '\0' && *p != '\n')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Reads the node of each CPU from sysfs. The CPUs of no node are left on
+ * node 0.
+ *
+ * @param node_of Node of each CPU, PICC_MAX_CPUS entries
+ */
+static void read_nodes(int *node_of)
+{
+    char path[64];
+    char line[8192];
+    bool cpus[PICC_MAX_CPUS];
+    int node, cpu;
+
+    for (node = 0; node < PICC_MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path, "r");
+        if (file == NULL)
+            continue; // the node numbers may have holes
+
+        for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++)
+            cpus[cpu] = false;
+        if (fgets(line, sizeof(line), file) != NULL
+            && PICC_parse_cpulist(line, cpus, PICC_MAX_CPUS)) {
+            for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++) {
+                if (cpus[cpu])
+                    node_of[cpu] = node;
+            }
+        }
+        fclose(file);
+    }
+}
+
+/**
+ * Reads the allowed CPUs of the process.
+ *
+ * @param allowed Flags of the CPUs, PICC_MAX_CPUS entries
+ */
+static void read_allowed(bool *allowed)
+{
+    cpu_set_t set;
+    int cpu;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (cpu = 0; cpu < PICC_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+            allowed[cpu] = CPU_ISSET(cpu, &set);
+    } else {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++)
+            allowed[cpu] = cpu < online;
+    }
+}
+
+/**
+ * Creates the topology of the CPUs the scheduler threads may run on.
+ *
+ * @param cpus Cpulist restricting the CPUs of the process, NULL for all
+ * @param error Error stack, ERR_INVALID_CPULIST if the list is malformed
+ * or leaves no CPU
+ * @return Created topology
+ */
+PICC_Topology *PICC_create_topology(const char *cpus, PICC_Error *error)
+{
+    bool allowed[PICC_MAX_CPUS];
+    bool listed[PICC_MAX_CPUS];
+    int node_of[PICC_MAX_CPUS];
+    int cpu, node, nb_cpus = 0;
+
+    read_allowed(allowed);
+    if (cpus != NULL) {
+        for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++)
+            listed[cpu] = false;
+        if (!PICC_parse_cpulist(cpus, listed, PICC_MAX_CPUS)) {
+            NEW_ERROR(error, ERR_INVALID_CPULIST);
+            return NULL;
+        }
+        for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++)
+            allowed[cpu] = allowed[cpu] && listed[cpu];
+    }
+
+    for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++) {
+        node_of[cpu] = 0;
+        if (allowed[cpu])
+            nb_cpus++;
+    }
+    if (nb_cpus == 0) {
+        NEW_ERROR(error, ERR_INVALID_CPULIST);
+        return NULL;
+    }
+    read_nodes(node_of);
+
+    PICC_ALLOC(topo, PICC_Topology, error) {
+        topo->cpus = malloc(nb_cpus * sizeof(int));
+        topo->nodes = malloc(nb_cpus * sizeof(int));
+        if (topo->cpus == NULL || topo->nodes == NULL) {
+            NEW_ERROR(error, ERR_OUT_OF_MEMORY);
+            PICC_free_topology(topo);
+            return NULL;
+        }
+
+        topo->nb_cpus = 0;
+        topo->nb_nodes = 0;
+        for (node = 0; node < PICC_MAX_NODES; node++) {
+            int first = topo->nb_cpus;
+            for (cpu = 0; cpu < PICC_MAX_CPUS; cpu++) {
+                if (allowed[cpu] && node_of[cpu] == node) {
+                    topo->cpus[topo->nb_cpus] = cpu;
+                    topo->nodes[topo->nb_cpus] = node;
+                    topo->nb_cpus++;
+                }
+            }
+            if (topo->nb_cpus > first)
+                topo->nb_nodes++;
+        }
+    }
+    return topo;
+}
+
+void PICC_free_topology(PICC_Topology *topo)
+{
+    if (topo != NULL) {
+        free(topo->cpus);
+        free(topo->nodes);
+        free(topo);
+    }
+}
+
+/**
+ * Returns the CPU of the given worker. The workers are spread over the
+ * allowed CPUs node by node, and wrap around when there are more workers
+ * than CPUs.
+ *
+ * @pre topo != NULL && worker >= 0
+ * @param topo Topology
+ * @param worker Index of the worker
+ * @return CPU of the worker
+ */
+int PICC_topology_worker_cpu(PICC_Topology *topo, int worker)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(topo != NULL);
+        ASSERT(worker >= 0);
+    #endif
+
+    return topo->cpus[worker % topo->nb_cpus];
+}
+
+/**
+ * Returns the NUMA node of the given worker.
+ *
+ * @pre topo != NULL && worker >= 0
+ * @param topo Topology
+ * @param worker Index of the worker
+ * @return Node of the worker
+ */
+int PICC_topology_worker_node(PICC_Topology *topo, int worker)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(topo != NULL);
+        ASSERT(worker >= 0);
+    #endif
+
+    return topo->nodes[worker % topo->nb_cpus];
+}
+
+/**
+ * Pins the current posix thread as the given worker: to the CPU of the
+ * worker, or to all the allowed CPUs of its node. The node becomes the
+ * current node of the thread, from which it allocates.
+ *
+ * @pre topo != NULL && worker >= 0
+ * @param topo Topology
+ * @param mode Pinning mode
+ * @param worker Index of the worker
+ * @return false if the affinity could not be set
+ */
+bool PICC_topology_pin(PICC_Topology *topo, PICC_PinMode mode, int worker)
+{
+    #ifdef CONTRACT_PRE
+        ASSERT(topo != NULL);
+        ASSERT(worker >= 0);
+    #endif
+
+    int i = worker % topo->nb_cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    current_node = topo->nodes[i];
+    switch (mode) {
+    case PICC_PIN_NONE:
+        return true;
+    case PICC_PIN_CPU:
+        CPU_SET(topo->cpus[i], &set);
+        break;
+    case PICC_PIN_NODE: {
+        int j;
+        for (j = 0; j < topo->nb_cpus; j++) {
+            if (topo->nodes[j] == topo->nodes[i])
+                CPU_SET(topo->cpus[j], &set);
+        }
+        break;
+    }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * Returns the NUMA node of the current posix thread: the node it was
+ * pinned to, 0 if it was not pinned.
+ */
+int PICC_current_node()
+{
+    return current_node;
+}
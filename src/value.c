@@ -222,7 +222,7 @@ void PICC_Bool_not( PICC_Value *res, PICC_Value *v)
 
 PICC_Value * PICC_create_int_value(int data)
 {
-    PICC_ALLOC_CRASH(val, PICC_IntValue) {
+    PICC_SLAB_ALLOC_CRASH(val, PICC_IntValue) {
         val->header = MAKE_HEADER(TAG_INTEGER, 0);
         val->data = data;
     }
@@ -236,7 +236,7 @@ PICC_Value * PICC_create_int_value(int data)
 
 PICC_IntValue * PICC_free_int(PICC_IntValue * val)
 {
-    free(val);
+    PICC_SLAB_FREE(val, PICC_IntValue);
     val = NULL;
     return val;
 }
@@ -565,7 +565,7 @@ bool PICC_copy_tuple(PICC_Value **to, PICC_TupleValue* from){
 
 void PICC_string_handle_reclaimer(PICC_StringHandle *handle, PICC_Error* e){
     free(handle->data);
-    //PICC_lock_free(handle->lock); see comment in gc.c - handle_dec_ref_count
+    PICC_lock_free(handle->lock);
     free(handle);
 }
 
@@ -577,7 +577,7 @@ PICC_StringHandle *PICC_create_string_handle(char *string)
     #endif
 
     PICC_ALLOC_CRASH(val, PICC_StringHandle) {
-        val->global_rc = 1;
+        atomic_init(&val->global_rc, 1);
 	val->lock = PICC_create_lock(NULL);
 	val->reclaim= (PICC_Reclaimer)PICC_string_handle_reclaimer;
         val->data = malloc(sizeof(char)*strlen(string) +1);
@@ -10,9 +10,7 @@
 #include <stdlib.h>
 #include <atomic_repr.h>
 #include <error.h>
-
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
+#include <tests.h>
 
 void test_creation(PICC_Error *error)
 {
@@ -9,14 +9,13 @@
  */
 
 #include <stdlib.h>
+#include <pthread.h>
 #include <gc.h>
 #include <pi_thread_repr.h>
 #include <channel_repr.h>
 #include <value_repr.h>
 #include <knownset_repr.h>
-
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
+#include <tests.h>
 
 
 /**
@@ -63,6 +62,103 @@ void test_global_reference(PICC_Error *error)
     ASSERT(handle->global_rc == 1);
 
     PICC_handle_dec_ref_count(&handle);
+    ASSERT(handle == NULL);
+}
+
+/**
+ * Test : deferred global reference
+ *
+ * The decrements are buffered until flushed, an increment cancels a
+ * buffered decrement or is applied at once, and a full buffer is flushed.
+ */
+void test_deferred_reference(PICC_Error *error)
+{
+    PICC_Handle *handle = (PICC_Handle *) PICC_create_channel();
+    PICC_Channel *chans[PICC_RC_BUFFER_SIZE];
+    int i;
+
+    PICC_handle_incr_ref_count(handle);
+    PICC_handle_incr_ref_count(handle);
+    PICC_handle_defer_dec_ref_count(handle);
+    PICC_handle_defer_dec_ref_count(handle);
+    ASSERT(handle->global_rc == 3);
+    PICC_handle_defer_incr_ref_count(handle);
+    ASSERT(handle->global_rc == 3);
+    PICC_handle_flush_ref_counts();
+    ASSERT(handle->global_rc == 2);
+
+    // nothing to cancel
+    PICC_handle_defer_incr_ref_count(handle);
+    ASSERT(handle->global_rc == 3);
+
+    for (i = 0; i < PICC_RC_BUFFER_SIZE; i++) {
+        chans[i] = PICC_create_channel();
+        chans[i]->global_rc = 2;
+    }
+    for (i = 0; i < PICC_RC_BUFFER_SIZE - 1; i++)
+        PICC_handle_defer_dec_ref_count((PICC_Handle *) chans[i]);
+    ASSERT(chans[0]->global_rc == 2);
+    PICC_handle_defer_dec_ref_count((PICC_Handle *) chans[i]);
+    for (i = 0; i < PICC_RC_BUFFER_SIZE; i++)
+        ASSERT(chans[i]->global_rc == 1);
+
+    // the last references are dropped by a single flush
+    for (i = 0; i < PICC_RC_BUFFER_SIZE - 1; i++)
+        PICC_handle_defer_dec_ref_count((PICC_Handle *) chans[i]);
+    for (i = 0; i < 3; i++)
+        PICC_handle_defer_dec_ref_count(handle);
+    PICC_handle_flush_ref_counts();
+    PICC_handle_dec_ref_count((PICC_Handle **) &chans[PICC_RC_BUFFER_SIZE - 1]);
+    ASSERT(chans[PICC_RC_BUFFER_SIZE - 1] == NULL);
+}
+
+#define NB_REF_THREADS 4
+#define NB_REF_ROUNDS 100000
+
+/**
+ * Takes and drops a reference to the handle NB_REF_ROUNDS times, then
+ * drops the one it was given.
+ */
+static void *ref_worker(void *arg)
+{
+    PICC_Handle *handle = arg;
+    int i;
+    for (i = 0; i < NB_REF_ROUNDS; i++) {
+        PICC_Handle *ref = handle;
+        PICC_handle_incr_ref_count(ref);
+        PICC_handle_dec_ref_count(&ref);
+    }
+    PICC_handle_dec_ref_count(&handle);
+    return NULL;
+}
+
+/**
+ * Test : concurrent global reference
+ *
+ * Threads sharing a channel and a string update their reference counts
+ * without locks: no update is lost, and the last reference dropped
+ * reclaims them.
+ */
+void test_concurrent_reference(PICC_Error *error)
+{
+    PICC_Handle *handles[2];
+    pthread_t threads[NB_REF_THREADS];
+    int h, i;
+
+    handles[0] = (PICC_Handle *) PICC_create_channel();
+    handles[1] = (PICC_Handle *) PICC_create_string_handle("shared");
+    for (h = 0; h < 2; h++) {
+        for (i = 0; i < NB_REF_THREADS; i++) {
+            PICC_handle_incr_ref_count(handles[h]);
+            ASSERT(pthread_create(&threads[i], NULL, ref_worker, handles[h]) == 0);
+        }
+        for (i = 0; i < NB_REF_THREADS; i++)
+            pthread_join(threads[i], NULL);
+
+        ASSERT(handles[h]->global_rc == 1);
+        PICC_handle_dec_ref_count(&handles[h]);
+        ASSERT(handles[h] == NULL);
+    }
 }
 
 
@@ -75,6 +171,8 @@ void PICC_test_channel()
     ALLOC_ERROR(error);
     test_create_channel(&error);
     test_global_reference(&error);
+    test_deferred_reference(&error);
+    test_concurrent_reference(&error);
 
     if (HAS_ERROR(error))
         PRINT_ERROR(&error);
@@ -16,17 +16,14 @@
 #include <commit_repr.h>
 #include <value_repr.h>
 #include <tools.h>
+#include <tests.h>
 
 #define INIT_COMMIT(commit, pt, ch, pc) \
     commit->thread = pt; \
     commit->cont_pc = pc; \
-    commit->clock = pt->clock; \
-    commit->clockval = PICC_atomic_int_get(pt->clock->val); \
+    commit->clockval = PICC_pithread_clock(pt); \
     commit->channel = ch;
 
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
-
 PICC_Value func(PICC_PiThread* a) {
     printf("my eval func !\n");
     PICC_Value v;
@@ -71,7 +68,6 @@ void test_register_incommits(PICC_Error* error)
 void test_commitlists(PICC_Error *error)
 {
     PICC_Commit *c, *c2, *c3;
-    PICC_CommitListElement *clistelem;
     PICC_CommitList *clist;
 
 
@@ -92,16 +88,13 @@ void test_commitlists(PICC_Error *error)
 
     //check pithread, channel first
     pt = PICC_create_pithread(1, 1, 1);
-    pt->clock = PICC_create_clock(error);
     ch = PICC_create_channel(error);
     ASSERT_NO_ERROR();
     eval = func;
     cont_pc = 10;
 
     INIT_COMMIT(c, pt, ch, cont_pc);
-    PICC_MALLOC(c->content.out, PICC_OutCommit, error);
-    ASSERT_NO_ERROR();
-    c->content.out->eval_func = eval;
+    c->content.out.eval_func = eval;
     c->type = PICC_OUT_COMMIT;
 
     // init c2
@@ -112,16 +105,13 @@ void test_commitlists(PICC_Error *error)
 
     //check pithread, channel first
     pt2 = PICC_create_pithread(1, 1, 1);
-    pt2->clock = PICC_create_clock(error);
     ch2 = PICC_create_channel(error);
     ASSERT_NO_ERROR();
     eval2 = func;
     cont_pc2 = 20;
 
     INIT_COMMIT(c2, pt2, ch2, cont_pc2);
-    PICC_MALLOC(c2->content.out, PICC_OutCommit, error);
-    ASSERT_NO_ERROR();
-    c2->content.out->eval_func = eval2;
+    c2->content.out.eval_func = eval2;
     c2->type = PICC_OUT_COMMIT;
 
     // init c3
@@ -132,29 +122,23 @@ void test_commitlists(PICC_Error *error)
 
     //check pithread, channel first
     pt3 = PICC_create_pithread(1, 1, 1);
-    pt3->clock = PICC_create_clock(error);
     ch3 = PICC_create_channel(error);
     ASSERT_NO_ERROR();
     refvar = 42;
     cont_pc3 = 30;
 
     INIT_COMMIT(c3, pt3, ch3, cont_pc3);
-    PICC_MALLOC(c3->content.in, PICC_InCommit, error);
-    ASSERT_NO_ERROR();
-    c3->content.in->refvar = refvar;
+    c3->content.in.refvar = refvar;
     c3->type = PICC_IN_COMMIT;
 
 
 
-    // CREATING COMMITLIST ELEMENT
-    clistelem = PICC_create_commit_list_element(c, error);
-    ASSERT_NO_ERROR();
-    ASSERT(clistelem != NULL);
-
     // CREATING COMMITLIST
     clist = PICC_create_commit_list(error);
     ASSERT_NO_ERROR();
     ASSERT(clist != NULL);
+    // a pi-thread side list, the channel side links are used below
+    PICC_init_commit_list(clist, PICC_COMMIT_THREAD_LINK);
 
     c->cont_pc = 1;
     c2->cont_pc = 2;
@@ -167,6 +151,7 @@ void test_commitlists(PICC_Error *error)
     ASSERT_NO_ERROR();
     ASSERT(clist->head->commit == c);
     ASSERT(clist->tail->commit == c);
+    ASSERT(clist->head == &c->links[PICC_COMMIT_THREAD_LINK]);
     ASSERT(clist->size == 1)
 
     PICC_commit_list_add(clist, c2, error);
@@ -203,10 +188,20 @@ void test_commitlists(PICC_Error *error)
     PICC_Commit *fetched_in_commit = PICC_fetch_input_commitment(c3->channel);
     ASSERT(fetched_in_commit == c3);
 
-    free(c);
-    free(c2);
-    free(c3);
-    free(clistelem);
+    // the pi-thread side list is left untouched
+    ASSERT(clist->size == 3);
+    ASSERT(clist->head->next->next->commit == c3);
+
+    PICC_commit_list_remove(clist, c2);
+    ASSERT(clist->size == 2);
+    ASSERT(clist->head->next->commit == c3);
+    PICC_commit_list_remove(clist, c);
+    PICC_commit_list_remove(clist, c3);
+    ASSERT(PICC_commit_list_is_empty(clist));
+
+    PICC_reclaim_commitment(c);
+    PICC_reclaim_commitment(c2);
+    PICC_reclaim_commitment(c3);
     free(clist);
 }
 
@@ -0,0 +1,316 @@
+/**
+ * @file gc_test.c
+ * Unit testing of the clique collection.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdlib.h>
+#include <gc_repr.h>
+#include <scheduler_repr.h>
+#include <queue_repr.h>
+#include <pi_thread_repr.h>
+#include <channel_repr.h>
+#include <commit_repr.h>
+#include <tools.h>
+#include <tests.h>
+
+/**
+ * Creates a pi-thread waiting for an input on each of the given channels,
+ * in the wait queue of the scheduler pool.
+ */
+static PICC_PiThread *waiting(PICC_SchedPool *sp, PICC_Channel **chans, int nb_chans)
+{
+    PICC_PiThread *pt = PICC_create_pithread(1, 0, 0);
+    int i;
+    for (i = 0; i < nb_chans; i++)
+        PICC_register_input_commitment(pt, chans[i], 0, 1);
+    pt->status = PICC_STATUS_WAIT;
+    PICC_wait_queue_push(sp->wait, pt);
+    return pt;
+}
+
+/**
+ * Creates a channel known by refs pi-threads.
+ */
+static PICC_Channel *known_by(int refs)
+{
+    PICC_Channel *ch = PICC_create_channel();
+    ch->global_rc = refs;
+    return ch;
+}
+
+/**
+ * Returns whether the lock is free.
+ */
+static bool unlocked(PICC_Lock *lock)
+{
+    if (!(PICC_try_acquire(lock)))
+        return false;
+    PICC_release(lock);
+    return true;
+}
+
+/**
+ * Test : clique search \n
+ * The pi-threads sharing a channel, or linked by a chain of channels,
+ * are a clique; a channel known by another pi-thread or a lock taken
+ * abandons the search and leaves everything unlocked in the wait queue.
+ */
+void test_gc_clique(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(1, error);
+    ASSERT_NO_ERROR();
+    PICC_Channel *chans[2];
+
+    // three pi-threads on one channel
+    chans[0] = known_by(3);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+    ASSERT(unlocked(chans[0]->lock));
+
+    // a chain of two channels, the middle one waits on both
+    chans[0] = known_by(2);
+    chans[1] = known_by(2);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 2);
+    waiting(sp, chans + 1, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+    ASSERT(unlocked(chans[0]->lock) && unlocked(chans[1]->lock));
+
+    // a third pi-thread still knows the channel
+    chans[0] = known_by(3);
+    PICC_PiThread *a = waiting(sp, chans, 1);
+    PICC_PiThread *b = waiting(sp, chans, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(!PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 2);
+    ASSERT(unlocked(chans[0]->lock) && unlocked(a->lock) && unlocked(b->lock));
+
+    // the last reference is gone, but b is locked
+    chans[0]->global_rc = 2;
+    PICC_acquire(b->lock);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(!PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 2);
+    PICC_release(b->lock);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+
+    PICC_free_sched_pool(sp);
+}
+
+/**
+ * Test : large clique \n
+ * The buffers of the collector grow to the largest clique and are reused
+ * by the next searches.
+ */
+void test_gc_large_clique(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(1, error);
+    ASSERT_NO_ERROR();
+    int size = 4 * PICC_init_clique_max_size;
+    int i;
+
+    PICC_Channel *ch = known_by(size);
+    for (i = 0; i < size; i++)
+        waiting(sp, &ch, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_GC2(sp));
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+    PICC_GCScratch *scratch = sp->gc_scratch;
+    ASSERT(scratch != NULL);
+    ASSERT(scratch->nb_members == size);
+    ASSERT(scratch->members_max >= size);
+    ASSERT(scratch->visited.size == size + 1);
+
+    ch = known_by(2);
+    waiting(sp, &ch, 1);
+    waiting(sp, &ch, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_GC2(sp));
+    ASSERT(sp->gc_scratch == scratch);
+    ASSERT(scratch->nb_members == 2);
+    ASSERT(scratch->visited.size == 3);
+
+    PICC_free_sched_pool(sp);
+    PICC_pithread_pool_clear();
+}
+
+/**
+ * Test : incremental search \n
+ * A search bounded to one commitment per slice keeps its state between the
+ * slices; a contended pi-thread only delays its channel, retried once the
+ * lock is free. Between two slices the members are unlocked in the wait
+ * queue, and a member chosen by an awakener or ended meanwhile abandons
+ * the search.
+ */
+void test_gc_incremental(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(1, error);
+    ASSERT_NO_ERROR();
+    PICC_Channel *chans[2];
+    PICC_GCResult result;
+    int slices = 0;
+
+    // a chain of two channels walked one commitment at a time
+    chans[0] = known_by(2);
+    chans[1] = known_by(2);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 2);
+    waiting(sp, chans + 1, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    while ((result = PICC_gc_slice(sp, 1)) == PICC_GC_PENDING) {
+        ASSERT(sp->gc_scratch->searching);
+        slices++;
+    }
+    ASSERT(result == PICC_GC_RECLAIMED);
+    ASSERT(slices > 1);
+    ASSERT(!sp->gc_scratch->searching);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+    ASSERT(unlocked(chans[0]->lock) && unlocked(chans[1]->lock));
+
+    // b is locked: the channel is retried, a stays a member meanwhile
+    chans[0] = known_by(2);
+    PICC_PiThread *a = waiting(sp, chans, 1);
+    PICC_PiThread *b = waiting(sp, chans, 1);
+    PICC_acquire(b->lock);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_PENDING);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_PENDING);
+    ASSERT(sp->gc_scratch->nb_retries == 1 && sp->gc_scratch->stalls == 1);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 2);
+    ASSERT(unlocked(a->lock) && unlocked(chans[0]->lock));
+    PICC_release(b->lock);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_RECLAIMED);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+
+    // a is chosen between two slices: the search is abandoned
+    chans[0] = known_by(2);
+    a = waiting(sp, chans, 1);
+    b = waiting(sp, chans, 1);
+    PICC_acquire(b->lock);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_PENDING);
+    ASSERT(PICC_can_awake(a, a->commits->head->commit) == PICC_VALID_COMMIT);
+    PICC_release(b->lock);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_ABANDONED);
+    ASSERT(!sp->gc_scratch->searching);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 2);
+    ASSERT(unlocked(a->lock) && unlocked(b->lock) && unlocked(chans[0]->lock));
+    a->commit = NULL;
+
+    // b ends between two slices: its block is left to the collector
+    PICC_acquire(a->lock);
+    PICC_wait_queue_max_active_reset(sp->wait);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_PENDING);
+    ASSERT(atomic_load(&b->gc_pin) == PICC_GC_PIN_PAUSED);
+    ASSERT(PICC_wait_queue_fetch(sp->wait, b) == b);
+    PICC_reclaim_pi_thread(b);
+    ASSERT(atomic_load(&b->gc_pin) == PICC_GC_PIN_RECLAIMED);
+    PICC_release(a->lock);
+    ASSERT(PICC_gc_slice(sp, PICC_GC_SLICE) == PICC_GC_ABANDONED);
+    ASSERT(atomic_load(&b->gc_pin) == PICC_GC_PIN_NONE);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 1);
+    ASSERT(unlocked(a->lock) && unlocked(chans[0]->lock));
+
+    PICC_free_sched_pool(sp);
+}
+
+/**
+ * Test : full collection \n
+ * With the world stopped, every clique of the wait queue is reclaimed at
+ * once, whichever zone its pi-threads are in; the components known
+ * elsewhere stay in the wait queue.
+ */
+void test_gc_full(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(1, error);
+    ASSERT_NO_ERROR();
+    PICC_Channel *chans[2];
+
+    // a clique on one channel, in the old zone
+    chans[0] = known_by(2);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 1);
+    PICC_wait_queue_max_active_reset(sp->wait);
+
+    // a chain of two channels, in the active zone
+    chans[0] = known_by(2);
+    chans[1] = known_by(2);
+    waiting(sp, chans, 1);
+    waiting(sp, chans, 2);
+    waiting(sp, chans + 1, 1);
+
+    // a component whose second channel is known elsewhere
+    chans[0] = known_by(2);
+    chans[1] = known_by(3);
+    PICC_PiThread *a = waiting(sp, chans, 1);
+    PICC_PiThread *b = waiting(sp, chans, 2);
+    PICC_PiThread *c = waiting(sp, chans + 1, 1);
+
+    long components;
+    ASSERT(PICC_gc_full(sp, &components) == 2);
+    ASSERT(components == 3);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 3);
+    ASSERT(unlocked(a->lock) && unlocked(b->lock) && unlocked(c->lock));
+    ASSERT(PICC_gc_full(sp, &components) == 0);
+
+    chans[1]->global_rc = 2;
+    ASSERT(PICC_gc_full(sp, &components) == 1);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 0);
+
+    PICC_free_sched_pool(sp);
+}
+
+/**
+ * Test : full collection with a running pi-thread \n
+ * Two waiting pi-threads each share a channel with a running one: both
+ * components are live, including the second one, which meets the running
+ * pi-thread after the first.
+ */
+void test_gc_full_running(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(1, error);
+    ASSERT_NO_ERROR();
+    PICC_Channel *chans[2];
+
+    chans[0] = known_by(2);
+    chans[1] = known_by(2);
+    PICC_PiThread *running = PICC_create_pithread(1, 0, 0);
+    PICC_register_input_commitment(running, chans[0], 0, 1);
+    PICC_register_input_commitment(running, chans[1], 0, 1);
+    waiting(sp, chans, 1);
+    waiting(sp, chans + 1, 1);
+
+    long components;
+    ASSERT(PICC_gc_full(sp, &components) == 0);
+    ASSERT(components == 2);
+    ASSERT(PICC_wait_queue_size(sp->wait) == 2);
+
+    PICC_reclaim_pi_thread(running);
+    PICC_free_sched_pool(sp);
+}
+
+/**
+ * Runs all GC tests.
+ */
+void PICC_test_gc()
+{
+    ALLOC_ERROR(error);
+    test_gc_clique(&error);
+    test_gc_large_clique(&error);
+    test_gc_incremental(&error);
+    test_gc_full(&error);
+    test_gc_full_running(&error);
+
+    if (HAS_ERROR(error))
+        PRINT_ERROR(&error);
+}
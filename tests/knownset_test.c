@@ -12,9 +12,7 @@
 #include <channel_repr.h>
 #include <knownset_repr.h>
 #include <error.h>
-
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
+#include <tests.h>
 
 
 void test_knownset_creation(PICC_Error *error)
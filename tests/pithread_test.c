@@ -10,10 +10,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <pi_thread_repr.h>
-
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
+#include <queue_repr.h>
+#include <channel_repr.h>
+#include <commit_repr.h>
+#include <scheduler_repr.h>
+#include <runtime_repr.h>
+#include <tests.h>
 
 /**
  * Test : PICC_create_pithread \n
@@ -27,13 +31,211 @@ void test_create_pithread(PICC_Error *error)
     ASSERT(p != NULL);
 }
 
+/**
+ * Test : single block layout of a PiThread \n
+ * The environment, the knowns content and the enabled flags live in the
+ * cache-line aligned block of the pi-thread, and the knowns set can grow
+ * out of it.
+ */
+void test_pithread_block(PICC_Error *error)
+{
+    PICC_PiThread *p = PICC_create_pithread(3, 2, 4);
+    unsigned char *begin = (unsigned char *) p;
+    unsigned char *end = begin + p->block_size;
+    int i;
+
+    ASSERT((uintptr_t) p % PICC_CACHE_LINE_SIZE == 0);
+    ASSERT(p->block_size % PICC_CACHE_LINE_SIZE == 0);
+    ASSERT((unsigned char *) p->env > begin && (unsigned char *) (p->env + 3) <= end);
+    ASSERT((unsigned char *) p->enabled > begin && (unsigned char *) (p->enabled + 4) <= end);
+    ASSERT((unsigned char *) p->knowns->content > begin);
+    ASSERT(p->knowns->embedded_content);
+
+    int nb_chans = p->knowns->max_size + 1;
+    PICC_KnownValue *chans[nb_chans];
+    for (i = 0; i < nb_chans; i++) {
+        chans[i] = (PICC_KnownValue *) PICC_create_channel_value(PICC_create_channel());
+        PICC_knownset_add(p->knowns, chans[i]);
+    }
+    ASSERT(!p->knowns->embedded_content);
+    ASSERT(PICC_knownset_size(p->knowns) == nb_chans);
+    for (i = 0; i < nb_chans; i++) {
+        ASSERT(PICC_knownset_get_element(p->knowns, chans[i]) != NULL);
+    }
+
+    PICC_PiThread *q = PICC_create_pithread(0, 0, 0);
+    ASSERT(q->env == NULL);
+    ASSERT(q->enabled == NULL);
+
+    PICC_reclaim_pi_thread(p);
+    PICC_reclaim_pi_thread(q);
+}
+
+/**
+ * Test : recycling pool \n
+ * A reclaimed PiThread is reused, reset, by the next creation of the same
+ * shape only, and the pre-warmed ones are used before allocating.
+ */
+void test_pithread_pool(PICC_Error *error)
+{
+    PICC_pithread_pool_clear();
+
+    PICC_PiThread *p = PICC_create_pithread(2, 1, 1);
+    p->pc = 3;
+    p->status = PICC_STATUS_WAIT;
+    p->enabled[0] = true;
+    atomic_store(&p->clock, 5);
+    PICC_KnownValue *chans[SET_INIT_MAXSIZE + 1];
+    int i;
+    for (i = 0; i < SET_INIT_MAXSIZE + 1; i++) {
+        chans[i] = (PICC_KnownValue *) PICC_create_channel_value(PICC_create_channel());
+        PICC_knownset_add(p->knowns, chans[i]);
+    }
+    PICC_acquire(p->lock); // the GC reclaims locked pi-threads
+    PICC_reclaim_pi_thread(p);
+
+    PICC_PiThread *other = PICC_create_pithread(3, 1, 1);
+    ASSERT(other != p);
+    PICC_PiThread *q = PICC_create_pithread(2, 1, 1);
+    ASSERT(q == p);
+    ASSERT(q->pc == PICC_DEFAULT_ENTRY_LABEL);
+    ASSERT(q->status == PICC_STATUS_RUN);
+    ASSERT(q->enabled[0] == false);
+    ASSERT(PICC_pithread_clock(q) > 5);
+    ASSERT(PICC_knownset_size(q->knowns) == 0);
+    ASSERT(q->knowns->embedded_content);
+    ASSERT(PICC_try_acquire(q->lock));
+    PICC_release(q->lock);
+
+    PICC_pithread_pool_prewarm(4, 0, 2, 8);
+    PICC_PiThread *warm[8];
+    for (i = 0; i < 8; i++) {
+        warm[i] = PICC_create_pithread(4, 0, 2);
+        ASSERT(warm[i]->env_length == 4);
+        ASSERT(warm[i]->enabled_length == 2);
+    }
+    for (i = 0; i < 8; i++) {
+        PICC_reclaim_pi_thread(warm[i]);
+    }
+    // LIFO reuse of the pool
+    ASSERT(PICC_create_pithread(4, 0, 2) == warm[7]);
+
+    PICC_pithread_pool_clear();
+}
+
+/**
+ * Test : ended choice \n
+ * A PiThread woken on one channel of a choice withdraws its other
+ * commitment when it ends: once it is freed, the other channel is fetched
+ * without meeting it.
+ */
+void test_pithread_end_choice(PICC_Error *error)
+{
+    PICC_pithread_pool_clear();
+
+    // the pool has no room for another shape: the PiThread will be freed
+    int i;
+    for (i = 0; i < PICC_PITHREAD_POOL_SHAPES; i++)
+        PICC_reclaim_pi_thread(PICC_create_pithread(i + 2, 0, 0));
+
+    PICC_Channel *chans[2] = { PICC_create_channel(), PICC_create_channel() };
+    PICC_PiThread *pt = PICC_create_pithread(1, 0, 0);
+    PICC_register_input_commitment(pt, chans[0], 0, 1);
+    PICC_register_input_commitment(pt, chans[1], 0, 1);
+
+    PICC_Commit *commit = PICC_fetch_input_commitment(chans[0]);
+    ASSERT(commit != NULL && commit->thread == pt);
+    PICC_process_end(pt, PICC_STATUS_ENDED);
+    ASSERT(chans[1]->incommits->size == 0);
+    PICC_reclaim_pi_thread(pt);
+    ASSERT(PICC_fetch_input_commitment(chans[1]) == NULL);
+
+    PICC_pithread_pool_clear();
+}
+
+/**
+ * Number of PiThreads chain_proc has still to spawn.
+ */
+static int chain_left;
+
+/**
+ * Spawns the next PiThread of the chain, then ends.
+ */
+static void chain_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    if (--chain_left > 0) {
+        PICC_PiThread *next = PICC_create_pithread(0, 0, 0);
+        next->proc = chain_proc;
+        PICC_ready_queue_add(sp->ready, next);
+    }
+    PICC_process_end(pt, PICC_STATUS_ENDED);
+}
+
+/**
+ * Test : steady spawning \n
+ * The PiThreads that end are reclaimed by the worker, the ones spawned
+ * afterwards reuse them: a long chain of spawns hardly allocates.
+ */
+void test_pithread_pool_steady(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.serial = true;
+
+    PICC_Runtime *rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    // as the runtime does for its entry PiThreads
+    PICC_pithread_pool_prewarm(0, 0, 0, PICC_PITHREAD_POOL_PREWARM);
+    long start = PICC_pithread_nb_allocs();
+    chain_left = 10000;
+    PICC_runtime_spawn(rt, chain_proc, 0, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+    ASSERT(chain_left == 0);
+    ASSERT(PICC_pithread_nb_allocs() == start);
+    PICC_runtime_shutdown(rt);
+}
+
 /**
  * Runs all PiThread tests.
  */
+void test_pithread_yield(PICC_Error *error)
+{
+    PICC_SchedPool *sp = PICC_create_sched_pool(2, error);
+    PICC_PiThread *pts[8];
+    int i;
+    ASSERT_NO_ERROR();
+    ASSERT(sp->fuel == PICC_FUEL_INIT);
+
+    sp->fuel = 64;
+    PICC_ready_queue_bind_worker(sp->ready, 0);
+    ASSERT(PICC_sched_pool_fuel(sp) == 64);
+
+    // a yielding thread goes to the end of the ready queue
+    for (i = 0; i < 8; i++) {
+        pts[i] = PICC_create_pithread(1, 1, 1);
+        pts[i]->status = PICC_STATUS_CALL;
+        PICC_yield(sp, pts[i]);
+        ASSERT(pts[i]->status == PICC_STATUS_RUN);
+    }
+    ASSERT(PICC_ready_queue_pop(sp->ready) == pts[0]);
+
+    // the slices shrink as the ready queue gets deeper: 8 in flight for 2 workers
+    ASSERT(PICC_sched_pool_fuel(sp) == 64 / 4);
+    sp->fuel = 4;
+    ASSERT(PICC_sched_pool_fuel(sp) == PICC_FUEL_MIN);
+
+    ASSERT(PICC_ready_queue_pop(sp->ready) == pts[1]);
+}
+
 void PICC_test_pithread()
 {
     ALLOC_ERROR(error);
     test_create_pithread(&error);
+    test_pithread_block(&error);
+    test_pithread_pool(&error);
+    test_pithread_end_choice(&error);
+    test_pithread_pool_steady(&error);
+    test_pithread_yield(&error);
 
     if (HAS_ERROR(error))
         PRINT_ERROR(&error);
@@ -8,12 +8,11 @@
  */
 
 #include <stdlib.h>
+#include <pthread.h>
 #include <pi_thread_repr.h>
 #include <queue_repr.h>
 #include <tools.h>
-
-#define ASSERT_NO_ERROR() \
- ASSERT(!HAS_ERROR((*error)))
+#include <tests.h>
 
 /**
  * Creates a stub PiThread
@@ -33,14 +32,14 @@ void test_ready_queue_push(PICC_Error *error)
     ASSERT_NO_ERROR();
 
     PICC_ready_queue_push(q, pt1);
-    ASSERT(q->q.size == 1);
-    ASSERT(q->q.head->thread == pt1);
-    ASSERT(q->q.tail->thread == pt1);
+    ASSERT(q->shared.size == 1);
+    ASSERT(q->shared.top == pt1);
+    ASSERT(pt1->ready_next == NULL);
 
     PICC_ready_queue_push(q, pt2);
-    ASSERT(q->q.size == 2);
-    ASSERT(q->q.head->thread == pt2);
-    ASSERT(q->q.tail->thread == pt1);
+    ASSERT(q->shared.size == 2);
+    ASSERT(q->shared.top == pt2);
+    ASSERT(pt2->ready_next == pt1);
 }
 
 void test_ready_queue_add(PICC_Error *error)
@@ -51,14 +50,13 @@ void test_ready_queue_add(PICC_Error *error)
     ASSERT_NO_ERROR();
 
     PICC_ready_queue_add(q, pt1);
-    ASSERT(q->q.size == 1);
-    ASSERT(q->q.head->thread == pt1);
-    ASSERT(q->q.tail->thread == pt1);
+    ASSERT(q->shared.size == 1);
+    ASSERT(q->shared.top == pt1);
 
     PICC_ready_queue_add(q, pt2);
-    ASSERT(q->q.size == 2);
-    ASSERT(q->q.head->thread == pt1);
-    ASSERT(q->q.tail->thread == pt2);
+    ASSERT(q->shared.size == 2);
+    ASSERT(q->shared.top == pt2);
+    ASSERT(pt2->ready_next == pt1);
     PICC_free_ready_queue(q);
 }
 
@@ -71,12 +69,12 @@ void test_ready_queue_pop(PICC_Error *error)
 
     PICC_ready_queue_add(q, pt1);
     PICC_ready_queue_add(q, pt2);
-    ASSERT(q->q.size == 2);
-    ASSERT(q->q.head->thread == pt1);
+    ASSERT(q->shared.size == 2);
 
     PICC_PiThread *pt = PICC_ready_queue_pop(q);
     ASSERT(pt == pt1);
-    ASSERT(q->q.size == 1);
+    ASSERT(q->shared.size == 1);
+    ASSERT(q->shared.top == pt2);
 }
 
 void test_ready_queue_size(PICC_Error *error)
@@ -85,15 +83,312 @@ void test_ready_queue_size(PICC_Error *error)
     PICC_PiThread *pt1 = create_stub_thread();
     PICC_PiThread *pt2 = create_stub_thread();
     ASSERT_NO_ERROR();
-    ASSERT(q->q.size == 0);
+    ASSERT(PICC_ready_queue_size(q) == 0);
     PICC_ready_queue_add(q, pt1);
-    ASSERT(q->q.size == 1);
+    ASSERT(PICC_ready_queue_size(q) == 1);
     PICC_ready_queue_add(q, pt2);
-    ASSERT(q->q.size == 2);
+    ASSERT(PICC_ready_queue_size(q) == 2);
     PICC_ready_queue_pop(q);
-    ASSERT(q->q.size == 1);
+    ASSERT(PICC_ready_queue_size(q) == 1);
     PICC_ready_queue_pop(q);
-    ASSERT(q->q.size == 0);
+    ASSERT(PICC_ready_queue_size(q) == 0);
+}
+
+void test_ready_queue_worker_deque(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(2, error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    PICC_PiThread *pt3 = create_stub_thread();
+    ASSERT_NO_ERROR();
+    ASSERT(q->nb_workers == 2);
+
+    PICC_ready_queue_bind_worker(q, 0);
+    PICC_ready_queue_push(q, pt1);
+    PICC_ready_queue_push(q, pt2);
+    PICC_ready_queue_add(q, pt3);
+    ASSERT(q->shared.size == 0);
+    ASSERT(q->deques[0].bottom - q->deques[0].top == 2);
+    ASSERT(q->deques[0].inbox.size == 1);
+    ASSERT(q->deques[1].bottom - q->deques[1].top == 0);
+    ASSERT(PICC_ready_queue_size(q) == 3);
+
+    // the owner pops at the bottom of its deque
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+
+    // an idle worker steals at the top of the others deques, then
+    // in their inboxes
+    PICC_ready_queue_bind_worker(q, 1);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_steal(q, 1) == NULL);
+    ASSERT(PICC_ready_queue_steal(q, 0) == pt3);
+    ASSERT(PICC_ready_queue_pop(q) == NULL);
+    ASSERT(PICC_ready_queue_size(q) == 0);
+
+    PICC_free_ready_queue(q);
+}
+
+void test_ready_queue_worker_inbox(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(1, error);
+    PICC_PiThread *pts[PICC_DEQUE_INIT_CAPACITY * 2];
+    int i;
+    for (i = 0; i < PICC_DEQUE_INIT_CAPACITY * 2; i++)
+        pts[i] = create_stub_thread();
+    ASSERT_NO_ERROR();
+
+    PICC_ready_queue_bind_worker(q, 0);
+
+    // added threads are popped in arrival order, after the pushed one
+    for (i = 0; i < PICC_DEQUE_INIT_CAPACITY * 2 - 1; i++)
+        PICC_ready_queue_add(q, pts[i]);
+    PICC_ready_queue_push(q, pts[i]);
+    ASSERT(PICC_ready_queue_size(q) == PICC_DEQUE_INIT_CAPACITY * 2);
+
+    ASSERT(PICC_ready_queue_pop(q) == pts[PICC_DEQUE_INIT_CAPACITY * 2 - 1]);
+    for (i = 0; i < PICC_DEQUE_INIT_CAPACITY * 2 - 1; i++)
+        ASSERT(PICC_ready_queue_pop(q) == pts[i]);
+    ASSERT(PICC_ready_queue_pop(q) == NULL);
+    ASSERT(PICC_ready_queue_size(q) == 0);
+
+    PICC_free_ready_queue(q);
+}
+
+void test_ready_queue_handoff(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(2, error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    PICC_PiThread *pt3 = create_stub_thread();
+    PICC_PiThread *pt4 = create_stub_thread();
+    ASSERT_NO_ERROR();
+
+    // the runnext slot is popped first, a second handoff spills to the inbox
+    PICC_ready_queue_bind_worker(q, 0);
+    PICC_ready_queue_add(q, pt1);
+    PICC_ready_queue_handoff(q, pt2);
+    PICC_ready_queue_handoff(q, pt3);
+    ASSERT(q->deques[0].runnext == pt2);
+    ASSERT(PICC_ready_queue_size(q) == 3);
+    ASSERT(PICC_ready_queue_in_flight(q) == 3);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == pt3);
+
+    // two PiThreads handing off to each other do not starve the others
+    int i;
+    PICC_ready_queue_add(q, pt1);
+    for (i = 0; i < PICC_RUNNEXT_MAX_HANDOFFS; i++) {
+        PICC_ready_queue_handoff(q, pt2);
+        ASSERT(PICC_ready_queue_pop(q) == pt2);
+    }
+    PICC_ready_queue_handoff(q, pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+
+    // an idle worker steals the slot once nothing else is left
+    PICC_ready_queue_handoff(q, pt4);
+    PICC_ready_queue_bind_worker(q, 1);
+    ASSERT(PICC_ready_queue_pop(q) == pt4);
+    ASSERT(PICC_ready_queue_pop(q) == NULL);
+
+    // a thread which is not a worker adds the PiThread
+    PICC_ReadyQueue *shared = PICC_create_ready_queue(error);
+    PICC_ready_queue_handoff(shared, pt1);
+    ASSERT(shared->shared.top == pt1);
+
+    PICC_free_ready_queue(q);
+    PICC_free_ready_queue(shared);
+}
+
+void test_ready_queue_policy(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(2, error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    PICC_PiThread *pt3 = create_stub_thread();
+    PICC_PiThread *pt4 = create_stub_thread();
+    ASSERT_NO_ERROR();
+    ASSERT(q->policy == PICC_READY_MIXED);
+    PICC_ready_queue_bind_worker(q, 0);
+
+    // every PiThread runs next, but a preempted one
+    PICC_ready_queue_set_policy(q, PICC_READY_LIFO);
+    PICC_ready_queue_add(q, pt1);
+    PICC_ready_queue_add(q, pt2);
+    PICC_ready_queue_yield(q, pt3);
+    PICC_ready_queue_handoff(q, pt4);
+    ASSERT(PICC_ready_queue_pop(q) == pt4);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == pt3);
+
+    // every PiThread goes to the end
+    PICC_ready_queue_set_policy(q, PICC_READY_FIFO);
+    PICC_ready_queue_push(q, pt1);
+    PICC_ready_queue_push(q, pt2);
+    PICC_ready_queue_handoff(q, pt3);
+    ASSERT(q->deques[0].runnext == NULL);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt3);
+
+    // the high priority PiThreads run first, on any worker
+    PICC_ready_queue_set_policy(q, PICC_READY_PRIORITY);
+    pt2->priority = PICC_PRIORITY_LOW;
+    pt3->priority = PICC_PRIORITY_HIGH;
+    PICC_ready_queue_push(q, pt1);
+    PICC_ready_queue_push(q, pt2);
+    PICC_ready_queue_add(q, pt3);
+    PICC_ready_queue_add(q, pt4);
+    ASSERT(PICC_ready_queue_size(q) == 4);
+    PICC_ready_queue_bind_worker(q, 1);
+    ASSERT(PICC_ready_queue_pop(q) == pt3);
+    PICC_ready_queue_bind_worker(q, 0);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt4);
+    ASSERT(PICC_ready_queue_pop(q) == NULL);
+
+    PICC_free_ready_queue(q);
+}
+
+void test_ready_queue_batch(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(3, error);
+    PICC_PiThread *pts[8], *popped[16];
+    int i;
+    for (i = 0; i < 8; i++)
+        pts[i] = create_stub_thread();
+    ASSERT_NO_ERROR();
+
+    // a batch is popped in order, as if added one at a time
+    PICC_ready_queue_bind_worker(q, 0);
+    PICC_ready_queue_add_batch(q, pts, 8);
+    ASSERT(PICC_ready_queue_in_flight(q) == 8);
+    ASSERT(atomic_load(&q->deques[0].inbox.size) == 8);
+    ASSERT(PICC_ready_queue_pop_batch(q, popped, 5) == 5);
+    ASSERT(PICC_ready_queue_pop_batch(q, popped + 5, 5) == 3);
+    for (i = 0; i < 8; i++)
+        ASSERT(popped[i] == pts[i]);
+
+    // a scattered batch is split in chunks, the current worker first
+    PICC_ready_queue_bind_worker(q, 1);
+    PICC_ready_queue_scatter(q, pts, 8, 3);
+    ASSERT(atomic_load(&q->deques[1].inbox.size) == 2);
+    ASSERT(atomic_load(&q->deques[2].inbox.size) == 3);
+    ASSERT(atomic_load(&q->deques[0].inbox.size) == 3);
+    ASSERT(PICC_ready_queue_pop(q) == pts[0]);
+    ASSERT(PICC_ready_queue_pop(q) == pts[1]);
+    PICC_ready_queue_bind_worker(q, 2);
+    ASSERT(PICC_ready_queue_pop_batch(q, popped, 3) == 3);
+    ASSERT(popped[0] == pts[2] && popped[2] == pts[4]);
+    PICC_ready_queue_bind_worker(q, 0);
+    ASSERT(PICC_ready_queue_pop_batch(q, popped, 8) == 3);
+    ASSERT(popped[0] == pts[5] && popped[2] == pts[7]);
+
+    // a thief takes half of the victim's deque along
+    for (i = 0; i < 8; i++)
+        PICC_ready_queue_push(q, pts[i]);
+    PICC_ready_queue_bind_worker(q, 1);
+    ASSERT(PICC_ready_queue_pop(q) == pts[0]);
+    ASSERT(PICC_ready_queue_size(q) == 7);
+    long stolen = atomic_load(&q->deques[1].bottom) - atomic_load(&q->deques[1].top);
+    ASSERT(stolen == 3);
+    ASSERT(PICC_ready_queue_pop_batch(q, popped, 8) == 7);
+
+    PICC_free_ready_queue(q);
+}
+
+void test_ready_queue_steal_node(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(3, error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    ASSERT_NO_ERROR();
+    ASSERT(q->nb_nodes == 1);
+
+    PICC_ready_queue_set_node(q, 1, 1);
+    ASSERT(q->nb_nodes == 2);
+
+    PICC_ready_queue_bind_worker(q, 1);
+    PICC_ready_queue_push(q, pt1);
+    PICC_ready_queue_bind_worker(q, 2);
+    PICC_ready_queue_push(q, pt2);
+
+    // the worker 0 steals from the worker 2 of its node before the worker 1
+    PICC_ready_queue_bind_worker(q, 0);
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_pop(q) == NULL);
+
+    PICC_free_ready_queue(q);
+}
+
+void test_ready_queue_in_flight(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(1, error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    ASSERT_NO_ERROR();
+    ASSERT(PICC_ready_queue_in_flight(q) == 0);
+
+    PICC_ready_queue_bind_worker(q, 0);
+    PICC_ready_queue_push(q, pt1);
+    ASSERT(PICC_ready_queue_in_flight(q) == 1);
+
+    // a popped thread stays in flight until done, and may make others ready
+    ASSERT(PICC_ready_queue_pop(q) == pt1);
+    ASSERT(PICC_ready_queue_in_flight(q) == 1);
+    PICC_ready_queue_add(q, pt2);
+    ASSERT(PICC_ready_queue_in_flight(q) == 2);
+    ASSERT(!PICC_ready_queue_done(q));
+
+    ASSERT(PICC_ready_queue_pop(q) == pt2);
+    ASSERT(PICC_ready_queue_done(q));
+    ASSERT(PICC_ready_queue_in_flight(q) == 0);
+
+    PICC_free_ready_queue(q);
+}
+
+/**
+ * Parks on the idle eventcount of the ready queue until a PiThread can be
+ * popped, the way the idle workers do.
+ */
+static void *idle_worker(void *arg)
+{
+    PICC_ReadyQueue *q = arg;
+    PICC_PiThread *pt;
+    for (;;) {
+        unsigned key = PICC_eventcount_prepare(&q->idle);
+        if ((pt = PICC_ready_queue_pop(q)) != NULL) {
+            PICC_eventcount_cancel(&q->idle);
+            return pt;
+        }
+        PICC_eventcount_wait(&q->idle, key);
+    }
+}
+
+void test_ready_queue_idle(PICC_Error *error)
+{
+    PICC_ReadyQueue *q = PICC_create_worker_ready_queue(2, error);
+    PICC_PiThread *pt = create_stub_thread();
+    ASSERT_NO_ERROR();
+
+    pthread_t worker;
+    void *popped;
+    ASSERT(pthread_create(&worker, NULL, idle_worker, q) == 0);
+
+    // wait until the worker is parked, then wake it up by a push
+    while (atomic_load(&q->idle.waiters) == 0)
+        PICC_low_level_yield();
+    PICC_ready_queue_push(q, pt);
+
+    ASSERT(pthread_join(worker, &popped) == 0);
+    ASSERT(popped == pt);
+    ASSERT(atomic_load(&q->idle.waiters) == 0);
+
+    PICC_free_ready_queue(q);
 }
 
 void test_wait_queue_push(PICC_Error *error)
@@ -106,14 +401,14 @@ void test_wait_queue_push(PICC_Error *error)
     PICC_wait_queue_push(q, pt1);
     ASSERT(q->old.size == 0);
     ASSERT(q->active.size == 1);
-    ASSERT(q->active.head->thread == pt1);
-    ASSERT(q->active.tail->thread == pt1);
+    ASSERT(q->active.head == pt1);
+    ASSERT(q->active.tail == pt1);
 
     PICC_wait_queue_push(q, pt2);
     ASSERT(q->old.size == 0);
     ASSERT(q->active.size == 2);
-    ASSERT(q->active.head->thread == pt2);
-    ASSERT(q->active.tail->thread == pt1);
+    ASSERT(q->active.head == pt2);
+    ASSERT(q->active.tail == pt1);
 }
 
 void test_wait_queue_fetch(PICC_Error *error)
@@ -147,6 +442,48 @@ void test_wait_queue_fetch(PICC_Error *error)
     ASSERT(q->old.tail == NULL);
 }
 
+void test_wait_queue_fetch_zones(PICC_Error *error)
+{
+    PICC_WaitQueue *q = PICC_create_wait_queue(error);
+    PICC_PiThread *pt1 = create_stub_thread();
+    PICC_PiThread *pt2 = create_stub_thread();
+    PICC_PiThread *pt3 = create_stub_thread();
+    PICC_PiThread *pt4 = create_stub_thread();
+    ASSERT_NO_ERROR();
+
+    // active: pt3 pt2, old: pt4 pt1 (pt1 moved by the reset)
+    PICC_wait_queue_push(q, pt1);
+    PICC_wait_queue_max_active_reset(q);
+    PICC_wait_queue_push_old(q, pt4, error);
+    PICC_wait_queue_push(q, pt2);
+    PICC_wait_queue_push(q, pt3);
+    ASSERT_NO_ERROR();
+    ASSERT(pt1->wait_zone != q->active_zone);
+    ASSERT(pt2->wait_zone == q->active_zone);
+
+    // active tail, linked to the old head
+    ASSERT(PICC_wait_queue_fetch(q, pt2) == pt2);
+    ASSERT(pt2->wait_zone == PICC_WAIT_ZONE_NONE);
+    ASSERT(q->active.tail == pt3);
+    ASSERT(pt3->wait_next == pt4);
+    ASSERT(pt4->wait_prev == pt3);
+    ASSERT(PICC_wait_queue_fetch(q, pt2) == NULL);
+
+    // old head
+    ASSERT(PICC_wait_queue_fetch(q, pt4) == pt4);
+    ASSERT(q->old.head == pt1);
+    ASSERT(q->old.size == 1);
+    ASSERT(pt3->wait_next == pt1);
+    ASSERT(pt1->wait_prev == pt3);
+
+    ASSERT(PICC_wait_queue_pop_old(q) == pt1);
+    ASSERT(pt3->wait_next == NULL);
+    ASSERT(PICC_wait_queue_fetch(q, pt3) == pt3);
+    ASSERT(PICC_wait_queue_size(q) == 0);
+
+    PICC_free_wait_queue(q);
+}
+
 void test_wait_queue_push_old(PICC_Error *error)
 {
     PICC_WaitQueue *q = PICC_create_wait_queue(error);
@@ -158,17 +495,17 @@ void test_wait_queue_push_old(PICC_Error *error)
     PICC_wait_queue_push_old(q, pt1, error);
     ASSERT_NO_ERROR();
     ASSERT(q->old.size == 1);
-    ASSERT(q->old.head->thread == pt1);
-    ASSERT(q->old.tail->thread == pt1);
-    ASSERT(q->old.head->next == NULL);
+    ASSERT(q->old.head == pt1);
+    ASSERT(q->old.tail == pt1);
+    ASSERT(q->old.head->wait_next == NULL);
 
     PICC_wait_queue_push_old(q, pt2, error);
     ASSERT_NO_ERROR();
     ASSERT(q->old.size == 2);
-    ASSERT(q->old.head->thread == pt2);
-    ASSERT(q->old.tail->thread == pt1);
-    ASSERT(q->old.head->next == q->old.tail);
-    ASSERT(q->old.tail->next == NULL);
+    ASSERT(q->old.head == pt2);
+    ASSERT(q->old.tail == pt1);
+    ASSERT(q->old.head->wait_next == q->old.tail);
+    ASSERT(q->old.tail->wait_next == NULL);
 }
 
 void test_wait_queue_pop_old(PICC_Error *error)
@@ -184,14 +521,14 @@ void test_wait_queue_pop_old(PICC_Error *error)
     PICC_wait_queue_push_old(q, pt2, error);
     ASSERT_NO_ERROR();
     ASSERT(q->old.size == 2);
-    ASSERT(q->old.head->thread == pt2);
-    ASSERT(q->old.tail->thread == pt1);
+    ASSERT(q->old.head == pt2);
+    ASSERT(q->old.tail == pt1);
 
     pt = PICC_wait_queue_pop_old(q);
     ASSERT(pt == pt1);
     ASSERT(q->old.size == 1);
-    ASSERT(q->old.head->thread == pt2);
-    ASSERT(q->old.tail->thread == pt2);
+    ASSERT(q->old.head == pt2);
+    ASSERT(q->old.tail == pt2);
 
     pt = PICC_wait_queue_pop_old(q);
     ASSERT(pt == pt2);
@@ -258,7 +595,7 @@ void test_wait_queue_max_active_reset(PICC_Error *error)
     ASSERT(q->old.size = 3);
     ASSERT(q->active.head == NULL);
     ASSERT(q->active.tail == NULL);
-    ASSERT(q->old.head->thread == pt2);
+    ASSERT(q->old.head == pt2);
 }
 
 /**
@@ -271,8 +608,17 @@ void PICC_test_queue()
     test_ready_queue_add(&error);
     test_ready_queue_pop(&error);
     test_ready_queue_size(&error);
+    test_ready_queue_worker_deque(&error);
+    test_ready_queue_worker_inbox(&error);
+    test_ready_queue_handoff(&error);
+    test_ready_queue_policy(&error);
+    test_ready_queue_batch(&error);
+    test_ready_queue_steal_node(&error);
+    test_ready_queue_in_flight(&error);
+    test_ready_queue_idle(&error);
     test_wait_queue_push(&error);
     test_wait_queue_fetch(&error);
+    test_wait_queue_fetch_zones(&error);
     test_wait_queue_push_old(&error);
     test_wait_queue_pop_old(&error);
     test_wait_queue_size(&error);
@@ -38,5 +38,17 @@ int main(int argc, char **argv)
     printf("Run known set tests...\n");
     PICC_test_knownset();
 
+    printf("Run slab allocator tests...\n");
+    PICC_test_slab();
+
+    printf("Run topology tests...\n");
+    PICC_test_topology();
+
+    printf("Run GC tests...\n");
+    PICC_test_gc();
+
+    printf("Run runtime tests...\n");
+    PICC_test_runtime();
+
     return 0;
 }
@@ -0,0 +1,467 @@
+/**
+ * @file runtime_test.c
+ * Unit testing of the runtime lifecycle.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <runtime_repr.h>
+#include <pi_thread_repr.h>
+#include <queue_repr.h>
+#include <value_repr.h>
+#include <channel_repr.h>
+#include <slab.h>
+#include <tools.h>
+#include <error.h>
+#include <tests.h>
+
+/**
+ * Number of PiThreads ended by the procedures below.
+ */
+static atomic_int nb_ended;
+
+static void end_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    atomic_fetch_add(&nb_ended, 1);
+    PICC_process_end(pt, PICC_STATUS_ENDED);
+}
+
+/**
+ * Spawns 8 PiThreads running end_proc, then ends.
+ */
+static void spawn_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < 8; i++) {
+        PICC_PiThread *child = PICC_create_pithread(0, 0, 0);
+        child->proc = end_proc;
+        PICC_ready_queue_add(sp->ready, child);
+    }
+    end_proc(sp, pt);
+}
+
+/**
+ * Spawns 64 PiThreads running end_proc at once, then ends.
+ */
+static void spawn_batch_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    PICC_PiThread *children[64];
+    int i;
+    for (i = 0; i < 64; i++) {
+        children[i] = PICC_create_pithread(0, 0, 0);
+        children[i]->proc = end_proc;
+    }
+    PICC_spawn(sp, children, 64);
+    end_proc(sp, pt);
+}
+
+/**
+ * Waits forever.
+ */
+static void wait_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    pt->status = PICC_STATUS_WAIT;
+}
+
+/**
+ * Spawns 256 PiThreads waiting forever, then ends.
+ */
+static void garbage_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < 256; i++) {
+        PICC_PiThread *child = PICC_create_pithread(0, 0, 0);
+        child->proc = wait_proc;
+        PICC_ready_queue_add(sp->ready, child);
+    }
+    end_proc(sp, pt);
+}
+
+/**
+ * Calls itself pc times, then ends.
+ */
+static int nb_calls;
+
+static void call_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    if (++pt->pc < nb_calls)
+        pt->status = PICC_STATUS_CALL;
+    else
+        end_proc(sp, pt);
+}
+
+/**
+ * Spawns 1024 PiThreads running call_proc, then ends.
+ */
+static void burst_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < 1024; i++) {
+        PICC_PiThread *child = PICC_create_pithread(0, 0, 0);
+        child->proc = call_proc;
+        PICC_ready_queue_add(sp->ready, child);
+    }
+    end_proc(sp, pt);
+}
+
+/**
+ * Allocates a channel from the slab cache of its worker, then ends.
+ */
+static void channel_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    ALLOC_ERROR(error);
+    PICC_reclaim_channel(PICC_create_channel(), &error);
+    end_proc(sp, pt);
+}
+
+/**
+ * The ids of the PiThreads run by trace_proc, in order.
+ */
+#define NB_TRACED 16
+static int trace[NB_TRACED];
+static int nb_traced;
+
+static void trace_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    trace[nb_traced++] = ((PICC_IntValue *) &pt->env[0])->data;
+    end_proc(sp, pt);
+}
+
+/**
+ * Spawns NB_TRACED PiThreads running trace_proc, then ends.
+ */
+static void fan_proc(PICC_SchedPool *sp, PICC_PiThread *pt)
+{
+    int i;
+    for (i = 0; i < NB_TRACED; i++) {
+        PICC_PiThread *child = PICC_create_pithread(1, 0, 0);
+        child->proc = trace_proc;
+        PICC_INIT_INT_VALUE(&child->env[0], i);
+        PICC_ready_queue_add(sp->ready, child);
+    }
+    end_proc(sp, pt);
+}
+
+/**
+ * Runs fan_proc in a serial runtime with the given seed and records the
+ * order of its children in the given trace.
+ */
+static void run_serial(unsigned long seed, int *order, PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.serial = true;
+    config.seed = seed;
+
+    nb_traced = 0;
+    PICC_Runtime *rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    ASSERT(rt->nb_threads == 0);
+    PICC_runtime_spawn(rt, fan_proc, 0, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+    ASSERT(nb_traced == NB_TRACED);
+    PICC_runtime_shutdown(rt);
+
+    int i;
+    for (i = 0; i < NB_TRACED; i++)
+        order[i] = trace[i];
+}
+
+/**
+ * Test : lifecycle \n
+ * A runtime runs the spawned PiThreads until it is quiescent, keeps
+ * running afterwards, and can be shut down and created again.
+ */
+void test_runtime_lifecycle(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    ASSERT(config.nb_core_threads == 0);
+    ASSERT(config.fuel == PICC_FUEL_INIT);
+    ASSERT(config.pin_mode == PICC_PIN_NONE);
+    config.nb_core_threads = 2;
+
+    int run;
+    for (run = 0; run < 2; run++) {
+        atomic_store(&nb_ended, 0);
+        PICC_Runtime *rt = PICC_create_runtime(&config, error);
+        ASSERT_NO_ERROR();
+        ASSERT(rt->nb_workers == 3);
+        ASSERT(rt->nb_threads == 3);
+        ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+
+        PICC_runtime_spawn(rt, spawn_proc, 0, 0, 0);
+        ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+        ASSERT(atomic_load(&nb_ended) == 9);
+
+        // the workers were parked, not stopped
+        PICC_runtime_spawn(rt, spawn_proc, 0, 0, 0);
+        PICC_runtime_spawn(rt, end_proc, 0, 0, 0);
+        ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+        ASSERT(atomic_load(&nb_ended) == 19);
+        ASSERT_NO_ERROR();
+
+        // a batch is spread over the workers
+        PICC_runtime_spawn(rt, spawn_batch_proc, 0, 0, 0);
+        ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+        ASSERT(atomic_load(&nb_ended) == 84);
+
+        PICC_runtime_shutdown(rt);
+    }
+}
+
+/**
+ * Test : blocked runtime \n
+ * A runtime whose PiThreads wait forever is quiescent and blocked, its
+ * waiting PiThreads are reclaimed by the shutdown.
+ */
+void test_runtime_blocked(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.nb_core_threads = 1;
+
+    PICC_Runtime *rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    PICC_runtime_spawn(rt, wait_proc, 1, 0, 0);
+    PICC_runtime_spawn(rt, end_proc, 0, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_BLOCKED);
+    ASSERT(PICC_wait_queue_size(rt->sched_pool->wait) == 1);
+    ASSERT_NO_ERROR();
+    PICC_runtime_shutdown(rt);
+}
+
+/**
+ * Test : restart \n
+ * The PiThreads ended by a runtime are reclaimed by its workers: the
+ * runtimes created again reuse them instead of allocating new ones, and
+ * their workers adopt the slab caches of the previous ones.
+ */
+void test_runtime_restart(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.nb_core_threads = 1;
+
+    nb_calls = 1;
+    long start = PICC_pithread_nb_allocs();
+    PICC_SlabStats first, last;
+    int run;
+    for (run = 0; run < 8; run++) {
+        atomic_store(&nb_ended, 0);
+        PICC_Runtime *rt = PICC_create_runtime(&config, error);
+        ASSERT_NO_ERROR();
+        PICC_runtime_spawn(rt, burst_proc, 0, 0, 0);
+        PICC_runtime_spawn(rt, channel_proc, 0, 0, 0);
+        ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+        ASSERT(atomic_load(&nb_ended) == 1026);
+        PICC_runtime_shutdown(rt);
+        if (run == 0)
+            PICC_slab_stats(&first);
+    }
+    // without reuse, each run would allocate its 1025 PiThreads
+    ASSERT(PICC_pithread_nb_allocs() - start < 2 * 1026);
+    // and each run would add the caches and slabs of its workers
+    PICC_slab_stats(&last);
+    ASSERT(last.caches == first.caches);
+    ASSERT(last.slabs == first.slabs);
+}
+
+/**
+ * Test : adaptive sizing \n
+ * The pool grows under a burst of PiThreads and shrinks back while a
+ * single PiThread runs.
+ */
+void test_runtime_adaptive(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_RuntimeStats stats;
+    PICC_runtime_config_init(&config);
+    ASSERT(config.min_core_threads < 0);
+    config.nb_core_threads = 3;
+    config.min_core_threads = 0;
+
+    PICC_Runtime *rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    PICC_runtime_stats(rt, &stats);
+    ASSERT(stats.nb_workers == 4);
+    ASSERT(stats.nb_active == 1);
+    ASSERT(stats.nb_grows == 0);
+
+    nb_calls = 8;
+    PICC_runtime_spawn(rt, burst_proc, 0, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+    PICC_runtime_stats(rt, &stats);
+    ASSERT(stats.in_flight == 0);
+    ASSERT(stats.nb_samples > 0);
+    ASSERT(stats.nb_grows > 0);
+    ASSERT(stats.nb_active == 1 + stats.nb_grows - stats.nb_shrinks);
+    int grown = stats.nb_active;
+
+    nb_calls = 100000;
+    PICC_runtime_spawn(rt, call_proc, 0, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_DONE);
+    PICC_runtime_stats(rt, &stats);
+    ASSERT(stats.nb_shrinks > 0);
+    ASSERT(stats.nb_active < grown);
+    ASSERT(stats.nb_active >= 1);
+
+    PICC_runtime_shutdown(rt);
+}
+
+/**
+ * Test : serial runtime \n
+ * A serial runtime runs its PiThreads on the joining thread, in the same
+ * order for the same seed, and can't run alongside another runtime.
+ */
+void test_runtime_serial(PICC_Error *error)
+{
+    int canonical[NB_TRACED], first[NB_TRACED], second[NB_TRACED];
+    int i;
+
+    // the children are added, hence run in arrival order
+    run_serial(0, canonical, error);
+    for (i = 0; i < NB_TRACED; i++)
+        ASSERT(canonical[i] == i);
+
+    run_serial(42, first, error);
+    run_serial(42, second, error);
+    bool shuffled = false;
+    for (i = 0; i < NB_TRACED; i++) {
+        ASSERT(first[i] == second[i]);
+        shuffled = shuffled || first[i] != i;
+    }
+    ASSERT(shuffled);
+
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.serial = true;
+    PICC_Runtime *rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    PICC_runtime_spawn(rt, wait_proc, 1, 0, 0);
+    ASSERT(PICC_runtime_join(rt, error) == PICC_RUNTIME_BLOCKED);
+
+    ALLOC_ERROR(create_error);
+    config.serial = false;
+    ASSERT(PICC_create_runtime(&config, &create_error) == NULL);
+    ASSERT(create_error.id == ERR_RUNTIME_CREATE);
+    ASSERT(create_error.prev != NULL && create_error.prev->id == ERR_RUNTIME_SERIAL);
+    PICC_free_error(create_error.prev);
+    free(create_error.file);
+    PICC_runtime_shutdown(rt);
+
+    // and the other way around
+    rt = PICC_create_runtime(&config, error);
+    ASSERT_NO_ERROR();
+    create_error = (PICC_Error){.id = 0, .file = NULL, .line = 0, .prev = NULL};
+    config.serial = true;
+    ASSERT(PICC_create_runtime(&config, &create_error) == NULL);
+    ASSERT(create_error.prev != NULL && create_error.prev->id == ERR_RUNTIME_SERIAL);
+    PICC_free_error(create_error.prev);
+    free(create_error.file);
+    PICC_runtime_shutdown(rt);
+}
+
+/**
+ * Runs garbage_proc in a runtime of the given configuration, and checks
+ * that the PiThreads left waiting are the ones the GC did not reclaim.
+ *
+ * @param stats Statistics of the runtime once joined
+ * @return The number of cliques reclaimed
+ */
+static long run_garbage(PICC_RuntimeConfig *config, PICC_RuntimeStats *stats, PICC_Error *error)
+{
+    PICC_Runtime *rt = PICC_create_runtime(config, error);
+    ASSERT_NO_ERROR();
+    ASSERT(rt->has_collector == (!config->serial && config->std_gc_fuel > 0));
+
+    PICC_runtime_spawn(rt, garbage_proc, 0, 0, 0);
+    PICC_RuntimeStatus status = PICC_runtime_join(rt, error);
+    ASSERT_NO_ERROR();
+    PICC_runtime_stats(rt, stats);
+    // a PiThread without commitment is a clique of its own
+    ASSERT(PICC_wait_queue_size(rt->sched_pool->wait) == 256 - stats->nb_gc_cliques);
+    ASSERT(status == (stats->nb_gc_cliques == 256 ? PICC_RUNTIME_DONE : PICC_RUNTIME_BLOCKED));
+    ASSERT(stats->nb_gc_runs >= stats->nb_gc_cliques);
+    ASSERT(stats->gc_seconds >= 0.0);
+    ASSERT(config->stw_threshold > 0 || stats->nb_gc_stops == 0);
+    PICC_runtime_shutdown(rt);
+    return stats->nb_gc_cliques;
+}
+
+/**
+ * Test : GC \n
+ * The GC is requested by the workers and run by the collector thread, by
+ * the master of a serial runtime, and not at all once disabled. The
+ * runtime is quiescent once the requested GC is done. With a threshold of
+ * stop-the-world GCs, the collector stops the workers and collects every
+ * clique at once.
+ */
+void test_runtime_gc(PICC_Error *error)
+{
+    PICC_RuntimeConfig config;
+    PICC_RuntimeStats stats;
+    PICC_runtime_config_init(&config);
+    config.nb_core_threads = 1;
+    config.std_gc_fuel = 16;
+    config.quick_gc_fuel = 4;
+    // every waiting PiThread is old enough
+    config.active_factor = 0;
+
+    ASSERT(run_garbage(&config, &stats, error) > 0);
+    config.serial = true;
+    ASSERT(run_garbage(&config, &stats, error) > 0);
+    config.serial = false;
+
+    config.stw_threshold = 8;
+    ASSERT(run_garbage(&config, &stats, error) > 0);
+    ASSERT(stats.nb_gc_stops > 0);
+    config.serial = true;
+    ASSERT(run_garbage(&config, &stats, error) > 0);
+    ASSERT(stats.nb_gc_stops > 0);
+    config.serial = false;
+    config.stw_threshold = 0;
+
+    config.std_gc_fuel = 0;
+    ASSERT(run_garbage(&config, &stats, error) == 0);
+}
+
+/**
+ * Test : failed creation \n
+ * A runtime that cannot pin its workers is not created.
+ */
+void test_runtime_create_error()
+{
+    ALLOC_ERROR(error);
+    PICC_RuntimeConfig config;
+    PICC_runtime_config_init(&config);
+    config.pin_mode = PICC_PIN_CPU;
+    config.cpus = "not a cpulist";
+
+    ASSERT(PICC_create_runtime(&config, &error) == NULL);
+    ASSERT(error.id == ERR_RUNTIME_CREATE);
+    ASSERT(error.prev != NULL && error.prev->id == ERR_INVALID_CPULIST);
+    PICC_free_error(error.prev);
+    free(error.file);
+}
+
+/**
+ * Runs all runtime tests.
+ */
+void PICC_test_runtime()
+{
+    ALLOC_ERROR(error);
+    test_runtime_lifecycle(&error);
+    test_runtime_blocked(&error);
+    test_runtime_restart(&error);
+    test_runtime_adaptive(&error);
+    test_runtime_serial(&error);
+    test_runtime_gc(&error);
+    test_runtime_create_error();
+
+    if (HAS_ERROR(error))
+        PRINT_ERROR(&error);
+}
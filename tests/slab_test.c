@@ -0,0 +1,105 @@
+/**
+ * @file slab_test.c
+ * Unit testing of the slab allocator.
+ *
+ * This project is released under MIT License.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <slab_repr.h>
+#include <error.h>
+#include <tests.h>
+
+void test_slab_reuse(PICC_Error *error)
+{
+    PICC_SlabStats before, after;
+    PICC_slab_stats(&before);
+
+    void *a = PICC_slab_alloc(24);
+    void *b = PICC_slab_alloc(24);
+    ASSERT(a != NULL && b != NULL && a != b);
+
+    // freed objects are reused first
+    PICC_slab_free(b, 24);
+    ASSERT(PICC_slab_alloc(32) == b);
+
+    PICC_slab_free(a, 24);
+    PICC_slab_free(b, 32);
+
+    PICC_slab_stats(&after);
+    ASSERT(after.allocs - before.allocs == 3);
+    ASSERT(after.frees - before.frees == 3);
+    ASSERT(after.caches >= 1);
+}
+
+void test_slab_large(PICC_Error *error)
+{
+    PICC_SlabStats before, after;
+    PICC_slab_stats(&before);
+
+    void *big = PICC_slab_alloc(PICC_SLAB_MAX_OBJECT + 1);
+    ASSERT(big != NULL);
+    PICC_slab_free(big, PICC_SLAB_MAX_OBJECT + 1);
+
+    PICC_slab_stats(&after);
+    ASSERT(after.large_allocs - before.large_allocs == 1);
+    ASSERT(after.allocs == before.allocs);
+}
+
+void test_slab_many(PICC_Error *error)
+{
+    // more objects than a single slab can hold
+    int n = 2 * PICC_SLAB_SIZE / PICC_SLAB_MAX_OBJECT;
+    void **objects = malloc(sizeof(void *) * n);
+    int i;
+    for (i = 0; i < n; i++) {
+        objects[i] = PICC_slab_alloc(PICC_SLAB_MAX_OBJECT);
+        ASSERT(objects[i] != NULL);
+        ((char *) objects[i])[PICC_SLAB_MAX_OBJECT - 1] = 1;
+    }
+    for (i = 0; i < n; i++)
+        PICC_slab_free(objects[i], PICC_SLAB_MAX_OBJECT);
+    free(objects);
+}
+
+static void *remote_free(void *object)
+{
+    PICC_slab_free(object, 64);
+    return NULL;
+}
+
+void test_slab_remote_free(PICC_Error *error)
+{
+    PICC_SlabStats before, after;
+    PICC_slab_stats(&before);
+
+    void *a = PICC_slab_alloc(64);
+    ASSERT(a != NULL);
+
+    pthread_t other;
+    pthread_create(&other, NULL, remote_free, a);
+    pthread_join(other, NULL);
+
+    PICC_slab_stats(&after);
+    ASSERT(after.remote_frees - before.remote_frees == 1);
+
+    // the object comes back to its owner
+    ASSERT(PICC_slab_alloc(64) == a);
+    PICC_slab_free(a, 64);
+}
+
+/**
+ * Runs all slab allocator tests.
+ */
+void PICC_test_slab()
+{
+    ALLOC_ERROR(error);
+    test_slab_reuse(&error);
+    test_slab_large(&error);
+    test_slab_many(&error);
+    test_slab_remote_free(&error);
+
+    if (HAS_ERROR(error))
+        PRINT_ERROR(&error);
+}
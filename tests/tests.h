@@ -9,6 +9,17 @@
  * @author Dany SIRIPHOL
  */
 
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <error.h>
+
+/**
+ * Asserts that the error stack of the current test is empty.
+ */
+#define ASSERT_NO_ERROR() \
+ ASSERT(!(HAS_ERROR((*error))))
+
 extern void PICC_test_pithread();
 extern void PICC_test_runtime();
 extern void PICC_test_queue();
@@ -17,3 +28,8 @@ extern void PICC_test_channel();
 extern void PICC_test_atomic();
 extern void PICC_test_value();
 extern void PICC_test_knownset();
+extern void PICC_test_slab();
+extern void PICC_test_topology();
+extern void PICC_test_gc();
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file topology_test.c
+ * Unit testing of the CPU topology and of the placement of the workers.
+ *
+ * This project is released under MIT License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <topology_repr.h>
+#include <tools.h>
+#include <error.h>
+#include <tests.h>
+
+void test_parse_cpulist(PICC_Error *error)
+{
+    bool cpus[16] = { false };
+    int cpu;
+
+    ASSERT(PICC_parse_cpulist("0-2,5,7-8\n", cpus, 16));
+    for (cpu = 0; cpu < 16; cpu++)
+        ASSERT(cpus[cpu] == (cpu <= 2 || cpu == 5 || cpu == 7 || cpu == 8));
+
+    // the CPUs beyond the flags are ignored
+    ASSERT(PICC_parse_cpulist("14-40", cpus, 16));
+    ASSERT(cpus[14] && cpus[15]);
+
+    ASSERT(!PICC_parse_cpulist("3-1", cpus, 16));
+    ASSERT(!PICC_parse_cpulist("a", cpus, 16));
+    ASSERT(!PICC_parse_cpulist("1;2", cpus, 16));
+}
+
+void test_topology(PICC_Error *error)
+{
+    PICC_Topology *topo = PICC_create_topology(NULL, error);
+    ASSERT_NO_ERROR();
+    ASSERT(topo->nb_cpus >= 1);
+    ASSERT(topo->nb_nodes >= 1);
+
+    // the CPUs are sorted by node, the workers wrap around them
+    int i;
+    for (i = 1; i < topo->nb_cpus; i++)
+        ASSERT(topo->nodes[i - 1] <= topo->nodes[i]);
+    ASSERT(PICC_topology_worker_cpu(topo, topo->nb_cpus) == topo->cpus[0]);
+    ASSERT(PICC_topology_worker_node(topo, topo->nb_cpus) == topo->nodes[0]);
+
+    // the pinned thread allocates from the node of its worker
+    ASSERT(PICC_topology_pin(topo, PICC_PIN_NONE, 0));
+    ASSERT(PICC_current_node() == topo->nodes[0]);
+    PICC_free_topology(topo);
+
+    // restricted to the first allowed CPU, the affinity of the tests is
+    // restored afterwards
+    cpu_set_t saved;
+    ASSERT(pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0);
+    char list[16];
+    PICC_Topology *all = PICC_create_topology(NULL, error);
+    snprintf(list, sizeof(list), "%d", all->cpus[0]);
+    topo = PICC_create_topology(list, error);
+    ASSERT_NO_ERROR();
+    ASSERT(topo->nb_cpus == 1);
+    ASSERT(topo->cpus[0] == all->cpus[0]);
+    ASSERT(PICC_topology_pin(topo, PICC_PIN_CPU, 0));
+    ASSERT(PICC_topology_pin(topo, PICC_PIN_NODE, 0));
+    ASSERT(pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved) == 0);
+    PICC_free_topology(topo);
+    PICC_free_topology(all);
+}
+
+void test_topology_invalid(PICC_Error *error)
+{
+    ALLOC_ERROR(sub_error);
+    ASSERT(PICC_create_topology("1-", &sub_error) == NULL);
+    ASSERT(HAS_ERROR(sub_error));
+    ASSERT(sub_error.id == ERR_INVALID_CPULIST);
+
+    // no allowed CPU in the list
+    ALLOC_ERROR(empty_error);
+    ASSERT(PICC_create_topology("1000000", &empty_error) == NULL);
+    ASSERT(empty_error.id == ERR_INVALID_CPULIST);
+}
+
+/**
+ * Runs all topology tests.
+ */
+void PICC_test_topology()
+{
+    ALLOC_ERROR(error);
+    test_parse_cpulist(&error);
+    test_topology(&error);
+    test_topology_invalid(&error);
+
+    if (HAS_ERROR(error))
+        PRINT_ERROR(&error);
+}
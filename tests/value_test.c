@@ -12,6 +12,16 @@
 #include <stdio.h>
 #include <value_repr.h>
 
+/**
+ * Returns an int value by copy, as the eval functions of outputs do.
+ */
+static PICC_Value return_int(int i)
+{
+    PICC_Value v;
+    PICC_INIT_INT_VALUE(&v, i);
+    return v;
+}
+
 void test_int(PICC_Error *error)
 {
     PICC_Value v, v2, vresult;
@@ -37,6 +47,9 @@ void test_int(PICC_Error *error)
     PICC_equals(&vresult, &v, &v2);
 
     ASSERT(PICC_BOOL_OF_BOOL_VALUE(&vresult) == true);
+
+    v = return_int(42);
+    ASSERT(((PICC_IntValue *) &v)->data == 42);
 }
 
 void test_bool(PICC_Error *error)